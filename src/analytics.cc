@@ -0,0 +1,401 @@
+#include "gstsscmayolov5.h"
+#include "analytics.h"
+
+/** frames after which a track that was not seen again is forgotten */
+#define SSCMA_ANALYTICS_TRACK_TTL (150)
+
+/**
+ * @brief A counting line from (x1, y1) to (x2, y2).
+ * Crossing from its left to its right (looking from x1,y1 towards x2,y2 in
+ * image coordinates) is "forward", the other way "backward".
+ */
+typedef struct
+{
+  gboolean normalized; /**< TRUE if the coordinates are fractions of the frame */
+  gfloat x1, y1, x2, y2;
+  guint64 forward; /**< tracks crossed left to right */
+  guint64 backward; /**< tracks crossed right to left */
+} SscmaLine;
+
+/**
+ * @brief A zone and its counters.
+ */
+typedef struct
+{
+  SscmaRegion region;
+  guint occupancy; /**< objects inside on the last frame */
+  guint64 entries; /**< tracks that entered so far */
+} SscmaZone;
+
+/**
+ * @brief What is remembered about a track between frames.
+ */
+typedef struct
+{
+  gfloat x, y; /**< last anchor point (bottom centre of the box) */
+  gint class_id;
+  gint model_id;
+  guint64 seen; /**< last frame the track was seen on */
+  GstClockTime last_ts; /**< timestamp of that frame */
+  guint32 zones; /**< bit i set while inside zone i */
+  GstClockTime entered[SSCMA_ANALYTICS_MAX_ITEMS]; /**< when each zone was entered */
+} SscmaAnalyticsTrack;
+
+struct _SscmaAnalytics
+{
+  SscmaLine lines[SSCMA_ANALYTICS_MAX_ITEMS];
+  guint n_lines;
+  SscmaZone zones[SSCMA_ANALYTICS_MAX_ITEMS];
+  guint n_zones;
+
+  GHashTable *tracks; /**< tracking id -> SscmaAnalyticsTrack */
+  guint64 frame;
+};
+
+/**
+ * @brief Create analytics without lines or zones.
+ */
+SscmaAnalytics *
+sscma_analytics_new (void)
+{
+  SscmaAnalytics *analytics = g_new0 (SscmaAnalytics, 1);
+
+  analytics->tracks = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, g_free);
+  return analytics;
+}
+
+/**
+ * @brief Free the analytics.
+ */
+void
+sscma_analytics_free (SscmaAnalytics * analytics)
+{
+  if (analytics == NULL)
+    return;
+
+  g_hash_table_destroy (analytics->tracks);
+  g_free (analytics);
+}
+
+/**
+ * @brief Check if any line or zone is configured.
+ */
+gboolean
+sscma_analytics_is_active (const SscmaAnalytics * analytics)
+{
+  return analytics->n_lines > 0 || analytics->n_zones > 0;
+}
+
+/**
+ * @brief Forget the tracks and clear the counters (e.g., on a new stream).
+ */
+void
+sscma_analytics_reset (SscmaAnalytics * analytics)
+{
+  guint i;
+
+  g_hash_table_remove_all (analytics->tracks);
+  for (i = 0; i < analytics->n_lines; i++)
+    analytics->lines[i].forward = analytics->lines[i].backward = 0;
+  for (i = 0; i < analytics->n_zones; i++) {
+    analytics->zones[i].occupancy = 0;
+    analytics->zones[i].entries = 0;
+  }
+}
+
+/**
+ * @brief Set the counting lines, "x1,y1,x2,y2" separated with ';'.
+ * Coordinates are pixels, or fractions of the frame if all are within [0, 1].
+ * @return FALSE (keeping the old lines) if a line is malformed.
+ */
+gboolean
+sscma_analytics_set_lines (SscmaAnalytics * analytics, const gchar * lines)
+{
+  SscmaLine parsed[SSCMA_ANALYTICS_MAX_ITEMS];
+  gchar **items;
+  guint i, n = 0;
+  gboolean ok = TRUE;
+
+  items = g_strsplit (lines ? lines : "", ";", -1);
+  for (i = 0; items[i] && ok; i++) {
+    gchar **values;
+    gdouble v[4];
+    guint k;
+
+    if (g_strstrip (items[i])[0] == '\0')
+      continue;
+
+    values = g_strsplit (items[i], ",", -1);
+    ok = (g_strv_length (values) == 4 && n < SSCMA_ANALYTICS_MAX_ITEMS);
+    for (k = 0; k < 4 && ok; k++) {
+      gchar *end = NULL;
+      const gchar *s = g_strstrip (values[k]);
+
+      v[k] = g_ascii_strtod (s, &end);
+      ok = (end != s && *end == '\0' && v[k] >= 0.0);
+    }
+    g_strfreev (values);
+    if (!ok) {
+      GST_WARNING ("Invalid line \"%s\": expected x1,y1,x2,y2.", items[i]);
+      break;
+    }
+
+    memset (&parsed[n], 0, sizeof (SscmaLine));
+    parsed[n].normalized = v[0] <= 1.0 && v[1] <= 1.0 && v[2] <= 1.0 &&
+        v[3] <= 1.0;
+    parsed[n].x1 = v[0];
+    parsed[n].y1 = v[1];
+    parsed[n].x2 = v[2];
+    parsed[n].y2 = v[3];
+    n++;
+  }
+  g_strfreev (items);
+  if (!ok)
+    return FALSE;
+
+  memcpy (analytics->lines, parsed, n * sizeof (SscmaLine));
+  analytics->n_lines = n;
+  return TRUE;
+}
+
+/**
+ * @brief Set the zones, in the format of the "roi" property.
+ * @return FALSE (keeping the old zones) if a zone is malformed.
+ */
+gboolean
+sscma_analytics_set_zones (SscmaAnalytics * analytics, const gchar * zones)
+{
+  GArray *regions;
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  regions = sscma_regions_parse (zones ? zones : "");
+  if (regions == NULL)
+    return FALSE;
+  if (regions->len > SSCMA_ANALYTICS_MAX_ITEMS) {
+    GST_WARNING ("At most %d zones are supported.", SSCMA_ANALYTICS_MAX_ITEMS);
+    g_array_unref (regions);
+    return FALSE;
+  }
+
+  memset (analytics->zones, 0, sizeof (analytics->zones));
+  for (i = 0; i < regions->len; i++)
+    analytics->zones[i].region = g_array_index (regions, SscmaRegion, i);
+  analytics->n_zones = regions->len;
+  g_array_unref (regions);
+
+  /* zone indices changed meaning */
+  g_hash_table_iter_init (&iter, analytics->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    ((SscmaAnalyticsTrack *) value)->zones = 0;
+  return TRUE;
+}
+
+/**
+ * @brief Check if the move p -> q crosses the line.
+ * @return 1 for forward, -1 for backward, 0 if it does not cross.
+ */
+static gint
+sscma_line_crossing (const SscmaLine * line, gint width, gint height,
+    gfloat px, gfloat py, gfloat qx, gfloat qy)
+{
+  gfloat sx = line->normalized ? width : 1.f;
+  gfloat sy = line->normalized ? height : 1.f;
+  gfloat ax = line->x1 * sx, ay = line->y1 * sy;
+  gfloat bx = line->x2 * sx, by = line->y2 * sy;
+  gfloat d1 = (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+  gfloat d2 = (bx - ax) * (qy - ay) - (by - ay) * (qx - ax);
+  gfloat d3 = (qx - px) * (ay - py) - (qy - py) * (ax - px);
+  gfloat d4 = (qx - px) * (by - py) - (qy - py) * (bx - px);
+
+  /* p and q on both sides of the line, a and b on both sides of the move */
+  if ((d1 < 0.f) == (d2 < 0.f) || (d3 < 0.f) == (d4 < 0.f))
+    return 0;
+  /* with y pointing down, a negative cross product is the left side */
+  return d1 < 0.f ? 1 : -1;
+}
+
+static GstStructure *
+sscma_analytics_zone_event (const gchar * name, guint zone,
+    gint tracking_id, gint class_id, gint model_id, GstClockTime timestamp)
+{
+  return gst_structure_new (name,
+      "zone", G_TYPE_UINT, zone,
+      "tracking-id", G_TYPE_INT, tracking_id,
+      "class-id", G_TYPE_INT, class_id,
+      "model-id", G_TYPE_INT, model_id,
+      "timestamp", G_TYPE_UINT64, timestamp, NULL);
+}
+
+static void
+sscma_analytics_set_dwell (GstStructure * event, GstClockTime entered,
+    GstClockTime left)
+{
+  GstClockTimeDiff dwell = GST_CLOCK_DIFF (entered, left);
+
+  gst_structure_set (event, "dwell", G_TYPE_UINT64, (guint64) MAX (dwell, 0),
+      NULL);
+}
+
+static gboolean
+sscma_analytics_track_expired (G_GNUC_UNUSED gpointer key, gpointer value,
+    gpointer user_data)
+{
+  SscmaAnalyticsTrack *track = (SscmaAnalyticsTrack *) value;
+  SscmaAnalytics *analytics = (SscmaAnalytics *) user_data;
+
+  return track->seen + SSCMA_ANALYTICS_TRACK_TTL < analytics->frame;
+}
+
+/**
+ * @brief Update the counters with the detections of a frame.
+ * Objects are located by the bottom centre of their box (where they stand).
+ * Line crossings and zone enter/exit need a tracking id; untracked objects
+ * only count towards zone occupancy.
+ * @param[out] events Receives a GstStructure per crossing, zone entry
+ * ("sscma-zone-enter") and zone exit ("sscma-zone-exit", with its dwell time).
+ */
+void
+sscma_analytics_update (SscmaAnalytics * analytics, GArray * results,
+    gint width, gint height, GstClockTime timestamp, GQueue * events)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i, l, z;
+
+  g_return_if_fail (analytics != NULL && results != NULL);
+
+  analytics->frame++;
+  for (z = 0; z < analytics->n_zones; z++)
+    analytics->zones[z].occupancy = 0;
+
+  for (i = 0; i < results->len; i++) {
+    const detectedObject *a = &g_array_index (results, detectedObject, i);
+    gfloat x = a->x + a->width / 2.f;
+    gfloat y = a->y + a->height;
+    SscmaAnalyticsTrack *track = NULL;
+    guint32 inside = 0;
+
+    for (z = 0; z < analytics->n_zones; z++) {
+      if (sscma_region_contains (&analytics->zones[z].region, width, height,
+              x, y)) {
+        inside |= 1u << z;
+        analytics->zones[z].occupancy++;
+      }
+    }
+
+    if (a->tracking_id < 0)
+      continue;
+
+    track = (SscmaAnalyticsTrack *) g_hash_table_lookup (analytics->tracks,
+        GINT_TO_POINTER (a->tracking_id));
+    if (track == NULL) {
+      track = g_new0 (SscmaAnalyticsTrack, 1);
+      track->x = x;
+      track->y = y;
+      g_hash_table_insert (analytics->tracks, GINT_TO_POINTER (a->tracking_id),
+          track);
+    }
+
+    for (l = 0; l < analytics->n_lines; l++) {
+      SscmaLine *line = &analytics->lines[l];
+      gint dir = sscma_line_crossing (line, width, height, track->x, track->y,
+          x, y);
+
+      if (dir == 0)
+        continue;
+      if (dir > 0)
+        line->forward++;
+      else
+        line->backward++;
+      g_queue_push_tail (events, gst_structure_new ("sscma-line-crossing",
+              "line", G_TYPE_UINT, l,
+              "direction", G_TYPE_INT, dir,
+              "tracking-id", G_TYPE_INT, a->tracking_id,
+              "class-id", G_TYPE_INT, a->class_id,
+              "model-id", G_TYPE_INT, a->model_id,
+              "timestamp", G_TYPE_UINT64, timestamp, NULL));
+    }
+
+    for (z = 0; z < analytics->n_zones; z++) {
+      guint32 bit = 1u << z;
+
+      if ((inside & bit) && !(track->zones & bit)) {
+        track->entered[z] = timestamp;
+        analytics->zones[z].entries++;
+        g_queue_push_tail (events, sscma_analytics_zone_event ("sscma-zone-enter",
+                z, a->tracking_id, a->class_id, a->model_id, timestamp));
+      } else if (!(inside & bit) && (track->zones & bit)) {
+        GstStructure *event = sscma_analytics_zone_event ("sscma-zone-exit", z,
+            a->tracking_id, a->class_id, a->model_id, timestamp);
+
+        sscma_analytics_set_dwell (event, track->entered[z], timestamp);
+        g_queue_push_tail (events, event);
+      }
+    }
+
+    track->x = x;
+    track->y = y;
+    track->class_id = a->class_id;
+    track->model_id = a->model_id;
+    track->zones = inside;
+    track->seen = analytics->frame;
+    track->last_ts = timestamp;
+  }
+
+  /* lost tracks leave their zones when they are forgotten */
+  g_hash_table_iter_init (&iter, analytics->tracks);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    SscmaAnalyticsTrack *track = (SscmaAnalyticsTrack *) value;
+
+    if (!sscma_analytics_track_expired (key, value, analytics))
+      continue;
+    for (z = 0; z < analytics->n_zones; z++) {
+      GstStructure *event;
+
+      if (!(track->zones & (1u << z)))
+        continue;
+      event = sscma_analytics_zone_event ("sscma-zone-exit", z,
+          GPOINTER_TO_INT (key), track->class_id, track->model_id,
+          track->last_ts);
+      sscma_analytics_set_dwell (event, track->entered[z], track->last_ts);
+      g_queue_push_tail (events, event);
+    }
+    g_hash_table_iter_remove (&iter);
+  }
+}
+
+/**
+ * @brief Get the counters, "lineN-forward", "lineN-backward", "zoneN-occupancy"
+ * and "zoneN-entries" for every line and zone N.
+ */
+GstStructure *
+sscma_analytics_get_counters (const SscmaAnalytics * analytics)
+{
+  GstStructure *counters = gst_structure_new_empty ("sscma-analytics");
+  guint i;
+
+  for (i = 0; i < analytics->n_lines; i++) {
+    gchar *forward = g_strdup_printf ("line%u-forward", i);
+    gchar *backward = g_strdup_printf ("line%u-backward", i);
+
+    gst_structure_set (counters,
+        forward, G_TYPE_UINT64, analytics->lines[i].forward,
+        backward, G_TYPE_UINT64, analytics->lines[i].backward, NULL);
+    g_free (forward);
+    g_free (backward);
+  }
+  for (i = 0; i < analytics->n_zones; i++) {
+    gchar *occupancy = g_strdup_printf ("zone%u-occupancy", i);
+    gchar *entries = g_strdup_printf ("zone%u-entries", i);
+
+    gst_structure_set (counters,
+        occupancy, G_TYPE_UINT, analytics->zones[i].occupancy,
+        entries, G_TYPE_UINT64, analytics->zones[i].entries, NULL);
+    g_free (occupancy);
+    g_free (entries);
+  }
+  return counters;
+}
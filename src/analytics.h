@@ -0,0 +1,23 @@
+#ifndef __GST_SSCMA_ANALYTICS_H__
+#define __GST_SSCMA_ANALYTICS_H__
+
+#include <gst/gst.h>
+
+/** the most lines or zones that can be configured */
+#define SSCMA_ANALYTICS_MAX_ITEMS (32)
+
+typedef struct _SscmaAnalytics SscmaAnalytics;
+
+SscmaAnalytics *sscma_analytics_new (void);
+void sscma_analytics_free (SscmaAnalytics * analytics);
+gboolean sscma_analytics_set_lines (SscmaAnalytics * analytics,
+    const gchar * lines);
+gboolean sscma_analytics_set_zones (SscmaAnalytics * analytics,
+    const gchar * zones);
+gboolean sscma_analytics_is_active (const SscmaAnalytics * analytics);
+void sscma_analytics_reset (SscmaAnalytics * analytics);
+void sscma_analytics_update (SscmaAnalytics * analytics, GArray * results,
+    gint width, gint height, GstClockTime timestamp, GQueue * events);
+GstStructure *sscma_analytics_get_counters (const SscmaAnalytics * analytics);
+
+#endif /* __GST_SSCMA_ANALYTICS_H__ */
@@ -0,0 +1,132 @@
+#include <string.h>
+#include <net.h>
+#include "classifier.h"
+
+/**
+ * @brief A second-stage classification model run on detected crops.
+ */
+struct _SscmaClassifier
+{
+  ncnn::Net net;
+  gint input_width;
+  gint input_height;
+  gchar *input_name; /**< input blob */
+  gchar *output_name; /**< blob of the class scores */
+  gfloat mean[3]; /**< per channel mean, see SscmaClassifierConfig */
+  gfloat norm[3]; /**< per channel scale, see SscmaClassifierConfig */
+  ncnn::Mat in; /**< model input, reused for every crop */
+};
+
+/**
+ * @brief Check a blob is one of names, listing them if it is not.
+ */
+static gboolean
+sscma_classifier_has_blob (const gchar * kind, const gchar * name,
+    const std::vector < const char *>&names)
+{
+  GString *list;
+  guint i;
+
+  for (i = 0; i < names.size (); i++) {
+    if (g_str_equal (names[i], name))
+      return TRUE;
+  }
+  list = g_string_new (NULL);
+  for (i = 0; i < names.size (); i++)
+    g_string_append_printf (list, "%s%s", i ? ", " : "", names[i]);
+  g_print ("sscma_yolov5: The secondary model has no %s blob %s, it has %s.\n",
+      kind, name, list->str);
+  g_string_free (list, TRUE);
+  return FALSE;
+}
+
+/**
+ * @brief Load a classification model.
+ * @return NULL if the model cannot be loaded or lacks the configured blobs.
+ */
+SscmaClassifier *
+sscma_classifier_new (const gchar * param_path, const gchar * model_path,
+    gint input_width, gint input_height, const SscmaClassifierConfig * config)
+{
+  SscmaClassifier *classifier;
+
+  g_return_val_if_fail (param_path != NULL && model_path != NULL, NULL);
+  g_return_val_if_fail (input_width > 0 && input_height > 0, NULL);
+  g_return_val_if_fail (config != NULL && config->input_name != NULL &&
+      config->output_name != NULL, NULL);
+
+  classifier = new SscmaClassifier;
+  classifier->input_width = input_width;
+  classifier->input_height = input_height;
+  classifier->input_name = g_strdup (config->input_name);
+  classifier->output_name = g_strdup (config->output_name);
+  memcpy (classifier->mean, config->mean, sizeof (classifier->mean));
+  memcpy (classifier->norm, config->norm, sizeof (classifier->norm));
+
+  if (classifier->net.load_param (param_path) != 0 ||
+      classifier->net.load_model (model_path) != 0) {
+    GST_WARNING ("Failed to load the secondary model %s, %s.", param_path,
+        model_path);
+    sscma_classifier_free (classifier);
+    return NULL;
+  }
+  /* every crop would fail to extract otherwise */
+  if (!sscma_classifier_has_blob ("input", classifier->input_name,
+          classifier->net.input_names ()) ||
+      !sscma_classifier_has_blob ("output", classifier->output_name,
+          classifier->net.output_names ())) {
+    sscma_classifier_free (classifier);
+    return NULL;
+  }
+  return classifier;
+}
+
+/**
+ * @brief Free a classification model.
+ */
+void
+sscma_classifier_free (SscmaClassifier * classifier)
+{
+  if (classifier == NULL)
+    return;
+  g_free (classifier->input_name);
+  g_free (classifier->output_name);
+  delete classifier;
+}
+
+/**
+ * @brief Classify one rectangle of the image.
+ * @param[out] class_id Index of the best scoring class.
+ * @param[out] score Its raw score.
+ */
+gboolean
+sscma_classifier_classify (SscmaClassifier * classifier,
+    const SscmaImage * image, const SscmaRect * roi, gint * class_id,
+    gfloat * score)
+{
+  ncnn::Mat out;
+  const gfloat *scores;
+  gint i, n;
+
+  g_return_val_if_fail (classifier != NULL, FALSE);
+
+  if (!sscma_preprocess (image, roi, classifier->input_width,
+          classifier->input_height, classifier->mean, classifier->norm,
+          classifier->in))
+    return FALSE;
+
+  ncnn::Extractor ex = classifier->net.create_extractor ();
+  ex.input (classifier->input_name, classifier->in);
+  if (ex.extract (classifier->output_name, out) != 0 || out.total () == 0)
+    return FALSE;
+
+  scores = (const gfloat *) out.data;
+  n = (gint) out.total ();
+  *class_id = 0;
+  for (i = 1; i < n; i++) {
+    if (scores[i] > scores[*class_id])
+      *class_id = i;
+  }
+  *score = scores[*class_id];
+  return TRUE;
+}
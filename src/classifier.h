@@ -0,0 +1,29 @@
+#ifndef __GST_SSCMA_CLASSIFIER_H__
+#define __GST_SSCMA_CLASSIFIER_H__
+
+#include <gst/gst.h>
+#include "preprocess.h"
+
+typedef struct _SscmaClassifier SscmaClassifier;
+
+/**
+ * @brief How the crops are fed to a classification model and read back,
+ * the same settings as the input and output of a detector bundle.
+ */
+typedef struct
+{
+  const gchar *input_name; /**< input blob of the model */
+  const gchar *output_name; /**< output blob holding one score per class */
+  gfloat mean[3]; /**< per channel (R, G, B) mean subtracted from the 0..255 values */
+  gfloat norm[3]; /**< per channel (R, G, B) scale applied after the mean */
+} SscmaClassifierConfig;
+
+SscmaClassifier *sscma_classifier_new (const gchar * param_path,
+    const gchar * model_path, gint input_width, gint input_height,
+    const SscmaClassifierConfig * config);
+void sscma_classifier_free (SscmaClassifier * classifier);
+gboolean sscma_classifier_classify (SscmaClassifier * classifier,
+    const SscmaImage * image, const SscmaRect * roi, gint * class_id,
+    gfloat * score);
+
+#endif /* __GST_SSCMA_CLASSIFIER_H__ */
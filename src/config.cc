@@ -0,0 +1,312 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include <yaml-cpp/yaml.h>
+#include "config.h"
+
+/** default input and output blob names of the exported models */
+#define DEFAULT_INPUT_NAME "in0"
+#define DEFAULT_OUTPUT_NAME "out0"
+
+/** path -> SscmaModelConfig, every bundle is read and checked once */
+static GHashTable *sscma_config_cache = NULL;
+static GMutex sscma_config_lock;
+
+/**
+ * @brief Get the modification time of a file in nanoseconds, so a bundle
+ * rewritten within the second it was read is still noticed.
+ */
+static gint64
+sscma_model_config_mtime (const GStatBuf * st)
+{
+#if defined(__linux__)
+  return (gint64) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#else
+  return (gint64) st->st_mtime * 1000000000;
+#endif
+}
+
+/**
+ * @brief Resolve a path of the bundle against the directory of the YAML file.
+ */
+static gchar *
+sscma_model_config_resolve (const gchar * dir, const std::string & path)
+{
+  if (g_path_is_absolute (path.c_str ()))
+    return g_strdup (path.c_str ());
+  return g_build_filename (dir, path.c_str (), NULL);
+}
+
+/**
+ * @brief Read up to n numbers of a sequence.
+ * @return The number of values read, -1 if node is not a sequence of numbers.
+ */
+static gint
+sscma_model_config_numbers (const YAML::Node & node, gdouble * values, gint n)
+{
+  gint i;
+
+  if (!node.IsSequence () || (gint) node.size () > n)
+    return -1;
+  for (i = 0; i < (gint) node.size (); i++)
+    values[i] = node[i].as<double> ();
+  return i;
+}
+
+/**
+ * @brief Read the labels, a list or the path of a file with one label per line.
+ */
+static gchar **
+sscma_model_config_labels (const gchar * dir, const YAML::Node & node)
+{
+  GPtrArray *labels;
+  gchar *path, *contents = NULL;
+  gchar **lines;
+  gsize len;
+  guint i;
+
+  if (node.IsSequence ()) {
+    labels = g_ptr_array_new ();
+    for (i = 0; i < node.size (); i++)
+      g_ptr_array_add (labels, g_strdup (node[i].as<std::string> ().c_str ()));
+    g_ptr_array_add (labels, NULL);
+    return (gchar **) g_ptr_array_free (labels, FALSE);
+  }
+
+  path = sscma_model_config_resolve (dir, node.as<std::string> ());
+  if (!g_file_get_contents (path, &contents, &len, NULL)) {
+    g_print ("sscma_yolov5: Cannot read the labels %s.\n", path);
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+
+  /* same format as the labels property */
+  if (len > 0 && contents[len - 1] == '\n')
+    contents[len - 1] = '\0';
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+  return lines;
+}
+
+/**
+ * @brief Read a bundle and check it is consistent.
+ * @return NULL if the file cannot be read or describes an unusable model.
+ */
+static SscmaModelConfig *
+sscma_model_config_parse (const gchar * path, gint64 mtime, gint64 size)
+{
+  SscmaModelConfig *config = g_new0 (SscmaModelConfig, 1);
+  gchar *dir = g_path_get_dirname (path);
+  const gchar *error = NULL;
+  gdouble v[3];
+  gint i;
+
+  config->ref_count = 1;
+  config->path = g_strdup (path);
+  config->mtime = mtime;
+  config->size = size;
+  config->conf_threshold = -1.f;
+  config->iou_threshold = -1.f;
+  config->max_detections = -1;
+
+  /* yaml-cpp reports malformed files and wrong value types by exceptions */
+  try {
+    YAML::Node root = YAML::LoadFile (path);
+    YAML::Node model = root["model"];
+    YAML::Node input = root["input"];
+    YAML::Node output = root["output"];
+    YAML::Node thresholds = root["thresholds"];
+
+    if (!model || !model["bin"] || !model["param"]) {
+      error = "model: bin and param are required";
+      goto done;
+    }
+    config->bin = sscma_model_config_resolve (dir,
+        model["bin"].as<std::string> ());
+    config->param = sscma_model_config_resolve (dir,
+        model["param"].as<std::string> ());
+    if (!g_file_test (config->bin, G_FILE_TEST_IS_REGULAR) ||
+        !g_file_test (config->param, G_FILE_TEST_IS_REGULAR)) {
+      error = "model: bin or param does not exist";
+      goto done;
+    }
+
+    /* input: the shape is channel:width:height, like the input property */
+    if (!input || sscma_model_config_numbers (input["shape"], v, 3) != 3) {
+      error = "input: shape must be [channels, width, height]";
+      goto done;
+    }
+    config->input_channels = (gint) v[0];
+    config->input_width = (gint) v[1];
+    config->input_height = (gint) v[2];
+    if (config->input_channels != 3 || config->input_width <= 0 ||
+        config->input_height <= 0) {
+      error = "input: only 3 channel inputs of a positive size are supported";
+      goto done;
+    }
+    config->input_name = g_strdup (input["name"] ?
+        input["name"].as<std::string> ().c_str () : DEFAULT_INPUT_NAME);
+    for (i = 0; i < 3; i++) {
+      config->mean[i] = 0.f;
+      config->norm[i] = 1 / 255.f;
+    }
+    if (input["mean"]) {
+      if (sscma_model_config_numbers (input["mean"], v, 3) != 3) {
+        error = "input: mean must have 3 values";
+        goto done;
+      }
+      for (i = 0; i < 3; i++)
+        config->mean[i] = (gfloat) v[i];
+    }
+    if (input["norm"]) {
+      if (sscma_model_config_numbers (input["norm"], v, 3) != 3) {
+        error = "input: norm must have 3 values";
+        goto done;
+      }
+      for (i = 0; i < 3; i++)
+        config->norm[i] = (gfloat) v[i];
+    }
+
+    /* output: the shape is values per anchor:anchors, like the output property */
+    if (!output || sscma_model_config_numbers (output["shape"], v, 2) != 2 ||
+        v[0] <= SSCMA_DECODER_BOX_INFO || v[1] <= 0) {
+      error = "output: shape must be [5 + classes, anchors]";
+      goto done;
+    }
+    config->n_classes = (guint) v[0] - SSCMA_DECODER_BOX_INFO;
+    config->n_anchors = (guint) v[1];
+    config->output_name = g_strdup (output["name"] ?
+        output["name"].as<std::string> ().c_str () : DEFAULT_OUTPUT_NAME);
+    config->layout = SSCMA_OUTPUT_LAYOUT_NC;
+    if (output["layout"]) {
+      std::string layout = output["layout"].as<std::string> ();
+
+      if (!sscma_output_layout_from_string (layout.c_str (), &config->layout)) {
+        error = "output: layout must be nc or cn";
+        goto done;
+      }
+    }
+    config->output_type = _TENOR_FLOAT32;
+    if (output["type"])
+      config->output_type =
+          gst_tensor_get_type (output["type"].as<std::string> ().c_str ());
+    if (sscma_decoder_select (config->layout, config->output_type,
+            config->n_classes) == NULL) {
+      error = "output: type must be float32, float16, int8 or uint8";
+      goto done;
+    }
+    /* quantized outputs, real = scale * (q - zero-point) */
+    config->output_scale = output["scale"] ? output["scale"].as<float> () : 1.f;
+    config->output_zero_point =
+        output["zero-point"] ? output["zero-point"].as<int> () : 0;
+    if (!(config->output_scale > 0.f)) {
+      error = "output: scale must be positive";
+      goto done;
+    }
+    if (!sscma_decoder_zero_point_valid (config->output_type,
+            config->output_zero_point)) {
+      error = "output: zero-point must be within -128..127 for int8 and 0..255 for uint8";
+      goto done;
+    }
+
+    if (thresholds) {
+      if (thresholds["conf"])
+        config->conf_threshold = thresholds["conf"].as<float> ();
+      if (thresholds["iou"])
+        config->iou_threshold = thresholds["iou"].as<float> ();
+      if (thresholds["max-detections"])
+        config->max_detections = thresholds["max-detections"].as<int> ();
+    }
+
+    /* the labels name the classes, a mismatch would shift them all */
+    if (!root["labels"] ||
+        !(config->labels = sscma_model_config_labels (dir, root["labels"]))) {
+      error = "labels: a list or a label file is required";
+      goto done;
+    }
+    if (g_strv_length (config->labels) != config->n_classes) {
+      error = "labels: one label per class of the output shape is required";
+      goto done;
+    }
+  } catch (const YAML::Exception & e) {
+    g_print ("sscma_yolov5: Cannot parse the config %s: %s\n", path, e.what ());
+    g_free (dir);
+    sscma_model_config_unref (config);
+    return NULL;
+  }
+
+done:
+  g_free (dir);
+  if (error) {
+    g_print ("sscma_yolov5: Invalid config %s, %s.\n", path, error);
+    sscma_model_config_unref (config);
+    return NULL;
+  }
+  return config;
+}
+
+/**
+ * @brief Get the bundle of a YAML file. Bundles are cached by path and only
+ * read again when the modification time or the size of the file changes.
+ * @return A reference on the bundle, NULL if it is invalid.
+ */
+SscmaModelConfig *
+sscma_model_config_load (const gchar * path)
+{
+  SscmaModelConfig *config;
+  GStatBuf st;
+  gint64 mtime;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (g_stat (path, &st) != 0) {
+    g_print ("sscma_yolov5: Cannot find the config %s.\n", path);
+    return NULL;
+  }
+
+  mtime = sscma_model_config_mtime (&st);
+  g_mutex_lock (&sscma_config_lock);
+  if (sscma_config_cache == NULL)
+    sscma_config_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) sscma_model_config_unref);
+
+  config = (SscmaModelConfig *) g_hash_table_lookup (sscma_config_cache, path);
+  if (config == NULL || config->mtime != mtime ||
+      config->size != (gint64) st.st_size) {
+    config = sscma_model_config_parse (path, mtime, st.st_size);
+    if (config)
+      g_hash_table_replace (sscma_config_cache, config->path, config);
+  }
+  if (config)
+    sscma_model_config_ref (config);
+  g_mutex_unlock (&sscma_config_lock);
+  return config;
+}
+
+/**
+ * @brief Take a reference on a bundle.
+ */
+SscmaModelConfig *
+sscma_model_config_ref (SscmaModelConfig * config)
+{
+  g_atomic_int_inc (&config->ref_count);
+  return config;
+}
+
+/**
+ * @brief Drop a reference on a bundle, freeing it with the last one.
+ */
+void
+sscma_model_config_unref (SscmaModelConfig * config)
+{
+  if (config == NULL || !g_atomic_int_dec_and_test (&config->ref_count))
+    return;
+
+  g_free (config->path);
+  g_free (config->bin);
+  g_free (config->param);
+  g_free (config->input_name);
+  g_free (config->output_name);
+  g_strfreev (config->labels);
+  g_free (config);
+}
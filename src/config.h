@@ -0,0 +1,48 @@
+#ifndef __GST_SSCMA_CONFIG_H__
+#define __GST_SSCMA_CONFIG_H__
+
+#include <gst/gst.h>
+#include "tensor_info.h"
+#include "decoder.h"
+
+/**
+ * @brief A model bundle read from a YAML file, checked once when loaded.
+ * Shared and read-only once loaded, see sscma_model_config_load().
+ */
+typedef struct
+{
+  gint ref_count; /**< references, the cache holds one */
+  gchar *path; /**< the YAML file */
+  gint64 mtime; /**< modification time of the YAML file when it was read, in ns */
+  gint64 size; /**< size of the YAML file when it was read */
+
+  gchar *bin; /**< model.bin, relative paths are resolved against the YAML file */
+  gchar *param; /**< model.param */
+
+  gchar *input_name; /**< input blob of the model */
+  gint input_channels; /**< model input channels, 3 */
+  gint input_width; /**< model input width */
+  gint input_height; /**< model input height */
+  gfloat mean[3]; /**< per channel (R, G, B) mean subtracted from the 0..255 values */
+  gfloat norm[3]; /**< per channel (R, G, B) scale applied after the mean */
+
+  gchar *output_name; /**< output blob of the model */
+  SscmaOutputLayout layout; /**< layout of the output */
+  tensor_type output_type; /**< element type of the output */
+  gfloat output_scale; /**< real value of one step of an int8/uint8 output */
+  gint output_zero_point; /**< int8/uint8 value of a real zero */
+  guint n_anchors; /**< output rows */
+  guint n_classes; /**< class scores after the box and objectness of a row */
+
+  gfloat conf_threshold; /**< minimum class score * objectness, negative if not set */
+  gfloat iou_threshold; /**< NMS overlap threshold, negative if not set */
+  gint max_detections; /**< detections kept per frame, negative if not set */
+
+  gchar **labels; /**< one per class */
+} SscmaModelConfig;
+
+SscmaModelConfig *sscma_model_config_load (const gchar * path);
+SscmaModelConfig *sscma_model_config_ref (SscmaModelConfig * config);
+void sscma_model_config_unref (SscmaModelConfig * config);
+
+#endif /* __GST_SSCMA_CONFIG_H__ */
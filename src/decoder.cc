@@ -0,0 +1,396 @@
+#include <vector>
+#include <net.h>
+#include "decoder.h"
+
+/**
+ * @brief How the elements of an output type are compared and dequantized.
+ * Class scores and objectness are compared as Key, which orders like the
+ * real value for everything above zero(); the threshold is turned into the
+ * units of product() once per output, and only the anchors passing it are
+ * dequantized with value().
+ */
+template <typename T>
+struct SscmaDecoderType;
+
+/** @brief float32, the values themselves. */
+template <>
+struct SscmaDecoderType<gfloat>
+{
+  typedef gfloat Key;
+
+  static inline Key key (gfloat v) { return v; }
+  static inline Key zero (const SscmaDecodeParams *) { return 0.f; }
+  static inline gfloat threshold (const SscmaDecodeParams * p)
+  {
+    return p->conf_threshold;
+  }
+  static inline gfloat product (Key a, Key b, const SscmaDecodeParams *)
+  {
+    return a * b;
+  }
+  static inline gfloat prob (Key a, Key b, const SscmaDecodeParams *)
+  {
+    return a * b;
+  }
+  static inline gfloat value (gfloat v, const SscmaDecodeParams *) { return v; }
+};
+
+/**
+ * @brief float16. The bits of a positive half order like its value when read
+ * as a signed 16-bit integer, and every negative half reads as negative, so
+ * the scans need no conversion.
+ */
+template <>
+struct SscmaDecoderType<guint16>
+{
+  typedef gint16 Key;
+
+  static inline Key key (guint16 v) { return (gint16) v; }
+  static inline Key zero (const SscmaDecodeParams *) { return 0; }
+  static inline gfloat threshold (const SscmaDecodeParams * p)
+  {
+    return p->conf_threshold;
+  }
+  static inline gfloat product (Key a, Key b, const SscmaDecodeParams *)
+  {
+    return ncnn::float16_to_float32 ((guint16) a) *
+        ncnn::float16_to_float32 ((guint16) b);
+  }
+  static inline gfloat prob (Key a, Key b, const SscmaDecodeParams * p)
+  {
+    return product (a, b, p);
+  }
+  static inline gfloat value (guint16 v, const SscmaDecodeParams *)
+  {
+    return ncnn::float16_to_float32 (v);
+  }
+};
+
+/**
+ * @brief int8 and uint8, real = scale * (q - zero_point). Scores are compared
+ * as they are and the threshold is divided by scale^2 once, so the test of
+ * an anchor is one integer product.
+ */
+template <typename Q>
+struct SscmaDecoderQuantized
+{
+  typedef Q Key;
+
+  static inline Key key (Q v) { return v; }
+  static inline Key zero (const SscmaDecodeParams * p)
+  {
+    return (Q) p->zero_point;
+  }
+  static inline gfloat threshold (const SscmaDecodeParams * p)
+  {
+    return p->conf_threshold / (p->scale * p->scale);
+  }
+  static inline gfloat product (Key a, Key b, const SscmaDecodeParams * p)
+  {
+    return (gfloat) (((gint) a - p->zero_point) * ((gint) b - p->zero_point));
+  }
+  static inline gfloat prob (Key a, Key b, const SscmaDecodeParams * p)
+  {
+    return product (a, b, p) * p->scale * p->scale;
+  }
+  static inline gfloat value (Q v, const SscmaDecodeParams * p)
+  {
+    return p->scale * ((gint) v - p->zero_point);
+  }
+};
+
+template <>
+struct SscmaDecoderType<gint8> : SscmaDecoderQuantized<gint8>
+{
+};
+
+template <>
+struct SscmaDecoderType<guint8> : SscmaDecoderQuantized<guint8>
+{
+};
+
+/**
+ * @brief Value i (0..3 box, 4 objectness, then the class scores) of anchor a
+ * in an output of n anchors of stride values each.
+ */
+template <typename T, SscmaOutputLayout L>
+static inline T
+sscma_decoder_at (const T * data, guint n, guint stride, guint a, guint i)
+{
+  if (L == SSCMA_OUTPUT_LAYOUT_NC)
+    return data[(gsize) a * stride + i];
+  return data[(gsize) i * n + a];
+}
+
+/**
+ * @brief Append anchor a as a candidate, dequantizing its box.
+ */
+template <typename T, SscmaOutputLayout L>
+static inline void
+sscma_decoder_emit (const T * data, const SscmaDecodeParams * p, guint stride,
+    guint a, guint class_id, gfloat prob, GArray * candidates)
+{
+  typedef SscmaDecoderType<T> E;
+  const guint n = p->n_anchors;
+  SscmaCandidate c;
+
+  c.cx = E::value (sscma_decoder_at<T, L> (data, n, stride, a, 0), p);
+  c.cy = E::value (sscma_decoder_at<T, L> (data, n, stride, a, 1), p);
+  c.w = E::value (sscma_decoder_at<T, L> (data, n, stride, a, 2), p);
+  c.h = E::value (sscma_decoder_at<T, L> (data, n, stride, a, 3), p);
+  c.prob = prob;
+  c.class_id = class_id;
+  g_array_append_val (candidates, c);
+}
+
+/**
+ * @brief Decode looking only at the allowed classes.
+ */
+template <typename T, SscmaOutputLayout L>
+static void
+sscma_decode_allowed (const T * data, const SscmaDecodeParams * p,
+    GArray * candidates)
+{
+  typedef SscmaDecoderType<T> E;
+  typedef typename E::Key K;
+  const guint n = p->n_anchors;
+  const guint stride = p->n_classes + SSCMA_DECODER_BOX_INFO;
+  const K zero = E::zero (p);
+  const gfloat threshold = E::threshold (p);
+  guint a, k;
+
+  for (a = 0; a < n; a++) {
+    K obj = E::key (sscma_decoder_at<T, L> (data, n, stride, a, 4));
+    K best = zero;
+    guint best_i = 0;
+
+    /* the threshold is never negative, so neither can the product be */
+    if (obj <= zero)
+      continue;
+    for (k = 0; k < p->n_allowed; k++) {
+      K s = E::key (sscma_decoder_at<T, L> (data, n, stride, a,
+              SSCMA_DECODER_BOX_INFO + p->allowed[k]));
+      if (s > best) {
+        best = s;
+        best_i = p->allowed[k];
+      }
+    }
+    if (best > zero && E::product (best, obj, p) > threshold)
+      sscma_decoder_emit<T, L> (data, p, stride, a, best_i,
+          E::prob (best, obj, p), candidates);
+  }
+}
+
+/**
+ * @brief Decode an output of one row per anchor. With N classes known at
+ * compile time the class scan has a constant trip count; it only computes
+ * the maximum, branch-free so it unrolls and vectorizes, and the index of
+ * the maximum is only looked for on the few anchors above the threshold.
+ */
+template <typename T, guint N>
+static void
+sscma_decode_rows (const T * data, const SscmaDecodeParams * p,
+    GArray * candidates)
+{
+  typedef SscmaDecoderType<T> E;
+  typedef typename E::Key K;
+  const guint n_classes = N ? N : p->n_classes;
+  const guint stride = n_classes + SSCMA_DECODER_BOX_INFO;
+  const K zero = E::zero (p);
+  const gfloat threshold = E::threshold (p);
+  const T *row = data;
+  guint a, i;
+
+  for (a = 0; a < p->n_anchors; a++, row += stride) {
+    const T *scores = row + SSCMA_DECODER_BOX_INFO;
+    K obj = E::key (row[4]);
+    K best = zero;
+
+    if (obj <= zero)
+      continue;
+    for (i = 0; i < n_classes; i++) {
+      K s = E::key (scores[i]);
+      best = s > best ? s : best;
+    }
+    /* written so that a NaN half fails it */
+    if (best <= zero || !(E::product (best, obj, p) > threshold))
+      continue;
+
+    /* the first class reaching the maximum, as a strict > scan would pick */
+    for (i = 0; E::key (scores[i]) != best; i++);
+    sscma_decoder_emit<T, SSCMA_OUTPUT_LAYOUT_NC> (data, p, stride, a, i,
+        E::prob (best, obj, p), candidates);
+  }
+}
+
+/**
+ * @brief Decode an output of one row per value. The maximum class score is
+ * built a class row at a time across all anchors, so every pass is a
+ * contiguous, vectorizable sweep instead of a strided walk per anchor.
+ */
+template <typename T, guint N>
+static void
+sscma_decode_columns (const T * data, const SscmaDecodeParams * p,
+    GArray * candidates)
+{
+  typedef SscmaDecoderType<T> E;
+  typedef typename E::Key K;
+  /* one per thread, the extra models decode on the worker pool */
+  static thread_local std::vector<K> best;
+  const guint n_classes = N ? N : p->n_classes;
+  const guint stride = n_classes + SSCMA_DECODER_BOX_INFO;
+  const guint n = p->n_anchors;
+  const K zero = E::zero (p);
+  const gfloat threshold = E::threshold (p);
+  const T *obj = data + 4 * (gsize) n;
+  guint a, i;
+
+  best.assign (n, zero);
+  for (i = 0; i < n_classes; i++) {
+    const T *scores = data + (SSCMA_DECODER_BOX_INFO + i) * (gsize) n;
+    K *b = best.data ();
+
+    for (a = 0; a < n; a++) {
+      K s = E::key (scores[a]);
+      b[a] = s > b[a] ? s : b[a];
+    }
+  }
+
+  for (a = 0; a < n; a++) {
+    K o = E::key (obj[a]);
+
+    if (o <= zero || best[a] <= zero ||
+        !(E::product (best[a], o, p) > threshold))
+      continue;
+    for (i = 0; E::key (data[(SSCMA_DECODER_BOX_INFO + i) * (gsize) n + a]) !=
+        best[a]; i++);
+    sscma_decoder_emit<T, SSCMA_OUTPUT_LAYOUT_CN> (data, p, stride, a, i,
+        E::prob (best[a], o, p), candidates);
+  }
+}
+
+/**
+ * @brief A decoder of T elements in layout L for N classes, 0 for any
+ * number of classes.
+ */
+template <typename T, SscmaOutputLayout L, guint N>
+static void
+sscma_decode (const void *data, const SscmaDecodeParams * params,
+    GArray * candidates)
+{
+  const T *values = (const T *) data;
+
+  if (params->allowed) {
+    sscma_decode_allowed<T, L> (values, params, candidates);
+    return;
+  }
+  if (L == SSCMA_OUTPUT_LAYOUT_NC)
+    sscma_decode_rows<T, N> (values, params, candidates);
+  else
+    sscma_decode_columns<T, N> (values, params, candidates);
+}
+
+/**
+ * @brief Pick the decoder of T elements in layout L for a number of classes.
+ */
+template <typename T, SscmaOutputLayout L>
+static SscmaDecodeFunc
+sscma_decoder_select_classes (guint n_classes)
+{
+  /* single class detectors, pairs, rock/paper/scissors, meters, VOC and COCO */
+  switch (n_classes) {
+    case 1:
+      return sscma_decode<T, L, 1>;
+    case 2:
+      return sscma_decode<T, L, 2>;
+    case 3:
+      return sscma_decode<T, L, 3>;
+    case 10:
+      return sscma_decode<T, L, 10>;
+    case 20:
+      return sscma_decode<T, L, 20>;
+    case 80:
+      return sscma_decode<T, L, 80>;
+    default:
+      return sscma_decode<T, L, 0>;
+  }
+}
+
+/**
+ * @brief Pick the decoder of T elements for a layout.
+ */
+template <typename T>
+static SscmaDecodeFunc
+sscma_decoder_select_layout (SscmaOutputLayout layout, guint n_classes)
+{
+  switch (layout) {
+    case SSCMA_OUTPUT_LAYOUT_NC:
+      return sscma_decoder_select_classes<T, SSCMA_OUTPUT_LAYOUT_NC> (n_classes);
+    case SSCMA_OUTPUT_LAYOUT_CN:
+      return sscma_decoder_select_classes<T, SSCMA_OUTPUT_LAYOUT_CN> (n_classes);
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief Pick the decoder of an output, once when its shape is known.
+ * @param layout Layout of the output.
+ * @param type Element type of the output: float32, float16, int8 or uint8.
+ * @param n_classes Class scores of an anchor.
+ * @return NULL if the element type is not supported.
+ */
+SscmaDecodeFunc
+sscma_decoder_select (SscmaOutputLayout layout, tensor_type type,
+    guint n_classes)
+{
+  if (n_classes == 0)
+    return NULL;
+
+  switch (type) {
+    case _TENOR_FLOAT32:
+      return sscma_decoder_select_layout<gfloat> (layout, n_classes);
+    case _TENOR_FLOAT16:
+      return sscma_decoder_select_layout<guint16> (layout, n_classes);
+    case _TENOR_INT8:
+      return sscma_decoder_select_layout<gint8> (layout, n_classes);
+    case _TENOR_UINT8:
+      return sscma_decoder_select_layout<guint8> (layout, n_classes);
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief Check that a zero point is a value of the output element type.
+ * @return FALSE if an int8 or uint8 output cannot hold zero_point.
+ */
+gboolean
+sscma_decoder_zero_point_valid (tensor_type type, gint zero_point)
+{
+  switch (type) {
+    case _TENOR_INT8:
+      return zero_point >= G_MININT8 && zero_point <= G_MAXINT8;
+    case _TENOR_UINT8:
+      return zero_point >= 0 && zero_point <= G_MAXUINT8;
+    default:
+      /* not used by float outputs */
+      return TRUE;
+  }
+}
+
+/**
+ * @brief Parse the name of a layout, "nc" or "cn".
+ * @return FALSE if str names no layout.
+ */
+gboolean
+sscma_output_layout_from_string (const gchar * str, SscmaOutputLayout * layout)
+{
+  if (g_ascii_strcasecmp (str, "nc") == 0)
+    *layout = SSCMA_OUTPUT_LAYOUT_NC;
+  else if (g_ascii_strcasecmp (str, "cn") == 0)
+    *layout = SSCMA_OUTPUT_LAYOUT_CN;
+  else
+    return FALSE;
+  return TRUE;
+}
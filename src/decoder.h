@@ -0,0 +1,58 @@
+#ifndef __GST_SSCMA_DECODER_H__
+#define __GST_SSCMA_DECODER_H__
+
+#include <gst/gst.h>
+#include "tensor_info.h"
+
+/** box and objectness values in front of the class scores of an anchor */
+#define SSCMA_DECODER_BOX_INFO (5)
+
+/**
+ * @brief How the detections are laid out in the model output.
+ */
+typedef enum
+{
+  SSCMA_OUTPUT_LAYOUT_NC = 0, /**< one row of cx, cy, w, h, objectness and class scores per anchor (YOLOv5) */
+  SSCMA_OUTPUT_LAYOUT_CN, /**< one row per value, each holding all the anchors (transposed exports) */
+} SscmaOutputLayout;
+
+/**
+ * @brief What a decoder needs to know about one model output.
+ */
+typedef struct
+{
+  guint n_anchors; /**< anchors in the output */
+  guint n_classes; /**< class scores of an anchor */
+  gfloat conf_threshold; /**< minimum class score * objectness, >= 0 */
+  const guint *allowed; /**< class indices to look at, NULL for all */
+  guint n_allowed; /**< number of allowed class indices */
+  gfloat scale; /**< real value of one step of an int8/uint8 output */
+  gint zero_point; /**< int8/uint8 value of a real zero */
+} SscmaDecodeParams;
+
+/**
+ * @brief An anchor scoring above the threshold, in model input pixels.
+ */
+typedef struct
+{
+  gfloat cx; /**< box centre x */
+  gfloat cy; /**< box centre y */
+  gfloat w; /**< box width */
+  gfloat h; /**< box height */
+  gfloat prob; /**< class score * objectness */
+  guint class_id; /**< best scoring class */
+} SscmaCandidate;
+
+/**
+ * @brief Scan a model output and append its SscmaCandidate to candidates.
+ */
+typedef void (*SscmaDecodeFunc) (const void *data,
+    const SscmaDecodeParams * params, GArray * candidates);
+
+SscmaDecodeFunc sscma_decoder_select (SscmaOutputLayout layout,
+    tensor_type type, guint n_classes);
+gboolean sscma_decoder_zero_point_valid (tensor_type type, gint zero_point);
+gboolean sscma_output_layout_from_string (const gchar * str,
+    SscmaOutputLayout * layout);
+
+#endif /* __GST_SSCMA_DECODER_H__ */
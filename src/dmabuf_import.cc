@@ -0,0 +1,256 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#if defined(__linux__)
+#include <linux/dma-buf.h>
+#endif
+#include <gst/allocators/allocators.h>
+
+#include "dmabuf_import.h"
+
+/**
+ * v4l2src cycles through a handful of buffers, so keeping their read-only
+ * mappings avoids an mmap/munmap pair per frame.
+ */
+#define SSCMA_DMABUF_CACHE_SIZE (16)
+
+/**
+ * @brief A cached read-only mapping of one dma-buf.
+ * The mapping holds a reference on the dma-buf, so its inode cannot be reused
+ * by another buffer while it is cached.
+ */
+typedef struct
+{
+  dev_t dev; /**< device of the dma-buf inode */
+  ino_t ino; /**< identity of the dma-buf behind the fd */
+  gsize size; /**< mapped length */
+  guint8 *addr; /**< read-only mapping, NULL if the slot is free */
+  guint64 last_use; /**< tick of the last lookup, for LRU eviction */
+} SscmaDmabufMapping;
+
+struct _SscmaDmabufCache
+{
+  SscmaDmabufMapping maps[SSCMA_DMABUF_CACHE_SIZE];
+  guint64 tick;
+};
+
+/**
+ * @brief Start or end CPU access to a dma-buf (cache maintenance on non-coherent SoCs).
+ */
+static void
+sscma_dmabuf_sync (gint fd, gboolean start)
+{
+#if defined(DMA_BUF_IOCTL_SYNC)
+  struct dma_buf_sync sync;
+
+  sync.flags = DMA_BUF_SYNC_READ |
+      (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
+  while (ioctl (fd, DMA_BUF_IOCTL_SYNC, &sync) < 0 &&
+      (errno == EINTR || errno == EAGAIN));
+#endif
+}
+
+static void
+sscma_dmabuf_mapping_release (SscmaDmabufMapping * map)
+{
+  if (map->addr) {
+    munmap (map->addr, map->size);
+    map->addr = NULL;
+  }
+}
+
+/**
+ * @brief Create an empty mapping cache.
+ */
+SscmaDmabufCache *
+sscma_dmabuf_cache_new (void)
+{
+  return g_new0 (SscmaDmabufCache, 1);
+}
+
+/**
+ * @brief Unmap all cached dma-bufs (e.g., on caps change or stop).
+ */
+void
+sscma_dmabuf_cache_clear (SscmaDmabufCache * cache)
+{
+  guint i;
+
+  g_return_if_fail (cache != NULL);
+
+  for (i = 0; i < SSCMA_DMABUF_CACHE_SIZE; i++)
+    sscma_dmabuf_mapping_release (&cache->maps[i]);
+}
+
+/**
+ * @brief Unmap everything and free the cache.
+ */
+void
+sscma_dmabuf_cache_free (SscmaDmabufCache * cache)
+{
+  if (cache == NULL)
+    return;
+
+  sscma_dmabuf_cache_clear (cache);
+  g_free (cache);
+}
+
+/**
+ * @brief Get the read-only mapping of the dma-buf behind fd, mapping it on a miss.
+ * @param size Set to the mapped length.
+ */
+static guint8 *
+sscma_dmabuf_cache_lookup (SscmaDmabufCache * cache, gint fd, gsize * size)
+{
+  SscmaDmabufMapping *slot = NULL;
+  struct stat st;
+  off_t length;
+  gpointer addr;
+  guint i;
+
+  if (fstat (fd, &st) < 0)
+    return NULL;
+
+  cache->tick++;
+  for (i = 0; i < SSCMA_DMABUF_CACHE_SIZE; i++) {
+    SscmaDmabufMapping *map = &cache->maps[i];
+
+    if (map->addr && map->ino == st.st_ino && map->dev == st.st_dev) {
+      map->last_use = cache->tick;
+      *size = map->size;
+      return map->addr;
+    }
+    if (slot == NULL || (slot->addr && (!map->addr ||
+                map->last_use < slot->last_use)))
+      slot = map;
+  }
+
+  /* dma-buf fds report their size through lseek */
+  length = lseek (fd, 0, SEEK_END);
+  if (length <= 0)
+    return NULL;
+
+  addr = mmap (NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    GST_WARNING ("Failed to mmap dma-buf fd %d: %s", fd, g_strerror (errno));
+    return NULL;
+  }
+
+  sscma_dmabuf_mapping_release (slot);
+  slot->dev = st.st_dev;
+  slot->ino = st.st_ino;
+  slot->size = length;
+  slot->addr = (guint8 *) addr;
+  slot->last_use = cache->tick;
+  *size = slot->size;
+  return slot->addr;
+}
+
+/**
+ * @brief Number of rows of a plane, from the components stored in it.
+ */
+static guint
+sscma_dmabuf_plane_rows (const GstVideoInfo * vinfo, guint plane)
+{
+  guint c, rows = 0;
+
+  for (c = 0; c < GST_VIDEO_INFO_N_COMPONENTS (vinfo); c++) {
+    if (GST_VIDEO_INFO_COMP_PLANE (vinfo, c) == (gint) plane)
+      rows = MAX (rows, (guint) GST_VIDEO_INFO_COMP_HEIGHT (vinfo, c));
+  }
+  return rows;
+}
+
+/**
+ * @brief Describe a DMABuf video frame as an SscmaImage without copying it.
+ * Plane layout comes from GstVideoMeta when present (v4l2 pads lines), else
+ * from the negotiated video info. CPU read access is started on every
+ * distinct memory; end it with sscma_dmabuf_cache_unmap_frame().
+ * @return FALSE if a plane is not backed by dma-buf memory, cannot be mapped
+ * or does not fit in its dma-buf.
+ */
+gboolean
+sscma_dmabuf_cache_map_frame (SscmaDmabufCache * cache, GstBuffer * buf,
+    const GstVideoInfo * vinfo, SscmaImage * image,
+    SscmaDmabufAccess * access)
+{
+  GstVideoMeta *meta;
+  guint i, j, n_planes;
+
+  g_return_val_if_fail (cache != NULL && buf != NULL, FALSE);
+
+  meta = gst_buffer_get_video_meta (buf);
+  n_planes = GST_VIDEO_INFO_N_PLANES (vinfo);
+
+  memset (image, 0, sizeof (SscmaImage));
+  image->format = GST_VIDEO_INFO_FORMAT (vinfo);
+  image->width = GST_VIDEO_INFO_WIDTH (vinfo);
+  image->height = GST_VIDEO_INFO_HEIGHT (vinfo);
+  access->n_memory = 0;
+
+  for (i = 0; i < n_planes; i++) {
+    gsize offset, skip, size;
+    guint idx, len;
+    GstMemory *mem;
+    guint8 *base;
+    gint fd;
+
+    offset = meta ? meta->offset[i] : GST_VIDEO_INFO_PLANE_OFFSET (vinfo, i);
+    image->stride[i] = meta ? meta->stride[i] :
+        GST_VIDEO_INFO_PLANE_STRIDE (vinfo, i);
+
+    if (!gst_buffer_find_memory (buf, offset, 1, &idx, &len, &skip))
+      goto failed;
+
+    mem = gst_buffer_peek_memory (buf, idx);
+    if (!gst_is_dmabuf_memory (mem))
+      goto failed;
+
+    fd = gst_dmabuf_memory_get_fd (mem);
+    base = sscma_dmabuf_cache_lookup (cache, fd, &size);
+    if (base == NULL)
+      goto failed;
+    /* a stride or offset from the meta must not read past the mapping */
+    if (image->stride[i] <= 0 || (guint64) mem->offset + skip +
+        (guint64) image->stride[i] * sscma_dmabuf_plane_rows (vinfo, i) > size) {
+      GST_WARNING ("Plane %u of %" G_GSIZE_FORMAT " bytes at offset %"
+          G_GSIZE_FORMAT " does not fit in its dma-buf of %" G_GSIZE_FORMAT
+          " bytes", i, (gsize) image->stride[i] *
+          sscma_dmabuf_plane_rows (vinfo, i), mem->offset + skip, size);
+      goto failed;
+    }
+
+    image->data[i] = base + mem->offset + skip;
+
+    for (j = 0; j < access->n_memory; j++) {
+      if (access->memory[j] == mem)
+        break;
+    }
+    if (j == access->n_memory) {
+      sscma_dmabuf_sync (fd, TRUE);
+      access->memory[access->n_memory++] = mem;
+    }
+  }
+
+  return TRUE;
+
+failed:
+  sscma_dmabuf_cache_unmap_frame (access);
+  return FALSE;
+}
+
+/**
+ * @brief End the CPU access started by sscma_dmabuf_cache_map_frame().
+ * The mappings themselves stay cached.
+ */
+void
+sscma_dmabuf_cache_unmap_frame (SscmaDmabufAccess * access)
+{
+  guint i;
+
+  for (i = 0; i < access->n_memory; i++)
+    sscma_dmabuf_sync (gst_dmabuf_memory_get_fd (access->memory[i]), FALSE);
+  access->n_memory = 0;
+}
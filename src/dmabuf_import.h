@@ -0,0 +1,27 @@
+#ifndef __GST_SSCMA_DMABUF_IMPORT_H__
+#define __GST_SSCMA_DMABUF_IMPORT_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "preprocess.h"
+
+typedef struct _SscmaDmabufCache SscmaDmabufCache;
+
+/**
+ * @brief The dma-buf memories a frame import started CPU access on.
+ */
+typedef struct
+{
+  GstMemory *memory[GST_VIDEO_MAX_PLANES];
+  guint n_memory;
+} SscmaDmabufAccess;
+
+SscmaDmabufCache *sscma_dmabuf_cache_new (void);
+void sscma_dmabuf_cache_free (SscmaDmabufCache * cache);
+void sscma_dmabuf_cache_clear (SscmaDmabufCache * cache);
+gboolean sscma_dmabuf_cache_map_frame (SscmaDmabufCache * cache,
+    GstBuffer * buf, const GstVideoInfo * vinfo, SscmaImage * image,
+    SscmaDmabufAccess * access);
+void sscma_dmabuf_cache_unmap_frame (SscmaDmabufAccess * access);
+
+#endif /* __GST_SSCMA_DMABUF_IMPORT_H__ */
@@ -63,9 +63,17 @@
 #include <gst/gst.h>
 #include <gst/base/base.h>
 #include <gst/controller/controller.h>
+#include <gst/video/video.h>
+#include <gst/allocators/allocators.h>
 
 #include "gstsscmayolov5.h"
 #include "tensor_info.h"
+#include "preprocess.h"
+#include "dmabuf_import.h"
+#include "overlay.h"
+#include "region.h"
+#include "classifier.h"
+#include "tracker.h"
 #include <net.h>
 
 GST_DEBUG_CATEGORY_STATIC (gst_sscma_yolov5_debug);
@@ -88,10 +96,110 @@ enum
   PROP_OUTPUT,
   PROP_OUTPUTTYPE,
   PROP_MODEL,
+  PROP_CONFIG,
   PROP_MODE_LABELS,
-  PROP_OUTPUTRANKS
+  PROP_OUTPUTRANKS,
+  PROP_MODE,
+  PROP_FONT_SCALE,
+  PROP_CONF_THRESHOLD,
+  PROP_IOU_THRESHOLD,
+  PROP_MAX_DETECTIONS,
+  PROP_OUTPUT_SCALE,
+  PROP_OUTPUT_ZERO_POINT,
+  PROP_CLASSES,
+  PROP_ROI,
+  PROP_TILE_SIZE,
+  PROP_TILE_OVERLAP,
+  PROP_TILE_ACTIVITY_THRESHOLD,
+  PROP_SECONDARY_MODEL,
+  PROP_SECONDARY_INPUT,
+  PROP_SECONDARY_LABELS,
+  PROP_SECONDARY_CLASSES,
+  PROP_SECONDARY_INTERVAL,
+  PROP_TRACKER,
+  PROP_TRACK_LOW_RATIO,
+  PROP_TRACK_MAX_AGE,
+  PROP_LINES,
+  PROP_ZONES,
+  PROP_ANALYTICS,
+  PROP_QOS,
+  PROP_LATENCY_BUDGET,
+  PROP_TARGET_FPS,
+  PROP_INPUT_SIZES,
+  PROP_CURRENT_INPUT,
+  PROP_WARMUP,
+  PROP_STARTUP_TIME,
+  PROP_FIRST_FRAME_LATENCY,
+  PROP_STATS
 };
 
+/** default score threshold, in the raw class * objectness units of the model */
+#define DEFAULT_CONF_THRESHOLD (2500.f)
+#define DEFAULT_IOU_THRESHOLD (0.25f)
+#define DEFAULT_MAX_DETECTIONS (100)
+
+#define DEFAULT_TILE_SIZE (0)
+#define DEFAULT_TILE_OVERLAP (0.2f)
+#define DEFAULT_TILE_ACTIVITY_THRESHOLD (0.f)
+
+/** the most distinct model input sizes preprocessed once per region */
+#define SSCMA_YOLOV5_MAX_SHARED_INPUTS (4)
+
+/** input widths target-fps picks from, heights follow the input property */
+#define DEFAULT_INPUT_SIZES "256,320,416,640"
+/** frames an input size is kept before target-fps looks at it again */
+#define SSCMA_YOLOV5_SIZE_HOLD_FRAMES (30)
+
+/** dummy inferences run going to PAUSED */
+#define DEFAULT_WARMUP (2)
+
+/** pixel values to model input, 0..255 to 0..1 */
+static const float gst_sscma_yolov5_norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
+
+/** blob names of the exported models, unless a config names them */
+#define DEFAULT_INPUT_NAME "in0"
+#define DEFAULT_OUTPUT_NAME "out0"
+
+/**
+ * @brief Detection parameters of one frame, taken from the properties once
+ * so they can change while the frame is processed.
+ */
+typedef struct
+{
+  GstSscmaYolov5Shape shape; /**< the model the parameters are for */
+  gfloat conf_threshold; /**< minimum class score * objectness */
+  gboolean filter_classes; /**< TRUE if only the allowed classes are decoded */
+  const guint *allowed; /**< allowed label indices */
+  guint n_allowed; /**< number of allowed label indices */
+
+  guint tile_size; /**< tile side in frame pixels, 0 to scale the whole region */
+  gfloat tile_overlap; /**< fraction of a tile shared with its neighbour */
+  gfloat tile_activity_threshold; /**< score of the coarse pass that makes a tile worth running, 0 to run every tile */
+
+  gboolean secondary_filter_classes; /**< TRUE if only the allowed classes are classified again */
+  const guint *secondary_allowed; /**< label indices handed to the secondary model */
+  guint n_secondary_allowed; /**< number of label indices handed to the secondary model */
+} GstSscmaYolov5FrameParams;
+
+/** default number of frames a tracked object keeps its secondary class */
+#define DEFAULT_SECONDARY_INTERVAL (10)
+#define DEFAULT_TRACK_LOW_RATIO (0.4f)
+#define DEFAULT_TRACK_MAX_AGE (30)
+
+/** frames after which the secondary class of a lost track is forgotten */
+#define SECONDARY_CACHE_TTL (150)
+
+/**
+ * @brief Secondary classification of one tracked object.
+ */
+typedef struct
+{
+  gint class_id; /**< secondary class */
+  gfloat prob; /**< its score */
+  guint64 classified; /**< frame it was classified on */
+  guint64 seen; /**< last frame the track was seen on */
+} GstSscmaYolov5SecondaryResult;
+
 /* the capabilities of the outputs.
  *
  * describe the real formats here.
@@ -114,8 +222,6 @@ G_DEFINE_TYPE (GstSscmaYolov5, gst_sscma_yolov5, GST_TYPE_ELEMENT);
 GST_ELEMENT_REGISTER_DEFINE (sscma_yolov5, "sscma_yolov5", GST_RANK_NONE,
     GST_TYPE_SSCMAYOLOV5);
 
-ncnn::Net net;
-
 static void gst_sscma_yolov5_set_property (GObject * object,
     guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_sscma_yolov5_get_property (GObject * object,
@@ -128,6 +234,8 @@ static gboolean gst_sscma_yolov5_sink_query (GstPad * pad,
     GstObject * parent, GstQuery * query);
 static gboolean gst_sscma_yolov5_src_query (GstPad * pad,
     GstObject * parent, GstQuery * query);
+static gboolean gst_sscma_yolov5_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
 static GstFlowReturn gst_sscma_yolov5_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
 
@@ -136,9 +244,27 @@ static GstCaps * gst_sscma_yolov5_query_caps (GstSscmaYolov5 * self, GstPad * pa
 static gboolean gst_sscma_yolov5_parse_caps (GstSscmaYolov5 * self,
     const GstCaps * caps);
 static gboolean gst_sscma_yolov5_update_caps (GstSscmaYolov5 * self);
-
-static void nms (GArray * results, gfloat threshold);
-static void draw (GstMapInfo * out_info, GstSscmaYolov5 *self, GArray * results);
+static void gst_sscma_yolov5_setup_input_sizes (GstSscmaYolov5 * self);
+static gboolean gst_sscma_yolov5_forward (const ncnn::Net & model,
+    const gchar * input_name, const gchar * output_name, gboolean raw,
+    const ncnn::Mat & in, ncnn::Mat & out);
+static GstStateChangeReturn gst_sscma_yolov5_change_state (GstElement *
+    element, GstStateChange transition);
+static gboolean gst_sscma_yolov5_propose_allocation (GstSscmaYolov5 * self,
+    GstQuery * query);
+static gboolean gst_sscma_yolov5_decide_allocation (GstSscmaYolov5 * self,
+    GstCaps * caps);
+
+static void gst_sscma_yolov5_labels_unref (GstSscmaYolov5Labels * labels);
+static GstSscmaYolov5Model *gst_sscma_yolov5_model_new (const gchar * spec);
+static void gst_sscma_yolov5_model_free (gpointer data);
+static void gst_sscma_yolov5_load_models (GstSscmaYolov5 * self,
+    GPtrArray * models);
+
+static void nms (GArray * results, gfloat threshold, guint max_detections);
+static void draw (GstVideoFrame * frame, GstSscmaYolov5 *self,
+    GPtrArray * models, const GstSscmaYolov5Labels * labels,
+    const GstSscmaYolov5Labels * secondary_labels, GArray * results);
 /* initialize the sscmayolov5's class */
 static void
 gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
@@ -154,12 +280,20 @@ gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
   gobject_class->set_property = gst_sscma_yolov5_set_property;
   gobject_class->get_property = gst_sscma_yolov5_get_property;
   gobject_class->finalize = gst_sscma_yolov5_finalize;
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_change_state);
 
   g_object_class_install_property (gobject_class, PROP_MODEL,
       g_param_spec_string ("model", "Model filepath",
-          "File path to the model file. Separated with ',' in case of multiple model files(like caffe2)",
+          "File path to the model file. Separated with ',' in case of multiple model files(like caffe2). More detectors run on the same frames after ';', each as model.bin,model.param[,input=C:W:H][,output=N:R][,layout=nc|cn][,labels=path][,conf-threshold=value][,input-name=blob][,output-name=blob][,mean=R:G:B][,norm=R:G:B]",
           "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_CONFIG,
+      g_param_spec_string ("config", "Model bundle",
+          "YAML file describing the first model: files, input/output names and shapes, normalization, output layout, thresholds and labels. Replaces model, input, output, outputtype and labels",
+          "", G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_INPUT,
       g_param_spec_string ("input", "Input dimension",
           "Input tensor dimension from inner array (Max rank #NNS_TENSOR_RANK_LIMIT)",
@@ -185,6 +319,182 @@ gst_sscma_yolov5_class_init (GstSscmaYolov5Class * klass)
           "Configure the Labels file path.", "",
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_string ("mode", "Mode",
+          "Output of the element: video (frames with the detections drawn on them) or tensor (the raw model output as other/tensors)",
+          "video", G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CONF_THRESHOLD,
+      g_param_spec_float ("conf-threshold", "Confidence threshold",
+          "Minimum class score * objectness of a detection, in the raw units of the model output",
+          0.f, G_MAXFLOAT, DEFAULT_CONF_THRESHOLD,
+          G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_IOU_THRESHOLD,
+      g_param_spec_float ("iou-threshold", "IoU threshold",
+          "Boxes overlapping a better one by more than this are suppressed by NMS",
+          0.f, 1.f, DEFAULT_IOU_THRESHOLD,
+          G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_DETECTIONS,
+      g_param_spec_uint ("max-detections", "Max detections",
+          "Keep at most this many detections per frame (best first), 0 for no limit",
+          0, G_MAXUINT, DEFAULT_MAX_DETECTIONS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_SCALE,
+      g_param_spec_float ("output-scale", "Output scale",
+          "Real value of one step of an int8/uint8 model output (real = scale * (q - zero-point))",
+          G_MINFLOAT, G_MAXFLOAT, 1.f,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_ZERO_POINT,
+      g_param_spec_int ("output-zero-point", "Output zero point",
+          "Value of a real zero in an int8/uint8 model output, -128..127 for int8 and 0..255 for uint8",
+          -128, 255, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CLASSES,
+      g_param_spec_string ("classes", "Classes",
+          "Comma separated label names or indices to detect, empty for all classes",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ROI,
+      g_param_spec_string ("roi", "Regions of interest",
+          "';' separated regions to run the model on instead of the whole frame: "
+          "x,y,w,h rectangles or x1,y1,x2,y2,x3,y3,... polygons, in pixels or "
+          "in fractions of the frame if all values are within [0, 1]",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_SIZE,
+      g_param_spec_uint ("tile-size", "Tile size",
+          "Split the frame (or each roi) into tiles of this many pixels, each run at the model input size, 0 to disable tiling",
+          0, G_MAXUINT16, DEFAULT_TILE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_OVERLAP,
+      g_param_spec_float ("tile-overlap", "Tile overlap",
+          "Fraction of a tile shared with its neighbour, so objects on a seam are seen whole by one tile",
+          0.f, 0.9f, DEFAULT_TILE_OVERLAP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_ACTIVITY_THRESHOLD,
+      g_param_spec_float ("tile-activity-threshold", "Tile activity threshold",
+          "Run a coarse pass on the whole region first and only run the tiles overlapping a coarse detection scoring above this, 0 to run every tile",
+          0.f, G_MAXFLOAT, DEFAULT_TILE_ACTIVITY_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SECONDARY_MODEL,
+      g_param_spec_string ("secondary-model", "Secondary model filepath",
+          "Classification model run on every detection, as model.bin,model.param followed by optional "
+          "input-name=blob (default in0), output-name=blob (default out0), mean=R:G:B (default 0:0:0) "
+          "and norm=R:G:B (default 1/255 each), the input being RGB values 0..255",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SECONDARY_INPUT,
+      g_param_spec_string ("secondary-input", "Secondary input dimension",
+          "Input tensor dimension of the secondary model, e.g. 3:64:64",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SECONDARY_LABELS,
+      g_param_spec_string ("secondary-labels", "Secondary labels file",
+          "Labels of the secondary model, drawn under the detection label",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SECONDARY_CLASSES,
+      g_param_spec_string ("secondary-classes", "Secondary classes",
+          "Comma separated label names or indices of the detections to classify, empty for all",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SECONDARY_INTERVAL,
+      g_param_spec_uint ("secondary-interval", "Secondary interval",
+          "Frames a tracked object keeps its secondary class before it is classified again",
+          1, G_MAXUINT, DEFAULT_SECONDARY_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TRACKER,
+      g_param_spec_boolean ("tracker", "Tracker",
+          "Track the detections across frames and give them persistent ids",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TRACK_LOW_RATIO,
+      g_param_spec_float ("track-low-ratio", "Track low score ratio",
+          "Detections down to conf-threshold times this may continue an existing track, 1 to only use confident detections",
+          0.f, 1.f, DEFAULT_TRACK_LOW_RATIO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TRACK_MAX_AGE,
+      g_param_spec_uint ("track-max-age", "Track max age",
+          "Frames a track survives without a matching detection",
+          0, G_MAXUINT, DEFAULT_TRACK_MAX_AGE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LINES,
+      g_param_spec_string ("lines", "Lines",
+          "Counting lines x1,y1,x2,y2 separated with ';', in pixels or fractions of the frame; tracked objects crossing them post sscma-line-crossing messages",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ZONES,
+      g_param_spec_string ("zones", "Zones",
+          "Zones in the format of roi; tracked objects entering and leaving them post sscma-zone-enter and sscma-zone-exit messages",
+          "", G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ANALYTICS,
+      g_param_spec_boxed ("analytics", "Analytics",
+          "Crossings per line and direction, and occupancy and entries per zone",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_QOS,
+      g_param_spec_boolean ("qos", "QoS",
+          "Skip the inference of frames downstream reports as late, drawing the last detections on them (mode=tensor drops them)",
+          TRUE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY_BUDGET,
+      g_param_spec_uint ("latency-budget", "Latency budget",
+          "Processing time allowed per frame in ms; while the average is above it only every Nth frame is inferred and the others show the last detections, 0 for no limit",
+          0, G_MAXUINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TARGET_FPS,
+      g_param_spec_double ("target-fps", "Target FPS",
+          "Frame rate the first model's input size follows, picked from input-sizes at the start of a stream; needs a model taking any input size, 0 to keep the input property",
+          0, G_MAXDOUBLE, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INPUT_SIZES,
+      g_param_spec_string ("input-sizes", "Input sizes",
+          "Comma separated input widths (multiples of 32) target-fps picks from, the heights keep the aspect ratio of the input property",
+          DEFAULT_INPUT_SIZES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CURRENT_INPUT,
+      g_param_spec_string ("current-input", "Current input",
+          "Input size of the first model in the format of input, channel:width:height",
+          "", G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_WARMUP,
+      g_param_spec_uint ("warmup", "Warm-up",
+          "Dummy inferences run at the input size when going to PAUSED, so the first frame does not pay for the first run of the model",
+          0, G_MAXUINT, DEFAULT_WARMUP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STARTUP_TIME,
+      g_param_spec_uint64 ("startup-time", "Startup time",
+          "Time the first model took to load and warm up in microseconds",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FIRST_FRAME_LATENCY,
+      g_param_spec_uint64 ("first-frame-latency", "First frame latency",
+          "Processing time of the first inferred frame after going to PAUSED in microseconds",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Per-stage processing time of the last frame in microseconds, the number of live tracks and the QoS counters",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_FONT_SCALE,
+      g_param_spec_uint ("font-scale", "Font scale",
+          "Integer scale of the label font (13px high at 1), 0 to pick one from the frame height",
+          0, 16, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_SILENT,
       g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
           FALSE, G_PARAM_READWRITE));
@@ -229,7 +539,6 @@ gst_sscma_yolov5_init (GstSscmaYolov5 * self)
       GST_DEBUG_FUNCPTR (gst_sscma_yolov5_sink_query));
   gst_pad_set_chain_function (self->sinkpad,
       GST_DEBUG_FUNCPTR (gst_sscma_yolov5_chain));
-  GST_PAD_SET_PROXY_CAPS (self->sinkpad);
   gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
 
   /** setup src pad */
@@ -238,15 +547,51 @@ gst_sscma_yolov5_init (GstSscmaYolov5 * self)
       (GST_ELEMENT_GET_CLASS (self), "src"), "src");
   gst_pad_set_query_function (self->srcpad,
       GST_DEBUG_FUNCPTR (gst_sscma_yolov5_src_query));
-  GST_PAD_SET_PROXY_CAPS (self->srcpad);
+  gst_pad_set_event_function (self->srcpad,
+      GST_DEBUG_FUNCPTR (gst_sscma_yolov5_src_event));
   gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
 
   /* init null */
   memset (prop, 0, sizeof (GstSscmaYolov5Properties));
 
   gst_tensors_info_init (&prop->input_meta);
-  gst_tensors_layout_init (prop->input_layout);
-  gst_tensors_rank_init (prop->input_ranks);
+
+  self->dmabuf_cache = sscma_dmabuf_cache_new ();
+  self->overlay = sscma_overlay_new ();
+
+  self->input_name = DEFAULT_INPUT_NAME;
+  self->output_name = DEFAULT_OUTPUT_NAME;
+  memset (self->mean_vals, 0, sizeof (self->mean_vals));
+  memcpy (self->norm_vals, gst_sscma_yolov5_norm_vals, sizeof (self->norm_vals));
+  self->output_scale = 1.f;
+  gst_segment_init (&self->segment, GST_FORMAT_TIME);
+  self->qos = TRUE;
+  self->earliest_time = GST_CLOCK_TIME_NONE;
+  self->proportion = 1.0;
+  self->last_results = g_array_new (FALSE, FALSE, sizeof (detectedObject));
+  self->input_sizes = g_strdup (DEFAULT_INPUT_SIZES);
+  self->warmup = DEFAULT_WARMUP;
+  self->conf_threshold = DEFAULT_CONF_THRESHOLD;
+  self->iou_threshold = DEFAULT_IOU_THRESHOLD;
+  self->max_detections = DEFAULT_MAX_DETECTIONS;
+  self->tile_size = DEFAULT_TILE_SIZE;
+  self->tile_overlap = DEFAULT_TILE_OVERLAP;
+  self->tile_activity_threshold = DEFAULT_TILE_ACTIVITY_THRESHOLD;
+  self->class_filter = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->secondary_filter = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->secondary_interval = DEFAULT_SECONDARY_INTERVAL;
+  self->secondary_input_name = g_strdup (DEFAULT_INPUT_NAME);
+  self->secondary_output_name = g_strdup (DEFAULT_OUTPUT_NAME);
+  memcpy (self->secondary_norm, gst_sscma_yolov5_norm_vals,
+      sizeof (self->secondary_norm));
+  self->secondary_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, g_free);
+  self->tracker = sscma_tracker_new ();
+  self->track_low_ratio = DEFAULT_TRACK_LOW_RATIO;
+  self->track_max_age = DEFAULT_TRACK_MAX_AGE;
+  self->analytics = sscma_analytics_new ();
+  g_mutex_init (&self->fanout_lock);
+  g_cond_init (&self->fanout_cond);
 }
 
 /**
@@ -263,6 +608,47 @@ gst_sscma_yolov5_finalize (GObject * object)
 
   // gst_tensor_filter_common_close_fw (prop);
   gst_tensors_info_free (&prop->input_meta);
+  gst_tensors_info_free (&prop->output_meta);
+  gst_sscma_yolov5_labels_unref (prop->labels);
+  gst_sscma_yolov5_labels_unref (self->secondary_labels);
+  if (self->pool) {
+    gst_buffer_pool_set_active (self->pool, FALSE);
+    gst_object_unref (self->pool);
+    self->pool = NULL;
+  }
+  gst_caps_replace (&self->sink_caps, NULL);
+  g_array_free (self->last_results, TRUE);
+  self->input_mat.release ();
+  sscma_dmabuf_cache_free (self->dmabuf_cache);
+  sscma_overlay_free (self->overlay);
+  g_free (self->classes);
+  g_array_free (self->class_filter, TRUE);
+  g_free (self->roi);
+  g_free (self->input_sizes);
+  if (self->sizes)
+    g_array_unref (self->sizes);
+  if (self->regions)
+    g_array_unref (self->regions);
+  g_free (self->secondary_model);
+  g_strfreev (self->secondary_model_files);
+  g_free (self->secondary_input_name);
+  g_free (self->secondary_output_name);
+  g_free (self->secondary_classes);
+  g_array_free (self->secondary_filter, TRUE);
+  g_hash_table_destroy (self->secondary_cache);
+  sscma_classifier_free (self->classifier);
+  sscma_tracker_free (self->tracker);
+  g_free (self->lines);
+  g_free (self->zones);
+  sscma_analytics_free (self->analytics);
+  if (self->model_pool)
+    g_thread_pool_free (self->model_pool, FALSE, TRUE);
+  if (self->extra_models)
+    g_ptr_array_unref (self->extra_models);
+  g_free (self->models);
+  sscma_model_config_unref (self->config);
+  g_mutex_clear (&self->fanout_lock);
+  g_cond_clear (&self->fanout_cond);
   // 释放 self->net 内存
   self->net.clear();
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -273,88 +659,405 @@ static gint
 _gtfc_setprop_MODEL (GstSscmaYolov5 * priv,
     GstSscmaYolov5Properties * prop, const GValue * value)
 {
-  gint status = 0;
   const gchar *model_files = g_value_get_string (value);
-  GstSscmaYolov5Properties _prop;
+  GPtrArray *models = NULL;
+  gchar **specs;
+  guint i;
 
   if (!model_files) {
     g_print ("Invalid model provided to the tensor-filter.");
     return 0;
   }
-  _prop.model_files = NULL;
 
-  g_strfreev (prop->model_files);
+  /* the first model is described by the element properties, the others by their spec */
+  specs = g_strsplit (model_files, ";", -1);
+  for (i = 1; specs[i]; i++) {
+    GstSscmaYolov5Model *model;
 
-  if (model_files) {
-    prop->model_files = (const gchar **) g_strsplit_set (model_files, ",", -1);
-    prop->num_models = g_strv_length ((gchar **) prop->model_files);
-  } else {
-    prop->model_files = NULL;
-    prop->num_models = 0;
+    if (g_strstrip (specs[i])[0] == '\0')
+      continue;
+    model = gst_sscma_yolov5_model_new (specs[i]);
+    if (model == NULL) {
+      if (models)
+        g_ptr_array_unref (models);
+      g_strfreev (specs);
+      return -1;
+    }
+    if (models == NULL)
+      models = g_ptr_array_new_with_free_func (gst_sscma_yolov5_model_free);
+    g_ptr_array_add (models, model);
   }
+
+  g_strfreev ((gchar **) prop->model_files);
+  prop->model_files = (const gchar **) g_strsplit_set (g_strstrip (specs[0]),
+      ",", -1);
+  prop->num_models = g_strv_length ((gchar **) prop->model_files);
+  g_strfreev (specs);
+  /* loaded again at the next stream start */
+  priv->model_loaded = FALSE;
+  /* set while streaming, load them here rather than in the streaming thread */
+  if (GST_STATE (priv) >= GST_STATE_PAUSED)
+    gst_sscma_yolov5_load_models (priv, models);
+
+  /* the chain holds its own reference on the models it is running */
+  GST_OBJECT_LOCK (priv);
+  if (priv->extra_models)
+    g_ptr_array_unref (priv->extra_models);
+  priv->extra_models = models;
+  g_free (priv->models);
+  priv->models = g_strdup (model_files);
+  GST_OBJECT_UNLOCK (priv);
   return 0;
 }
 
 /**
- * @brief Load label file into the internal data
- * @param[in/out] l The given ImageLabelData struct.
+ * @brief Take a reference on a set of labels.
+ * @return labels, NULL if labels is NULL.
+ */
+static GstSscmaYolov5Labels *
+gst_sscma_yolov5_labels_ref (GstSscmaYolov5Labels * labels)
+{
+  if (labels)
+    g_atomic_int_inc (&labels->refcount);
+  return labels;
+}
+
+/**
+ * @brief Drop a reference on a set of labels, NULL is ignored.
+ */
+static void
+gst_sscma_yolov5_labels_unref (GstSscmaYolov5Labels * labels)
+{
+  guint i;
+
+  if (labels == NULL || !g_atomic_int_dec_and_test (&labels->refcount))
+    return;
+  for (i = 0; i < labels->total; i++) {
+    g_free (labels->names[i]);
+    sscma_text_strip_free (labels->strips[i]);
+  }
+  g_free (labels->names);
+  g_free (labels->strips);
+  g_free (labels);
+}
+
+/**
+ * @brief Get the number of labels of a set, 0 for NULL.
+ */
+static inline guint
+gst_sscma_yolov5_labels_count (const GstSscmaYolov5Labels * labels)
+{
+  return labels ? labels->total : 0;
+}
+
+/**
+ * @brief Copy a list of labels and render them for drawing.
+ * @param list NULL-terminated labels.
+ * @return The labels, with one reference.
+ */
+static GstSscmaYolov5Labels *
+gst_sscma_yolov5_labels_new (const gchar * const *list)
+{
+  GstSscmaYolov5Labels *labels = g_new0 (GstSscmaYolov5Labels, 1);
+  guint i;
+  gsize len;
+
+  labels->refcount = 1;
+  labels->total = g_strv_length ((gchar **) list);
+  labels->names = g_new0 (char *, labels->total);
+  labels->strips = g_new0 (SscmaTextStrip *, labels->total);
+
+  for (i = 0; i < labels->total; i++) {
+    labels->names[i] = g_strdup (list[i]);
+    /* rendered once here, drawing a label is then a few span fills */
+    labels->strips[i] = sscma_text_strip_new (list[i]);
+
+    len = strlen (list[i]);
+    if (len > labels->max_word_length) {
+      labels->max_word_length = len;
+    }
+  }
+  return labels;
+}
+
+/**
+ * @brief Read a label file, one label per line.
+ * @return The labels, with one reference, NULL if the file cannot be read.
  */
-void
-loadImageLabels (const char *label_path, GstSscmaYolov5Properties * prop)
+static GstSscmaYolov5Labels *
+gst_sscma_yolov5_labels_read (const char *label_path)
 {
   GError *err = NULL;
+  GstSscmaYolov5Labels *labels;
   gchar **_labels;
   gchar *contents = NULL;
   gsize len;
   guint i;
 
-  // init labels
-  if (prop->labels) {
-    for (i = 0; i < prop->total_labels; i++)
-      g_free (prop->labels[i]);
-    g_free (prop->labels);
-  }
-  prop->labels = NULL;
-  prop->total_labels = 0;
-  prop->max_word_length = 0;
-
   /* Read file contents */
   if (!g_file_get_contents (label_path, &contents, &len, &err)) {
     g_print ("Unable to read file %s with error %s.", label_path, err->message);
     g_clear_error (&err);
-    return;
+    return NULL;
   }
 
-  if (contents[len - 1] == '\n')
-    contents[len - 1] = '\0';
-
+  /* blank lines at the end and CRLF endings are not labels */
+  g_strchomp (contents);
   _labels = g_strsplit (contents, "\n", -1);
-  prop->total_labels = g_strv_length (_labels);
-  prop->labels = g_new0 (char *, prop->total_labels);
-  if (prop->labels == NULL) {
-    g_print ("Failed to allocate memory for label data.");
-    prop->total_labels = 0;
-    goto error;
+  for (i = 0; _labels[i]; i++)
+    g_strchomp (_labels[i]);
+  labels = gst_sscma_yolov5_labels_new (_labels);
+
+  g_strfreev (_labels);
+  g_free (contents);
+  return labels;
+}
+
+/**
+ * @brief Parse R:G:B, one value per channel.
+ */
+static gboolean
+gst_sscma_yolov5_parse_channels (const gchar * str, gfloat values[3])
+{
+  gchar **strv = g_strsplit (str, ":", -1);
+  gboolean ok = g_strv_length (strv) == 3;
+  guint i;
+
+  for (i = 0; ok && i < 3; i++) {
+    gchar *end = NULL;
+
+    values[i] = g_ascii_strtod (strv[i], &end);
+    ok = end != strv[i] && *end == '\0';
   }
+  g_strfreev (strv);
+  return ok;
+}
+
+/**
+ * @brief Free a model created by gst_sscma_yolov5_model_new().
+ */
+static void
+gst_sscma_yolov5_model_free (gpointer data)
+{
+  GstSscmaYolov5Model *model = (GstSscmaYolov5Model *) data;
+
+  gst_sscma_yolov5_labels_unref (model->labels);
+  g_free (model->bin);
+  g_free (model->param);
+  g_free (model->input_name);
+  g_free (model->output_name);
+  delete model;
+}
 
-  for (i = 0; i < prop->total_labels; i++) {
-    prop->labels[i] = g_strdup (_labels[i]);
+/**
+ * @brief Parse the spec of a model after the first one:
+ * "model.bin,model.param" followed by optional input=C:W:H, output=N:R,
+ * layout=nc|cn, labels=path, conf-threshold=value, input-name=blob,
+ * output-name=blob, mean=R:G:B and norm=R:G:B.
+ * @return NULL if the spec is malformed.
+ */
+static GstSscmaYolov5Model *
+gst_sscma_yolov5_model_new (const gchar * spec)
+{
+  GstSscmaYolov5Model *model = new GstSscmaYolov5Model ();
+  gchar **fields = g_strsplit (spec, ",", -1);
+  gboolean ok = g_strv_length (fields) >= 2;
+  guint i;
 
-    len = strlen (_labels[i]);
-    if (len > prop->max_word_length) {
-      prop->max_word_length = len;
+  model->loaded = model->failed = FALSE;
+  memset (&model->shape, 0, sizeof (model->shape));
+  model->labels = NULL;
+  model->conf_threshold = 0.f;
+  model->input_name = g_strdup (DEFAULT_INPUT_NAME);
+  model->output_name = g_strdup (DEFAULT_OUTPUT_NAME);
+  memset (model->mean, 0, sizeof (model->mean));
+  memcpy (model->norm, gst_sscma_yolov5_norm_vals, sizeof (model->norm));
+  model->layout = SSCMA_OUTPUT_LAYOUT_NC;
+  model->bin = ok ? g_strdup (g_strstrip (fields[0])) : NULL;
+  model->param = ok ? g_strdup (g_strstrip (fields[1])) : NULL;
+
+  for (i = 2; ok && fields[i]; i++) {
+    gchar *key = g_strstrip (fields[i]);
+    gchar *val = strchr (key, '=');
+    tensor_dim dim;
+
+    if (val == NULL) {
+      ok = FALSE;
+      break;
+    }
+    *val++ = '\0';
+    if (g_str_equal (key, "input")) {
+      ok = gst_tensor_parse_dimension (val, dim) >= 3;
+      model->shape.input_width = dim[1];
+      model->shape.input_height = dim[2];
+    } else if (g_str_equal (key, "output")) {
+      ok = gst_tensor_parse_dimension (val, dim) >= 2 &&
+          dim[0] > DETECTION_NUM_INFO;
+      model->shape.n_classes = dim[0] - DETECTION_NUM_INFO;
+      model->shape.n_anchors = dim[1];
+    } else if (g_str_equal (key, "labels")) {
+      gst_sscma_yolov5_labels_unref (model->labels);
+      model->labels = gst_sscma_yolov5_labels_read (val);
+      ok = model->labels != NULL;
+    } else if (g_str_equal (key, "layout")) {
+      ok = sscma_output_layout_from_string (val, &model->layout);
+    } else if (g_str_equal (key, "conf-threshold")) {
+      gchar *end = NULL;
+
+      model->conf_threshold = g_ascii_strtod (val, &end);
+      ok = end != val && *end == '\0' && model->conf_threshold >= 0.f;
+    } else if (g_str_equal (key, "input-name") && val[0]) {
+      g_free (model->input_name);
+      model->input_name = g_strdup (val);
+    } else if (g_str_equal (key, "output-name") && val[0]) {
+      g_free (model->output_name);
+      model->output_name = g_strdup (val);
+    } else if (g_str_equal (key, "mean")) {
+      ok = gst_sscma_yolov5_parse_channels (val, model->mean);
+    } else if (g_str_equal (key, "norm")) {
+      ok = gst_sscma_yolov5_parse_channels (val, model->norm);
+    } else {
+      ok = FALSE;
     }
   }
+  g_strfreev (fields);
 
-error:
-  g_strfreev (_labels);
-  g_free (contents);
+  if (!ok) {
+    g_print ("sscma_yolov5: Invalid model spec \"%s\", expected model.bin,model.param[,input=C:W:H][,output=N:R][,layout=nc|cn][,labels=path][,conf-threshold=value][,input-name=blob][,output-name=blob][,mean=R:G:B][,norm=R:G:B].\n",
+        spec);
+    gst_sscma_yolov5_model_free (model);
+    return NULL;
+  }
+  return model;
+}
+
+/**
+ * @brief Check that a model after the first one has a blob, listing the ones
+ * it has if not.
+ */
+static gboolean
+gst_sscma_yolov5_model_has_blob (GstSscmaYolov5Model * model,
+    const gchar * kind, const gchar * name,
+    const std::vector < const char *>&names)
+{
+  GString *list;
+  guint i;
+
+  for (i = 0; i < names.size (); i++) {
+    if (g_str_equal (names[i], name))
+      return TRUE;
+  }
+  list = g_string_new (NULL);
+  for (i = 0; i < names.size (); i++)
+    g_string_append_printf (list, "%s%s", i ? ", " : "", names[i]);
+  g_print ("sscma_yolov5: The model %s has no %s blob %s, it has %s.\n",
+      model->param, kind, name, list->str);
+  g_string_free (list, TRUE);
+  return FALSE;
+}
+
+/**
+ * @brief Load a model after the first one, unless it is loaded already.
+ * What its spec leaves out follows the input, output and labels properties.
+ */
+static gboolean
+gst_sscma_yolov5_model_load (GstSscmaYolov5 * self, GstSscmaYolov5Model * model,
+    guint model_id)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  GstSscmaYolov5Shape *shape = &model->shape;
+
+  if (model->loaded || model->failed)
+    return model->loaded;
+
+  shape->model_id = model_id;
+  shape->scale = 1.f;
+  shape->zero_point = 0;
+  if (shape->input_width == 0) {
+    shape->input_width = prop->input_meta.info[0].dimension[1];
+    shape->input_height = prop->input_meta.info[0].dimension[2];
+  }
+  if (shape->n_anchors == 0)
+    shape->n_anchors = prop->output_meta.info[0].dimension[1];
+  if (shape->n_classes == 0)
+    shape->n_classes = model->labels ? model->labels->total :
+        prop->output_meta.info[0].dimension[0] - DETECTION_NUM_INFO;
+
+  /* the extractor hands out float32 */
+  shape->decode = sscma_decoder_select (model->layout, _TENOR_FLOAT32,
+      shape->n_classes);
+
+  if (shape->input_width <= 0 || shape->input_height <= 0 ||
+      shape->n_anchors == 0 || shape->decode == NULL ||
+      model->net.load_param (model->param) != 0 ||
+      model->net.load_model (model->bin) != 0) {
+    g_print ("sscma_yolov5: Cannot load the model %s, %s, please check the model property.\n",
+        model->bin, model->param);
+    model->failed = TRUE;
+    return FALSE;
+  }
+  if (!gst_sscma_yolov5_model_has_blob (model, "input", model->input_name,
+          model->net.input_names ()) ||
+      !gst_sscma_yolov5_model_has_blob (model, "output", model->output_name,
+          model->net.output_names ())) {
+    model->net.clear ();
+    model->failed = TRUE;
+    return FALSE;
+  }
+  model->loaded = TRUE;
+  return TRUE;
+}
+
+/**
+ * @brief Load label file into a new set of labels
+ * @return The labels, NULL if the file cannot be read.
+ */
+static GstSscmaYolov5Labels *
+loadImageLabels (const char *label_path)
+{
+  GstSscmaYolov5Labels *labels = gst_sscma_yolov5_labels_read (label_path);
 
-  if (prop->labels != NULL) {
+  if (labels != NULL) {
     g_print ("Loaded image label file successfully. %u labels loaded.",
-        prop->total_labels);
+        labels->total);
+  }
+  return labels;
+}
+
+/**
+ * @brief Pick the decoder of the first model for its layout, output type and
+ * labels, called with the object lock held whenever one of them changes.
+ * float16, int8 and uint8 outputs are taken from the model as they are and
+ * decoded in that type; ncnn converts every other output to float32.
+ * Nothing is decoded while the labels and the output property disagree on
+ * the number of classes, the output buffer is sized from the latter.
+ */
+static void
+gst_sscma_yolov5_update_decoder (GstSscmaYolov5 * self)
+{
+  tensor_type type = self->prop.output_meta.info[0].type;
+  guint n_values = self->prop.output_meta.info[0].dimension[0];
+  guint n_classes = gst_sscma_yolov5_labels_count (self->prop.labels);
+
+  if (type != _TENOR_FLOAT16 && type != _TENOR_INT8 && type != _TENOR_UINT8)
+    type = _TENOR_FLOAT32;
+  self->output_raw = type != _TENOR_FLOAT32;
+  if (n_classes + DETECTION_NUM_INFO != n_values) {
+    if (n_classes > 0 && n_values > 0)
+      GST_WARNING_OBJECT (self, "%u labels do not match the output property "
+          "(%u values per anchor).", n_classes, n_values);
+    self->decode = NULL;
+    return;
   }
-  return;
+  /* a zero point the elements cannot hold would shift every score */
+  if (!sscma_decoder_zero_point_valid (type, self->output_zero_point)) {
+    GST_WARNING_OBJECT (self, "output-zero-point %d is out of the range of "
+        "the %s output.", self->output_zero_point,
+        type == _TENOR_INT8 ? "int8" : "uint8");
+    self->decode = NULL;
+    return;
+  }
+  self->decode = sscma_decoder_select (self->output_layout, type, n_classes);
 }
 
 /** @brief Handle "PROP_LABELS" for set-property */
@@ -362,15 +1065,24 @@ static gint
 _gtfc_setprop_LABELS (GstSscmaYolov5 * priv,
     GstSscmaYolov5Properties * prop, const GValue * value)
 {
-  gint status = 0;
   const gchar *model_labels = g_value_get_string (value);
-  GstSscmaYolov5Properties _prop;
+  GstSscmaYolov5Labels *labels, *old;
 
   if (!model_labels) {
     g_print ("Invalid model provided to the tensor-filter.");
     return 0;
   }
-  loadImageLabels (model_labels, prop);
+  /* read without the lock, frames being drawn keep the old labels */
+  labels = loadImageLabels (model_labels);
+
+  GST_OBJECT_LOCK (priv);
+  old = prop->labels;
+  prop->labels = labels;
+  /* class names in the allow-list refer to the labels */
+  priv->class_filter_dirty = TRUE;
+  gst_sscma_yolov5_update_decoder (priv);
+  GST_OBJECT_UNLOCK (priv);
+  gst_sscma_yolov5_labels_unref (old);
   return 0;
 }
 
@@ -381,17 +1093,14 @@ _gtfc_setprop_DIMENSION (GstSscmaYolov5 * priv,
 {
   GstSscmaYolov5Properties *prop;
   GstTensorsInfo *info;
-  unsigned int *rank;
   int configured;
 
   prop = &priv->prop;
   if(is_input){
     info = &prop->input_meta;
-    rank = prop->input_ranks;
     configured = prop->input_configured;
   }else{
     info = &prop->output_meta;
-    rank = prop->output_ranks;
     configured = prop->output_configured;
   }
 
@@ -403,15 +1112,17 @@ _gtfc_setprop_DIMENSION (GstSscmaYolov5 * priv,
     str_dims = g_strsplit_set (g_value_get_string (value), ",.", -1);
     num_dims = g_strv_length (str_dims);
 
-    if (num_dims > NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT) {
+    if (num_dims > NNS_TENSOR_SIZE_MAX) {
       g_print ("Invalid param, dimensions (%d) max (%d)\n",
-          num_dims, NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT);
+          num_dims, NNS_TENSOR_SIZE_MAX);
 
-      num_dims = NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT;
+      num_dims = NNS_TENSOR_SIZE_MAX;
     }
 
+    /* the extra info is only allocated for more than NNS_TENSOR_SIZE_INLINE tensors */
+    gst_tensors_info_extra_reserve (info, num_dims);
     for (i = 0; i < num_dims; ++i) {
-      rank[i] = gst_tensor_parse_dimension (str_dims[i],
+      gst_tensor_parse_dimension (str_dims[i],
           gst_tensors_info_get_nth_info (info, i)->dimension);
     }
     g_strfreev (str_dims);
@@ -471,6 +1182,261 @@ _gtfc_setprop_TYPE (GstSscmaYolov5 * priv,
   return 0;
 }
 
+/** @brief Handle "PROP_SECONDARY_LABELS" for set-property */
+static gint
+_gtfc_setprop_SECONDARY_LABELS (GstSscmaYolov5 * priv, const GValue * value)
+{
+  const gchar *path = g_value_get_string (value);
+  GstSscmaYolov5Labels *labels = NULL, *old;
+
+  /* read without the lock, frames being drawn keep the old labels */
+  if (path && path[0] != '\0')
+    labels = gst_sscma_yolov5_labels_read (path);
+
+  GST_OBJECT_LOCK (priv);
+  old = priv->secondary_labels;
+  priv->secondary_labels = labels;
+  GST_OBJECT_UNLOCK (priv);
+  gst_sscma_yolov5_labels_unref (old);
+  return labels || path == NULL || path[0] == '\0' ? 0 : -1;
+}
+
+/**
+ * @brief Handle "PROP_SECONDARY_MODEL" for set-property.
+ * "model.bin,model.param" followed by optional input-name=blob,
+ * output-name=blob, mean=R:G:B and norm=R:G:B, like the input and output
+ * of a config bundle.
+ */
+static gint
+_gtfc_setprop_SECONDARY_MODEL (GstSscmaYolov5 * priv, const GValue * value)
+{
+  const gchar *spec = g_value_get_string (value);
+  gchar **fields;
+  gboolean ok;
+  guint i;
+
+  /* loaded again at the next stream start */
+  priv->secondary_loaded = FALSE;
+  g_free (priv->secondary_model);
+  priv->secondary_model = g_strdup (spec);
+  g_strfreev (priv->secondary_model_files);
+  priv->secondary_model_files = NULL;
+  g_free (priv->secondary_input_name);
+  priv->secondary_input_name = g_strdup (DEFAULT_INPUT_NAME);
+  g_free (priv->secondary_output_name);
+  priv->secondary_output_name = g_strdup (DEFAULT_OUTPUT_NAME);
+  memset (priv->secondary_mean, 0, sizeof (priv->secondary_mean));
+  memcpy (priv->secondary_norm, gst_sscma_yolov5_norm_vals,
+      sizeof (priv->secondary_norm));
+  if (spec == NULL || spec[0] == '\0')
+    return 0;
+
+  fields = g_strsplit (spec, ",", -1);
+  ok = g_strv_length (fields) >= 2;
+  for (i = 2; ok && fields[i]; i++) {
+    gchar *key = g_strstrip (fields[i]);
+    gchar *val = strchr (key, '=');
+
+    if (val == NULL) {
+      ok = FALSE;
+      break;
+    }
+    *val++ = '\0';
+    if (g_str_equal (key, "input-name") && val[0]) {
+      g_free (priv->secondary_input_name);
+      priv->secondary_input_name = g_strdup (val);
+    } else if (g_str_equal (key, "output-name") && val[0]) {
+      g_free (priv->secondary_output_name);
+      priv->secondary_output_name = g_strdup (val);
+    } else if (g_str_equal (key, "mean")) {
+      ok = gst_sscma_yolov5_parse_channels (val, priv->secondary_mean);
+    } else if (g_str_equal (key, "norm")) {
+      ok = gst_sscma_yolov5_parse_channels (val, priv->secondary_norm);
+    } else {
+      ok = FALSE;
+    }
+  }
+  if (ok) {
+    priv->secondary_model_files = g_new0 (gchar *, 3);
+    priv->secondary_model_files[0] = g_strdup (g_strstrip (fields[0]));
+    priv->secondary_model_files[1] = g_strdup (g_strstrip (fields[1]));
+  }
+  g_strfreev (fields);
+
+  if (!ok) {
+    g_print ("sscma_yolov5: Invalid secondary model \"%s\", expected model.bin,model.param[,input-name=blob][,output-name=blob][,mean=R:G:B][,norm=R:G:B].\n",
+        spec);
+    return -1;
+  }
+  return 0;
+}
+
+/** @brief Handle "PROP_SECONDARY_INPUT" for set-property */
+static gint
+_gtfc_setprop_SECONDARY_INPUT (GstSscmaYolov5 * priv, const GValue * value)
+{
+  const gchar *dims = g_value_get_string (value);
+  tensor_dim dim;
+
+  priv->secondary_loaded = FALSE;
+  priv->secondary_width = priv->secondary_height = 0;
+  if (dims == NULL || dims[0] == '\0')
+    return 0;
+
+  /* same layout as "input": channel:width:height */
+  if (gst_tensor_parse_dimension (dims, dim) < 3)
+    return -1;
+  priv->secondary_width = dim[1];
+  priv->secondary_height = dim[2];
+  return 0;
+}
+
+/** @brief Handle "PROP_ROI" for set-property */
+static gint
+_gtfc_setprop_ROI (GstSscmaYolov5 * priv, const GValue * value)
+{
+  const gchar *roi = g_value_get_string (value);
+  GArray *regions = NULL;
+
+  if (roi && roi[0] != '\0') {
+    regions = sscma_regions_parse (roi);
+    /* keep the previous regions */
+    if (regions == NULL)
+      return -1;
+  }
+
+  /* the chain holds its own reference on the regions it is using */
+  GST_OBJECT_LOCK (priv);
+  if (priv->regions)
+    g_array_unref (priv->regions);
+  priv->regions = regions;
+  g_free (priv->roi);
+  priv->roi = g_strdup (roi);
+  GST_OBJECT_UNLOCK (priv);
+  return 0;
+}
+
+/** @brief Handle "PROP_CONFIG" for set-property */
+static gint
+_gtfc_setprop_CONFIG (GstSscmaYolov5 * priv,
+    GstSscmaYolov5Properties * prop, const GValue * value)
+{
+  const gchar *path = g_value_get_string (value);
+  SscmaModelConfig *config;
+  GstSscmaYolov5Labels *labels, *old_labels;
+  GstTensorInfo *info;
+
+  /* the model and its shapes are in use from the PAUSED state on */
+  if (GST_STATE (priv) > GST_STATE_READY) {
+    GST_WARNING_OBJECT (priv, "config can only be changed in the NULL or READY state.");
+    return -1;
+  }
+  if (path == NULL || path[0] == '\0')
+    return 0;
+  /* checked once when read, nothing is validated per frame */
+  config = sscma_model_config_load (path);
+  if (config == NULL)
+    return -1;
+
+  g_strfreev ((gchar **) prop->model_files);
+  prop->model_files = g_new0 (const char *, 3);
+  prop->model_files[0] = g_strdup (config->bin);
+  prop->model_files[1] = g_strdup (config->param);
+  prop->num_models = 2;
+  priv->model_loaded = FALSE;
+
+  /* same tensors as input=C:W:H, output=N:R and outputtype */
+  info = gst_tensors_info_get_nth_info (&prop->input_meta, 0);
+  gst_tensor_info_init (info);
+  info->type = _TENOR_FLOAT32;
+  info->dimension[0] = config->input_channels;
+  info->dimension[1] = config->input_width;
+  info->dimension[2] = config->input_height;
+  info->dimension[3] = 1;
+  prop->input_meta.num_tensors = 1;
+
+  info = gst_tensors_info_get_nth_info (&prop->output_meta, 0);
+  gst_tensor_info_init (info);
+  info->type = config->output_type;
+  info->dimension[0] = config->n_classes + DETECTION_NUM_INFO;
+  info->dimension[1] = config->n_anchors;
+  info->dimension[2] = 1;
+  info->dimension[3] = 1;
+  prop->output_meta.num_tensors = 1;
+
+  labels = gst_sscma_yolov5_labels_new (config->labels);
+  GST_OBJECT_LOCK (priv);
+  old_labels = prop->labels;
+  prop->labels = labels;
+  priv->class_filter_dirty = TRUE;
+  priv->output_layout = config->layout;
+  priv->output_scale = config->output_scale;
+  priv->output_zero_point = config->output_zero_point;
+  gst_sscma_yolov5_update_decoder (priv);
+  if (config->conf_threshold >= 0.f)
+    priv->conf_threshold = config->conf_threshold;
+  if (config->iou_threshold >= 0.f)
+    priv->iou_threshold = MIN (config->iou_threshold, 1.f);
+  if (config->max_detections >= 0)
+    priv->max_detections = config->max_detections;
+  GST_OBJECT_UNLOCK (priv);
+  gst_sscma_yolov5_labels_unref (old_labels);
+
+  priv->input_name = config->input_name;
+  priv->output_name = config->output_name;
+  memcpy (priv->mean_vals, config->mean, sizeof (priv->mean_vals));
+  memcpy (priv->norm_vals, config->norm, sizeof (priv->norm_vals));
+  sscma_model_config_unref (priv->config);
+  priv->config = config;
+  return 0;
+}
+
+/** @brief Handle "PROP_MODE" for set-property */
+static gint
+_gtfc_setprop_MODE (GstSscmaYolov5 * priv, const GValue * value)
+{
+  const gchar *mode = g_value_get_string (value);
+
+  /* the caps are already negotiated for the current mode */
+  if (GST_STATE (priv) > GST_STATE_READY) {
+    GST_WARNING_OBJECT (priv, "mode can only be changed in the NULL or READY state.");
+    return -1;
+  }
+  if (mode == NULL || g_ascii_strcasecmp (mode, "video") == 0)
+    priv->mode = SSCMA_YOLOV5_MODE_VIDEO;
+  else if (g_ascii_strcasecmp (mode, "tensor") == 0)
+    priv->mode = SSCMA_YOLOV5_MODE_TENSOR;
+  else
+    return -1;
+  return 0;
+}
+
+/** @brief Handle "PROP_LINES" and "PROP_ZONES" for set-property */
+static gint
+_gtfc_setprop_ANALYTICS (GstSscmaYolov5 * priv, guint prop_id,
+    const GValue * value)
+{
+  const gchar *str = g_value_get_string (value);
+  gboolean ok;
+
+  GST_OBJECT_LOCK (priv);
+  if (prop_id == PROP_LINES) {
+    ok = sscma_analytics_set_lines (priv->analytics, str);
+    if (ok) {
+      g_free (priv->lines);
+      priv->lines = g_strdup (str);
+    }
+  } else {
+    ok = sscma_analytics_set_zones (priv->analytics, str);
+    if (ok) {
+      g_free (priv->zones);
+      priv->zones = g_strdup (str);
+    }
+  }
+  GST_OBJECT_UNLOCK (priv);
+  return ok ? 0 : -1;
+}
+
 static void
 gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -486,6 +1452,10 @@ gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
     case PROP_MODEL:
       status = _gtfc_setprop_MODEL (self, prop, value);
       break;
+    // 模型配置文件 config=xxx.yaml (代替 model/input/output/outputtype/labels)
+    case PROP_CONFIG:
+      status = _gtfc_setprop_CONFIG (self, prop, value);
+      break;
     // 标签文件配置 labels=xxx
     case PROP_MODE_LABELS:
       status = _gtfc_setprop_LABELS (self, prop, value);
@@ -496,7 +1466,10 @@ gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
       break;
     // 模型输出大小 output=85:6300:1:1 注:第2个维度为识别结果个数 后面画框会用到
     case PROP_OUTPUT:
+      GST_OBJECT_LOCK (self);
       status = _gtfc_setprop_DIMENSION (self, value, FALSE);
+      gst_sscma_yolov5_update_decoder (self);
+      GST_OBJECT_UNLOCK (self);
       break;
     // TODO:输入格式 inputformat=RGB
     case PROP_INPUTFORMAT:
@@ -508,24 +1481,304 @@ gst_sscma_yolov5_set_property (GObject * object, guint prop_id,
       break;
     // 输出类型 outputtype=float32
     case PROP_OUTPUTTYPE:
+      GST_OBJECT_LOCK (self);
       status = _gtfc_setprop_TYPE (self, value, FALSE);
+      gst_sscma_yolov5_update_decoder (self);
+      GST_OBJECT_UNLOCK (self);
       break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    // 输出模式 mode=video|tensor
+    case PROP_MODE:
+      status = _gtfc_setprop_MODE (self, value);
+      break;
+    // 标签字体缩放 font-scale=2 (0 为按分辨率自动)
+    case PROP_FONT_SCALE:
+      self->font_scale = g_value_get_uint (value);
+      break;
+    // 置信度阈值 conf-threshold=2500 (可运行时修改)
+    case PROP_CONF_THRESHOLD:
+      self->conf_threshold = g_value_get_float (value);
+      break;
+    // NMS 阈值 iou-threshold=0.25
+    case PROP_IOU_THRESHOLD:
+      self->iou_threshold = g_value_get_float (value);
+      break;
+    // 每帧最多检测数 max-detections=100
+    case PROP_MAX_DETECTIONS:
+      self->max_detections = g_value_get_uint (value);
+      break;
+    // 量化输出参数 output-scale=0.5 output-zero-point=-128 (int8/uint8 输出)
+    case PROP_OUTPUT_SCALE:
+      GST_OBJECT_LOCK (self);
+      self->output_scale = g_value_get_float (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_OUTPUT_ZERO_POINT:
+      GST_OBJECT_LOCK (self);
+      self->output_zero_point = g_value_get_int (value);
+      gst_sscma_yolov5_update_decoder (self);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // 只检测指定类别 classes=person,car 或 classes=0,2
+    case PROP_CLASSES:
+      GST_OBJECT_LOCK (self);
+      g_free (self->classes);
+      self->classes = g_value_dup_string (value);
+      self->class_filter_dirty = TRUE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // 检测区域 roi=x,y,w,h;x1,y1,x2,y2,x3,y3 (可运行时修改)
+    case PROP_ROI:
+      status = _gtfc_setprop_ROI (self, value);
+      break;
+    // 分块推理 tile-size=640 tile-overlap=0.2
+    case PROP_TILE_SIZE:
+      self->tile_size = g_value_get_uint (value);
+      break;
+    case PROP_TILE_OVERLAP:
+      self->tile_overlap = g_value_get_float (value);
+      break;
+    case PROP_TILE_ACTIVITY_THRESHOLD:
+      self->tile_activity_threshold = g_value_get_float (value);
+      break;
+    // 二级分类模型 secondary-model=xxx.bin,xxx.param secondary-input=3:64:64
+    case PROP_SECONDARY_MODEL:
+      status = _gtfc_setprop_SECONDARY_MODEL (self, value);
+      break;
+    case PROP_SECONDARY_INPUT:
+      status = _gtfc_setprop_SECONDARY_INPUT (self, value);
+      break;
+    case PROP_SECONDARY_LABELS:
+      status = _gtfc_setprop_SECONDARY_LABELS (self, value);
+      break;
+    // 需要二级分类的类别 secondary-classes=person
+    case PROP_SECONDARY_CLASSES:
+      GST_OBJECT_LOCK (self);
+      g_free (self->secondary_classes);
+      self->secondary_classes = g_value_dup_string (value);
+      self->class_filter_dirty = TRUE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_SECONDARY_INTERVAL:
+      self->secondary_interval = g_value_get_uint (value);
+      break;
+    // 目标跟踪 tracker=true
+    case PROP_TRACKER:
+      self->track = g_value_get_boolean (value);
+      break;
+    case PROP_TRACK_LOW_RATIO:
+      self->track_low_ratio = g_value_get_float (value);
+      break;
+    case PROP_TRACK_MAX_AGE:
+      self->track_max_age = g_value_get_uint (value);
+      break;
+    // 越线计数 lines=x1,y1,x2,y2;... 区域统计 zones=...
+    case PROP_LINES:
+    case PROP_ZONES:
+      status = _gtfc_setprop_ANALYTICS (self, prop_id, value);
+      break;
+    // 下游报告迟到的帧跳过推理 qos=false 关闭
+    case PROP_QOS:
+      GST_OBJECT_LOCK (self);
+      self->qos = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // 每帧处理时间上限 latency-budget=50 (毫秒)，超出时隔帧推理
+    case PROP_LATENCY_BUDGET:
+      GST_OBJECT_LOCK (self);
+      self->latency_budget = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // 按目标帧率自动选择输入尺寸 target-fps=15 input-sizes=256,320,416,640
+    case PROP_TARGET_FPS:
+      GST_OBJECT_LOCK (self);
+      self->target_fps = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INPUT_SIZES:
+      GST_OBJECT_LOCK (self);
+      g_free (self->input_sizes);
+      self->input_sizes = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    // 进入 PAUSED 时预热推理次数 warmup=2，0 表示不预热
+    case PROP_WARMUP:
+      GST_OBJECT_LOCK (self);
+      self->warmup = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  if(status != 0){
+    g_print ("Invalid param, please check your param.\n");
+  }
+}
+
+static void
+gst_sscma_yolov5_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSscmaYolov5 *filter = GST_SWIFT_YOLOV5 (object);
+
+  switch (prop_id) {
+    case PROP_MODEL:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->models ? filter->models : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_CONFIG:
+      g_value_set_string (value, filter->config ? filter->config->path : "");
+      break;
+    case PROP_MODE:
+      g_value_set_string (value,
+          filter->mode == SSCMA_YOLOV5_MODE_TENSOR ? "tensor" : "video");
+      break;
+    case PROP_FONT_SCALE:
+      g_value_set_uint (value, filter->font_scale);
+      break;
+    case PROP_CONF_THRESHOLD:
+      g_value_set_float (value, filter->conf_threshold);
+      break;
+    case PROP_IOU_THRESHOLD:
+      g_value_set_float (value, filter->iou_threshold);
+      break;
+    case PROP_OUTPUT_SCALE:
+      g_value_set_float (value, filter->output_scale);
+      break;
+    case PROP_OUTPUT_ZERO_POINT:
+      g_value_set_int (value, filter->output_zero_point);
+      break;
+    case PROP_MAX_DETECTIONS:
+      g_value_set_uint (value, filter->max_detections);
+      break;
+    case PROP_CLASSES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->classes ? filter->classes : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_ROI:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->roi ? filter->roi : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TILE_SIZE:
+      g_value_set_uint (value, filter->tile_size);
+      break;
+    case PROP_TILE_OVERLAP:
+      g_value_set_float (value, filter->tile_overlap);
+      break;
+    case PROP_TILE_ACTIVITY_THRESHOLD:
+      g_value_set_float (value, filter->tile_activity_threshold);
+      break;
+    case PROP_SECONDARY_MODEL:
+      g_value_set_string (value, filter->secondary_model ?
+          filter->secondary_model : "");
+      break;
+    case PROP_SECONDARY_INPUT:
+      g_value_take_string (value, filter->secondary_width ?
+          g_strdup_printf ("3:%d:%d", filter->secondary_width,
+              filter->secondary_height) : g_strdup (""));
+      break;
+    case PROP_SECONDARY_CLASSES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value,
+          filter->secondary_classes ? filter->secondary_classes : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_SECONDARY_INTERVAL:
+      g_value_set_uint (value, filter->secondary_interval);
+      break;
+    case PROP_TRACKER:
+      g_value_set_boolean (value, filter->track);
+      break;
+    case PROP_TRACK_LOW_RATIO:
+      g_value_set_float (value, filter->track_low_ratio);
+      break;
+    case PROP_TRACK_MAX_AGE:
+      g_value_set_uint (value, filter->track_max_age);
+      break;
+    case PROP_LINES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->lines ? filter->lines : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_ZONES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->zones ? filter->zones : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_ANALYTICS:
+      GST_OBJECT_LOCK (filter);
+      g_value_take_boxed (value,
+          sscma_analytics_get_counters (filter->analytics));
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_QOS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_boolean (value, filter->qos);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_LATENCY_BUDGET:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->latency_budget);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TARGET_FPS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_double (value, filter->target_fps);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_INPUT_SIZES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->input_sizes ? filter->input_sizes : "");
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_CURRENT_INPUT:
+    {
+      const guint32 *dim = filter->prop.input_meta.info[0].dimension;
+
+      GST_OBJECT_LOCK (filter);
+      g_value_take_string (value, g_strdup_printf ("%u:%d:%d", dim[0],
+              filter->input_width ? filter->input_width : (gint) dim[1],
+              filter->input_height ? filter->input_height : (gint) dim[2]));
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    }
+    case PROP_WARMUP:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->warmup);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_STARTUP_TIME:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->startup_us);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_FIRST_FRAME_LATENCY:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->first_frame_us);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_STATS:
+      GST_OBJECT_LOCK (filter);
+      g_value_take_boxed (value, gst_structure_new ("sscma-yolov5-stats",
+              "frames", G_TYPE_UINT64, filter->frame_count,
+              "inference-us", G_TYPE_UINT64,
+              filter->stage_us[SSCMA_YOLOV5_STAGE_INFERENCE],
+              "nms-us", G_TYPE_UINT64, filter->stage_us[SSCMA_YOLOV5_STAGE_NMS],
+              "tracker-us", G_TYPE_UINT64,
+              filter->stage_us[SSCMA_YOLOV5_STAGE_TRACKER],
+              "secondary-us", G_TYPE_UINT64,
+              filter->stage_us[SSCMA_YOLOV5_STAGE_SECONDARY],
+              "draw-us", G_TYPE_UINT64, filter->stage_us[SSCMA_YOLOV5_STAGE_DRAW],
+              "tracks", G_TYPE_UINT, filter->n_tracks,
+              "qos-processed", G_TYPE_UINT64, filter->qos_processed,
+              "qos-dropped", G_TYPE_UINT64, filter->qos_dropped,
+              "qos-proportion", G_TYPE_DOUBLE, filter->proportion,
+              "latency-us", G_TYPE_UINT64, filter->latency / GST_USECOND, NULL));
+      GST_OBJECT_UNLOCK (filter);
       break;
-  }
-  if(status != 0){
-    g_print ("Invalid param, please check your param.\n");
-  }
-}
-
-static void
-gst_sscma_yolov5_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
-{
-  GstSscmaYolov5 *filter = GST_SWIFT_YOLOV5 (object);
-
-  switch (prop_id) {
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -533,141 +1786,1801 @@ gst_sscma_yolov5_get_property (GObject * object, guint prop_id,
 }
 
 /**
- * @brief This function handles sink event.
+ * @brief Make the QoS message of a frame whose inference was skipped.
+ */
+static GstMessage *
+gst_sscma_yolov5_qos_message (GstSscmaYolov5 * self, GstBuffer * buf,
+    GstClockTime running_time, GstClockTimeDiff jitter)
+{
+  GstMessage *msg;
+
+  msg = gst_message_new_qos (GST_OBJECT (self), FALSE, running_time,
+      gst_segment_to_stream_time (&self->segment, GST_FORMAT_TIME,
+          GST_BUFFER_PTS (buf)), GST_BUFFER_PTS (buf),
+      GST_BUFFER_DURATION (buf));
+  GST_OBJECT_LOCK (self);
+  gst_message_set_qos_values (msg, jitter, self->proportion, 1000000);
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS, self->qos_processed,
+      self->qos_dropped);
+  GST_OBJECT_UNLOCK (self);
+  return msg;
+}
+
+/**
+ * @brief Forget the lateness reported by downstream and the last detections.
+ */
+static void
+gst_sscma_yolov5_reset_qos (GstSscmaYolov5 * self)
+{
+  GST_OBJECT_LOCK (self);
+  self->earliest_time = GST_CLOCK_TIME_NONE;
+  self->proportion = 1.0;
+  GST_OBJECT_UNLOCK (self);
+  g_array_set_size (self->last_results, 0);
+}
+
+/**
+ * @brief Check if downstream will get the frame too late to show it.
+ * A late frame skips the inference and posts a QoS message.
+ */
+static gboolean
+gst_sscma_yolov5_is_late (GstSscmaYolov5 * self, GstBuffer * buf)
+{
+  GstClockTime running_time, earliest_time;
+  gboolean qos;
+
+  GST_OBJECT_LOCK (self);
+  qos = self->qos;
+  earliest_time = self->earliest_time;
+  GST_OBJECT_UNLOCK (self);
+
+  if (!qos || !GST_CLOCK_TIME_IS_VALID (earliest_time) ||
+      !GST_BUFFER_PTS_IS_VALID (buf))
+    return FALSE;
+  running_time = gst_segment_to_running_time (&self->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buf));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time) || running_time > earliest_time)
+    return FALSE;
+
+  GST_OBJECT_LOCK (self);
+  self->qos_dropped++;
+  GST_OBJECT_UNLOCK (self);
+  GST_DEBUG_OBJECT (self, "Skipping the inference of a frame %" GST_TIME_FORMAT
+      " late", GST_TIME_ARGS (earliest_time - running_time));
+  gst_element_post_message (GST_ELEMENT (self),
+      gst_sscma_yolov5_qos_message (self, buf, running_time,
+          (GstClockTimeDiff) (earliest_time - running_time)));
+  return TRUE;
+}
+
+/**
+ * @brief Check if the frame should show the last detections to stay within
+ * the latency budget. While the average processing time is N times the
+ * budget, one frame out of N is inferred. Skipped frames are counted and
+ * reported like the late ones.
+ */
+static gboolean
+gst_sscma_yolov5_over_budget (GstSscmaYolov5 * self, GstBuffer * buf)
+{
+  GstClockTime budget, latency, running_time = GST_CLOCK_TIME_NONE;
+  guint64 interval;
+  gboolean skip;
+
+  GST_OBJECT_LOCK (self);
+  budget = self->latency_budget * GST_MSECOND;
+  latency = self->latency;
+  GST_OBJECT_UNLOCK (self);
+  if (budget == 0 || latency <= budget) {
+    self->budget_frames = 0;
+    return FALSE;
+  }
+
+  interval = (latency + budget - 1) / budget;
+  skip = ++self->budget_frames < interval;
+  if (!skip) {
+    self->budget_frames = 0;
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  self->qos_dropped++;
+  GST_OBJECT_UNLOCK (self);
+  GST_DEBUG_OBJECT (self, "Skipping the inference of a frame, %"
+      GST_TIME_FORMAT " over the latency budget",
+      GST_TIME_ARGS (latency - budget));
+  if (GST_BUFFER_PTS_IS_VALID (buf))
+    running_time = gst_segment_to_running_time (&self->segment,
+        GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+  gst_element_post_message (GST_ELEMENT (self),
+      gst_sscma_yolov5_qos_message (self, buf, running_time,
+          (GstClockTimeDiff) (latency - budget)));
+  return TRUE;
+}
+
+/**
+ * @brief Fold the processing time of an inferred frame into the rolling
+ * average, and let the pipeline know once it moves away from the latency
+ * it was told.
+ */
+static void
+gst_sscma_yolov5_update_latency (GstSscmaYolov5 * self, GstClockTime elapsed)
+{
+  GstClockTime latency, reported;
+
+  GST_OBJECT_LOCK (self);
+  /* how much the warm-up left for the first frame to pay */
+  if (self->first_frame_pending) {
+    self->first_frame_us = GST_TIME_AS_USECONDS (elapsed);
+    self->first_frame_pending = FALSE;
+  }
+  latency = self->latency = self->latency == 0 ? elapsed :
+      (self->latency * 7 + elapsed) / 8;
+  reported = self->reported_latency;
+  /* 20% either way, not to flood the bus with latency messages */
+  if (latency * 5 <= reported * 6 && latency * 5 >= reported * 4) {
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+  self->reported_latency = latency;
+  GST_OBJECT_UNLOCK (self);
+  gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_latency (GST_OBJECT (self)));
+}
+
+/**
+ * @brief Load the first model into self->net.
+ * @return FALSE if the model files cannot be loaded.
+ */
+static gboolean
+gst_sscma_yolov5_load_model (GstSscmaYolov5 * self)
+{
+  const gchar **files = self->prop.model_files;
+  gint64 t0;
+
+  /* a net loads once, drop what a previous model left */
+  self->net.clear ();
+  self->model_loaded = FALSE;
+  if (self->prop.num_models == 0)
+    return TRUE;
+  t0 = g_get_monotonic_time ();
+  self->model_loaded = self->net.load_param (files[1]) == 0 &&
+      self->net.load_model (files[0]) == 0;
+  if (!self->model_loaded) {
+    g_print ("sscma_yolov5: Cannot load the model %s, %s, please check the model property.\n",
+        files[0], files[1]);
+    return FALSE;
+  }
+  GST_OBJECT_LOCK (self);
+  self->load_us = self->startup_us = g_get_monotonic_time () - t0;
+  GST_OBJECT_UNLOCK (self);
+  return TRUE;
+}
+
+/**
+ * @brief Run a net on a blank input of the given size.
+ * @return The number of runs done, less than runs if one failed.
+ */
+static guint
+gst_sscma_yolov5_warmup_net (const ncnn::Net & net, const gchar * input_name,
+    const gchar * output_name, gboolean raw, ncnn::Mat & in, gint width,
+    gint height, guint runs)
+{
+  ncnn::Mat out;
+  guint i;
+
+  in.create (width, height, 3);
+  in.fill (0.f);
+  for (i = 0; i < runs; i++) {
+    if (!gst_sscma_yolov5_forward (net, input_name, output_name, raw, in, out))
+      break;
+  }
+  return i;
+}
+
+/**
+ * @brief Run the first model on blank inputs, so the first frame does not
+ * pay for the first run of the layers (weight packing, allocations, page
+ * faults). The input is the input property size, the one a stream starts at.
+ */
+static void
+gst_sscma_yolov5_warmup (GstSscmaYolov5 * self)
+{
+  const guint32 *dim = self->prop.input_meta.info[0].dimension;
+  guint i, runs;
+  gint64 t0;
+
+  GST_OBJECT_LOCK (self);
+  runs = self->warmup;
+  GST_OBJECT_UNLOCK (self);
+  if (!self->model_loaded || dim[1] == 0 || dim[2] == 0)
+    return;
+
+  t0 = g_get_monotonic_time ();
+  /* the frames are preprocessed into the same Mat */
+  i = gst_sscma_yolov5_warmup_net (self->net, self->input_name,
+      self->output_name, self->output_raw, self->input_mat, dim[1], dim[2],
+      runs);
+  if (i < runs)
+    g_print ("sscma_yolov5: The warm-up inference failed, please check the input and output properties.\n");
+  GST_OBJECT_LOCK (self);
+  self->startup_us = self->load_us + (g_get_monotonic_time () - t0);
+  GST_OBJECT_UNLOCK (self);
+  GST_INFO_OBJECT (self, "%u warm-up inferences in %" G_GINT64_FORMAT "us",
+      i, g_get_monotonic_time () - t0);
+}
+
+/**
+ * @brief Load the secondary model, unless loaded since secondary-model or
+ * secondary-input last changed.
+ */
+static void
+gst_sscma_yolov5_load_secondary (GstSscmaYolov5 * self)
+{
+  SscmaClassifierConfig config;
+
+  if (self->secondary_loaded)
+    return;
+  sscma_classifier_free (self->classifier);
+  self->classifier = NULL;
+  self->secondary_loaded = TRUE;
+  if (self->secondary_model_files == NULL ||
+      g_strv_length (self->secondary_model_files) < 2)
+    return;
+
+  config.input_name = self->secondary_input_name;
+  config.output_name = self->secondary_output_name;
+  memcpy (config.mean, self->secondary_mean, sizeof (config.mean));
+  memcpy (config.norm, self->secondary_norm, sizeof (config.norm));
+  if (self->secondary_width > 0 && self->secondary_height > 0)
+    self->classifier = sscma_classifier_new (self->secondary_model_files[1],
+        self->secondary_model_files[0], self->secondary_width,
+        self->secondary_height, &config);
+  if (self->classifier == NULL)
+    g_print ("sscma_yolov5: Cannot load the secondary model, please check secondary-model and secondary-input.\n");
+}
+
+/**
+ * @brief Load the models going to READY and warm them up going to PAUSED,
+ * instead of on the first buffers.
+ */
+static GstStateChangeReturn
+gst_sscma_yolov5_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (element);
+  GPtrArray *models;
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!self->model_loaded && !gst_sscma_yolov5_load_model (self))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      /* the model property may have changed in READY */
+      if (!self->model_loaded && !gst_sscma_yolov5_load_model (self))
+        return GST_STATE_CHANGE_FAILURE;
+      gst_sscma_yolov5_warmup (self);
+      GST_OBJECT_LOCK (self);
+      models = self->extra_models ? g_ptr_array_ref (self->extra_models) : NULL;
+      GST_OBJECT_UNLOCK (self);
+      gst_sscma_yolov5_load_models (self, models);
+      if (models)
+        g_ptr_array_unref (models);
+      gst_sscma_yolov5_load_secondary (self);
+      GST_OBJECT_LOCK (self);
+      self->first_frame_us = 0;
+      self->first_frame_pending = TRUE;
+      if (self->mode == SSCMA_YOLOV5_MODE_VIDEO && self->decode == NULL &&
+          self->prop.labels) {
+        if (!sscma_decoder_zero_point_valid (self->prop.output_meta.info[0].
+                type, self->output_zero_point))
+          g_print ("sscma_yolov5: output-zero-point %d does not fit the output type, nothing will be detected.\n",
+              self->output_zero_point);
+        else
+          g_print ("sscma_yolov5: %u labels do not match the output property (%u values per anchor), nothing will be detected.\n",
+              self->prop.labels->total,
+              self->prop.output_meta.info[0].dimension[0]);
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the cached mappings hold the dma-bufs of the stopped source */
+      sscma_dmabuf_cache_clear (self->dmabuf_cache);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      self->net.clear ();
+      self->model_loaded = FALSE;
+      sscma_classifier_free (self->classifier);
+      self->classifier = NULL;
+      self->secondary_loaded = FALSE;
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+/**
+ * @brief This function handles sink event.
+ */
+static gboolean
+gst_sscma_yolov5_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
+  gboolean ret;
+  GST_DEBUG_OBJECT (self, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:
+    {
+      // load model, unless already loaded going to READY
+      if (!self->model_loaded)
+        gst_sscma_yolov5_load_model (self);
+      gst_sscma_yolov5_setup_input_sizes (self);
+      gst_sscma_yolov5_load_secondary (self);
+      g_hash_table_remove_all (self->secondary_cache);
+      gst_sscma_yolov5_reset_qos (self);
+      /* the properties may have changed, check the caps of the new stream again */
+      gst_caps_replace (&self->sink_caps, NULL);
+      /* ids are per stream */
+      sscma_tracker_reset (self->tracker);
+      GST_OBJECT_LOCK (self);
+      sscma_analytics_reset (self->analytics);
+      GST_OBJECT_UNLOCK (self);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    }
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *in_caps;
+      gboolean same;
+      gst_event_parse_caps (event, &in_caps);
+
+      /* renegotiating to the same caps keeps the video info, pool and mappings */
+      same = self->sink_caps && (self->sink_caps == in_caps ||
+          gst_caps_is_equal (self->sink_caps, in_caps));
+      if (!same && !gst_sscma_yolov5_parse_caps (self, in_caps)) {
+        gst_event_unref (event);
+        ret = FALSE;
+        break;
+      }
+      gst_caps_replace (&self->sink_caps, in_caps);
+      if (self->mode == SSCMA_YOLOV5_MODE_TENSOR) {
+        /* downstream gets the model output, not the frames */
+        gst_event_unref (event);
+        ret = gst_sscma_yolov5_update_caps (self);
+        break;
+      }
+      if (self->is_dmabuf) {
+        /* the frames are copied into system memory to be drawn on */
+        GstCaps *out_caps = gst_caps_copy (in_caps);
+
+        gst_event_unref (event);
+        gst_caps_set_features_simple (out_caps, NULL);
+        ret = gst_pad_set_caps (self->srcpad, out_caps);
+        if (ret && !same)
+          gst_sscma_yolov5_decide_allocation (self, out_caps);
+        gst_caps_unref (out_caps);
+        break;
+      }
+      /* the event is consumed by the default handler, keep the caps alive */
+      in_caps = gst_caps_ref (in_caps);
+      ret = gst_pad_event_default (pad, parent, event);
+      if (ret && !same)
+        gst_sscma_yolov5_decide_allocation (self, in_caps);
+      gst_caps_unref (in_caps);
+      break;
+    }
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &self->segment);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_segment_init (&self->segment, GST_FORMAT_TIME);
+      gst_sscma_yolov5_reset_qos (self);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    default:
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief This function handles src pad event.
+ */
+static gboolean
+gst_sscma_yolov5_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
+  GST_DEBUG_OBJECT (self, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS) {
+    GstQOSType type;
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+
+    gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+    GST_OBJECT_LOCK (self);
+    self->proportion = proportion;
+    if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+      /* like GstBaseTransform, leave some room to catch up when late */
+      if (diff > 0)
+        self->earliest_time = timestamp + 2 * diff;
+      else
+        self->earliest_time = timestamp + diff;
+    }
+    GST_OBJECT_UNLOCK (self);
+  }
+  return gst_pad_event_default (pad, parent, event);
+}
+
+/**
+ * @brief This function handles sink pad query.
+ */
+static gboolean
+gst_sscma_yolov5_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
+  gboolean ret;
+  GST_DEBUG_OBJECT (self, "Received %s query: %" GST_PTR_FORMAT,
+      GST_QUERY_TYPE_NAME (query), query);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    {
+      GstCaps *caps;
+      GstCaps *filter;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_sscma_yolov5_query_caps (self, pad, filter);
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_ACCEPT_CAPS:
+    {
+      GstCaps *caps;
+      GstCaps *possible_caps;
+
+      gst_query_parse_accept_caps (query, &caps);
+      possible_caps = gst_sscma_yolov5_query_caps (self, pad, NULL);
+      gst_query_set_accept_caps_result (query,
+          gst_caps_is_fixed (caps) &&
+          gst_caps_can_intersect (possible_caps, caps));
+      gst_caps_unref (possible_caps);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_ALLOCATION:
+      ret = gst_sscma_yolov5_propose_allocation (self, query);
+      break;
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief This function handles src pad query.
+ */
+static gboolean
+gst_sscma_yolov5_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
+  gboolean ret;
+  GST_DEBUG_OBJECT (self, "Received %s query: %" GST_PTR_FORMAT,
+      GST_QUERY_TYPE_NAME (query), query);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:
+    {
+      GstCaps *caps;
+      GstCaps *filter;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_sscma_yolov5_query_caps (self, pad, filter);
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_ACCEPT_CAPS:
+    {
+      GstCaps *caps;
+      GstCaps *possible_caps;
+
+      gst_query_parse_accept_caps (query, &caps);
+      possible_caps = gst_sscma_yolov5_query_caps (self, pad, NULL);
+      gst_query_set_accept_caps_result (query,
+          gst_caps_is_fixed (caps) &&
+          gst_caps_can_intersect (possible_caps, caps));
+      gst_caps_unref (possible_caps);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_LATENCY:
+    {
+      gboolean live;
+      GstClockTime min, max, latency;
+
+      ret = gst_pad_peer_query (self->sinkpad, query);
+      if (!ret)
+        break;
+      /* every frame is held for the time the model takes on it */
+      GST_OBJECT_LOCK (self);
+      latency = self->reported_latency = self->latency;
+      GST_OBJECT_UNLOCK (self);
+      gst_query_parse_latency (query, &live, &min, &max);
+      min += latency;
+      if (GST_CLOCK_TIME_IS_VALID (max))
+        max += latency;
+      GST_DEBUG_OBJECT (self, "Adding %" GST_TIME_FORMAT " of latency",
+          GST_TIME_ARGS (latency));
+      gst_query_set_latency (query, live, min, max);
+      break;
+    }
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+/**
+ * @brief Answer the upstream allocation query.
+ *
+ * Frames are drawn on in place and pushed downstream, so downstream gets the
+ * first say. If it did not offer a pool, propose a video pool whose rows are
+ * aligned for the preprocessing. GstVideoMeta is always advertised since
+ * frames are mapped with their real strides and offsets.
+ */
+static gboolean
+gst_sscma_yolov5_propose_allocation (GstSscmaYolov5 * self, GstQuery * query)
+{
+  GstCaps *caps;
+  GstVideoInfo info;
+  GstAllocationParams params;
+  gboolean need_pool;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (caps == NULL)
+    return FALSE;
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    /* not a raw video stream, let downstream decide */
+    return gst_pad_peer_query (self->srcpad, query);
+  }
+
+  /* with mode=tensor the frames never reach downstream */
+  if (self->mode != SSCMA_YOLOV5_MODE_TENSOR)
+    gst_pad_peer_query (self->srcpad, query);
+
+  if (need_pool && gst_query_get_n_allocation_pools (query) == 0) {
+    GstBufferPool *pool;
+    GstStructure *config;
+    GstVideoAlignment align;
+    guint size, i;
+
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, info.size, 0, 0);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+
+    gst_video_alignment_reset (&align);
+    for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+      align.stride_align[i] = SSCMA_YOLOV5_STRIDE_ALIGN;
+    gst_buffer_pool_config_set_video_alignment (config, &align);
+
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (self, "Failed to configure the proposed pool.");
+      gst_object_unref (pool);
+      return FALSE;
+    }
+
+    /* the alignment may have grown the buffer size */
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_get_params (config, NULL, &size, NULL, NULL);
+    gst_structure_free (config);
+
+    gst_query_add_allocation_pool (query, pool, size, 0, 0);
+    gst_object_unref (pool);
+  }
+
+  if (!gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL))
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  if (gst_query_get_n_allocation_params (query) == 0) {
+    gst_allocation_params_init (&params);
+    params.align = SSCMA_YOLOV5_STRIDE_ALIGN;
+    gst_query_add_allocation_param (query, NULL, &params);
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Query downstream for the pool used when a frame cannot be drawn on
+ * in place (shared by a tee, or laid out with strides downstream can't read).
+ */
+static gboolean
+gst_sscma_yolov5_decide_allocation (GstSscmaYolov5 * self, GstCaps * caps)
+{
+  GstQuery *query;
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstVideoInfo info;
+  guint size = 0, min = 0, max = 0;
+
+  if (!gst_video_info_from_caps (&info, caps))
+    return FALSE;
+
+  query = gst_query_new_allocation (caps, TRUE);
+  if (!gst_pad_peer_query (self->srcpad, query))
+    GST_DEBUG_OBJECT (self, "Downstream did not answer the allocation query.");
+
+  self->downstream_video_meta =
+      gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+  if (gst_query_get_n_allocation_pools (query) > 0)
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+  gst_query_unref (query);
+
+  if (pool == NULL)
+    pool = gst_video_buffer_pool_new ();
+  size = MAX (size, (guint) info.size);
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  if (self->downstream_video_meta &&
+      gst_buffer_pool_has_option (pool, GST_BUFFER_POOL_OPTION_VIDEO_META))
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    /* the pool may have adjusted the config, accept it if it still fits */
+    config = gst_buffer_pool_get_config (pool);
+    if (!gst_buffer_pool_config_validate_params (config, caps, size, min, max)
+        || !gst_buffer_pool_set_config (pool, config)) {
+      GST_WARNING_OBJECT (self, "Failed to configure the downstream pool.");
+      gst_object_unref (pool);
+      return FALSE;
+    }
+  }
+
+  if (self->pool) {
+    gst_buffer_pool_set_active (self->pool, FALSE);
+    gst_object_unref (self->pool);
+  }
+  self->pool = pool;
+
+  return gst_buffer_pool_set_active (self->pool, TRUE);
+}
+
+/**
+ * @brief Get a buffer that can be drawn on and pushed downstream.
+ * @return The input buffer itself, or a copy from the downstream pool when the
+ * input is not writable or downstream cannot read its memory layout. The
+ * reference to the input buffer is consumed either way.
+ */
+static GstBuffer *
+gst_sscma_yolov5_prepare_output_buffer (GstSscmaYolov5 * self, GstBuffer * buf)
+{
+  GstVideoMeta *meta;
+  GstBuffer *outbuf = NULL;
+  GstVideoFrame in_frame, out_frame;
+  gboolean copy = !gst_buffer_is_writable (buf);
+  guint i;
+
+  meta = gst_buffer_get_video_meta (buf);
+  if (!copy && meta && !self->downstream_video_meta) {
+    for (i = 0; i < meta->n_planes; i++) {
+      if (meta->stride[i] != GST_VIDEO_INFO_PLANE_STRIDE (&self->vinfo, i) ||
+          meta->offset[i] != GST_VIDEO_INFO_PLANE_OFFSET (&self->vinfo, i)) {
+        copy = TRUE;
+        break;
+      }
+    }
+  }
+
+  if (!copy)
+    return buf;
+
+  if (self->pool == NULL ||
+      gst_buffer_pool_acquire_buffer (self->pool, &outbuf, NULL) != GST_FLOW_OK)
+    return gst_buffer_make_writable (buf);
+
+  if (!gst_video_frame_map (&in_frame, &self->vinfo, buf, GST_MAP_READ)) {
+    gst_buffer_unref (outbuf);
+    return gst_buffer_make_writable (buf);
+  }
+  if (!gst_video_frame_map (&out_frame, &self->vinfo, outbuf, GST_MAP_WRITE)) {
+    gst_video_frame_unmap (&in_frame);
+    gst_buffer_unref (outbuf);
+    return gst_buffer_make_writable (buf);
+  }
+
+  gst_video_frame_copy (&out_frame, &in_frame);
+  gst_video_frame_unmap (&out_frame);
+  gst_video_frame_unmap (&in_frame);
+
+  /* the pool buffer carries its own video meta, copy the rest */
+  gst_buffer_copy_into (outbuf, buf,
+      (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS),
+      0, -1);
+  gst_buffer_unref (buf);
+  return outbuf;
+}
+
+/**
+ * @brief Copy an imported dma-buf frame into a buffer of the downstream pool,
+ * in system memory, so the boxes can be drawn on it.
+ * @return The copy, or NULL if there is no pool buffer to copy into. The input
+ * buffer is left to the caller.
+ */
+static GstBuffer *
+gst_sscma_yolov5_copy_dmabuf_frame (GstSscmaYolov5 * self, GstBuffer * buf,
+    const SscmaImage * image)
+{
+  const GstVideoFormatInfo *finfo = self->vinfo.finfo;
+  GstBuffer *outbuf = NULL;
+  GstVideoFrame out_frame;
+  guint i, c, row;
+
+  if (self->pool == NULL ||
+      gst_buffer_pool_acquire_buffer (self->pool, &outbuf, NULL) != GST_FLOW_OK)
+    return NULL;
+  if (!gst_video_frame_map (&out_frame, &self->vinfo, outbuf, GST_MAP_WRITE)) {
+    gst_buffer_unref (outbuf);
+    return NULL;
+  }
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (&out_frame); i++) {
+    guint8 *dst = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (&out_frame, i);
+    gint dst_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&out_frame, i);
+    gsize row_size;
+    gint n_rows;
+
+    /* the first component stored in the plane gives its size */
+    for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); c++)
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, c) == i)
+        break;
+    row_size = (gsize) GST_VIDEO_FRAME_COMP_WIDTH (&out_frame, c) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (&out_frame, c);
+    n_rows = GST_VIDEO_FRAME_COMP_HEIGHT (&out_frame, c);
+    for (row = 0; row < (guint) n_rows; row++)
+      memcpy (dst + (gsize) row * dst_stride,
+          image->data[i] + (gsize) row * image->stride[i], row_size);
+  }
+  gst_video_frame_unmap (&out_frame);
+
+  gst_buffer_copy_into (outbuf, buf,
+      (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS),
+      0, -1);
+  return outbuf;
+}
+
+/**
+ * @brief Resolve a class allow-list of label names or indices into label indices.
+ * @return FALSE if the list is empty, which lets every class through.
+ */
+static gboolean
+gst_sscma_yolov5_resolve_classes (GstSscmaYolov5 * self, const gchar * classes,
+    GArray * filter)
+{
+  GstSscmaYolov5Labels *labels = self->prop.labels;
+  guint total = gst_sscma_yolov5_labels_count (labels);
+  gchar **tokens;
+  guint i, c;
+
+  g_array_set_size (filter, 0);
+  if (classes == NULL || classes[0] == '\0')
+    return FALSE;
+
+  tokens = g_strsplit (classes, ",", -1);
+  for (i = 0; tokens[i]; i++) {
+    gchar *name = g_strstrip (tokens[i]);
+    guint64 index;
+
+    if (name[0] == '\0')
+      continue;
+
+    for (c = 0; c < total; c++) {
+      if (g_strcmp0 (labels->names[c], name) == 0)
+        break;
+    }
+    if (c == total) {
+      if (g_ascii_string_to_unsigned (name, 10, 0, G_MAXUINT, &index, NULL) &&
+          index < total) {
+        c = index;
+      } else {
+        GST_WARNING_OBJECT (self, "Ignoring unknown class \"%s\".", name);
+        continue;
+      }
+    }
+    g_array_append_val (filter, c);
+  }
+  g_strfreev (tokens);
+
+  /* nothing matched: keep selecting nothing rather than everything */
+  if (filter->len == 0)
+    GST_WARNING_OBJECT (self, "No class of \"%s\" is in the labels.", classes);
+  return TRUE;
+}
+
+/**
+ * @brief Resolve the "classes" and "secondary-classes" allow-lists.
+ * Called with the object lock held.
+ */
+static void
+gst_sscma_yolov5_update_class_filter (GstSscmaYolov5 * self)
+{
+  self->class_filter_active = gst_sscma_yolov5_resolve_classes (self,
+      self->classes, self->class_filter);
+  self->secondary_filter_active = gst_sscma_yolov5_resolve_classes (self,
+      self->secondary_classes, self->secondary_filter);
+  self->class_filter_dirty = FALSE;
+}
+
+/**
+ * @brief Snapshot a resolved allow-list for one frame.
+ */
+#define gst_sscma_yolov5_copy_filter(filter, allowed, n_allowed) G_STMT_START { \
+  guint *_copy = g_newa (guint, MAX ((filter)->len, 1)); \
+  memcpy (_copy, (filter)->data, (filter)->len * sizeof (guint)); \
+  (allowed) = _copy; \
+  (n_allowed) = (filter)->len; \
+} G_STMT_END
+
+/**
+ * @brief Turn the raw model output for one region into detections in frame
+ * pixels, appended to results. The anchors above the threshold are found by
+ * the decoder picked for the layout and class count of the model.
+ * @param roi The part of the frame the model input was scaled from.
+ * @param region The polygon the roi bounds, NULL for a plain rectangle; boxes
+ * centred outside of it are dropped.
+ */
+static void
+gst_sscma_yolov5_decode (GstSscmaYolov5 * self, gconstpointer data,
+    const GstSscmaYolov5FrameParams * params, const SscmaRect * roi,
+    const SscmaRegion * region, GArray * results)
+{
+  const GstSscmaYolov5Shape *shape = &params->shape;
+  SscmaDecodeParams decode_params;
+  GArray *candidates;
+  /* model input pixels to frame pixels */
+  gfloat sx = (gfloat) roi->width / shape->input_width;
+  gfloat sy = (gfloat) roi->height / shape->input_height;
+
+  /* an allow-list matching no label lets nothing through */
+  if (shape->decode == NULL ||
+      (params->filter_classes && params->n_allowed == 0))
+    return;
+
+  decode_params.n_anchors = shape->n_anchors;
+  decode_params.n_classes = shape->n_classes;
+  decode_params.conf_threshold = params->conf_threshold;
+  /* only the allowed columns are looked at */
+  decode_params.allowed = params->filter_classes ? params->allowed : NULL;
+  decode_params.n_allowed = params->n_allowed;
+  decode_params.scale = shape->scale;
+  decode_params.zero_point = shape->zero_point;
+
+  candidates = g_array_new (FALSE, FALSE, sizeof (SscmaCandidate));
+  shape->decode (data, &decode_params, candidates);
+
+  for (guint i = 0; i < candidates->len; i++) {
+    const SscmaCandidate *c = &g_array_index (candidates, SscmaCandidate, i);
+    detectedObject object;
+    float cx, cy, w, h, x1, y1, x2, y2;
+    cx = roi->x + c->cx * sx;
+    cy = roi->y + c->cy * sy;
+    w = c->w * sx;
+    h = c->h * sy;
+
+    if (region && !sscma_region_contains (region, GST_VIDEO_INFO_WIDTH (&self->vinfo),
+            GST_VIDEO_INFO_HEIGHT (&self->vinfo), cx, cy))
+      continue;
+
+    // todo:可配置是否归一化
+    x1 = MAX ((float) roi->x, cx - w / 2.f);
+    y1 = MAX ((float) roi->y, cy - h / 2.f);
+    x2 = MIN ((float) (roi->x + roi->width), cx + w / 2.f);
+    y2 = MIN ((float) (roi->y + roi->height), cy + h / 2.f);
+    if (x2 <= x1 || y2 <= y1)
+      continue;
+
+    object.x = (int) x1;
+    object.y = (int) y1;
+    object.width = (int) (x2 - x1);
+    object.height = (int) (y2 - y1);
+
+    object.prob = c->prob;
+    object.class_id = c->class_id;
+    object.model_id = shape->model_id;
+    /* set by the tracker, if enabled */
+    object.tracking_id = -1;
+    object.secondary_class_id = -1;
+    object.secondary_prob = 0.f;
+    object.valid = TRUE;
+    g_array_append_val (results, object);
+  }
+  g_array_free (candidates, TRUE);
+}
+
+/**
+ * @brief Run the model on an input blob.
+ */
+static gboolean
+gst_sscma_yolov5_forward (const ncnn::Net & model, const gchar * input_name,
+    const gchar * output_name, gboolean raw, const ncnn::Mat & in,
+    ncnn::Mat & out)
+{
+  /* an extractor caches its blobs, so each input needs its own */
+  ncnn::Extractor ex = model.create_extractor();
+
+  ex.input(input_name, in);
+  /* raw: a float16/int8 output stays as it is instead of becoming float32 */
+  if (ex.extract(output_name, out, raw ? 1 : 0) != 0 || out.empty())
+    return FALSE;
+  if (out.elempack > 1) {
+    ncnn::Mat flat;
+
+    ncnn::convert_packing (out, flat, 1, model.opt);
+    out = flat;
+  }
+  return !out.empty();
+}
+
+/**
+ * @brief Crop, scale and convert one rectangle of the image and run the
+ * model on it.
+ */
+static gboolean
+gst_sscma_yolov5_forward_image (GstSscmaYolov5 * self,
+    const SscmaImage * image, const SscmaRect * roi, ncnn::Mat & out)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  /* same size every frame, only allocated again if the input size changes */
+  ncnn::Mat & in_pad = self->input_mat;
+  gint width = prop->input_meta.info[0].dimension[1];
+  gint height = prop->input_meta.info[0].dimension[2];
+  gboolean ret;
+  gint64 t0;
+
+  if (self->sizes) {
+    const GstSscmaYolov5InputSize *size = &g_array_index (self->sizes,
+        GstSscmaYolov5InputSize, self->size_index);
+
+    width = size->width;
+    height = size->height;
+  }
+  if (!sscma_preprocess (image, roi, width, height, self->mean_vals,
+          self->norm_vals, in_pad)) {
+    g_print ("sscma_yolov5: Cannot convert the %s frame into the model input.\n",
+        gst_video_format_to_string (image->format));
+    return FALSE;
+  }
+  t0 = g_get_monotonic_time ();
+  ret = gst_sscma_yolov5_forward (self->net, self->input_name, self->output_name,
+      self->output_raw, in_pad, out);
+  self->model_us += g_get_monotonic_time () - t0;
+  return ret;
+}
+
+/**
+ * @brief Check the first model gives an output of the expected size at
+ * another input size, i.e. it was exported with dynamic shapes.
+ */
+static gboolean
+gst_sscma_yolov5_check_input_size (GstSscmaYolov5 * self,
+    const GstSscmaYolov5InputSize * size)
+{
+  const guint32 *dim = self->prop.output_meta.info[0].dimension;
+  ncnn::Mat in (size->width, size->height, 3), out;
+
+  in.fill (0.f);
+  if (!gst_sscma_yolov5_forward (self->net, self->input_name, self->output_name,
+          FALSE, in, out))
+    return FALSE;
+  return out.total () == (gsize) dim[0] * size->n_anchors * MAX (dim[2], 1);
+}
+
+/**
+ * @brief Add an input size to the sizes target-fps picks from, keeping them
+ * sorted by width.
+ * @return The index of the size.
+ */
+static guint
+gst_sscma_yolov5_add_input_size (GArray * sizes,
+    const GstSscmaYolov5InputSize * size)
+{
+  guint i;
+
+  for (i = 0; i < sizes->len; i++) {
+    const GstSscmaYolov5InputSize *s =
+        &g_array_index (sizes, GstSscmaYolov5InputSize, i);
+
+    if (s->width == size->width)
+      return i;
+    if (s->width > size->width)
+      break;
+  }
+  g_array_insert_val (sizes, i, *size);
+  return i;
+}
+
+/**
+ * @brief Pick the input sizes the first model can run at (target-fps), once
+ * the model is loaded at the start of a stream. The stream starts at the
+ * size of the input property.
+ */
+static void
+gst_sscma_yolov5_setup_input_sizes (GstSscmaYolov5 * self)
+{
+  GstSscmaYolov5Properties *prop = &self->prop;
+  const guint32 *in_dim = prop->input_meta.info[0].dimension;
+  const guint32 *out_dim = prop->output_meta.info[0].dimension;
+  GstSscmaYolov5InputSize size;
+  gdouble target_fps;
+  gchar **tokens;
+  guint i;
+
+  if (self->sizes)
+    g_array_unref (self->sizes);
+  self->sizes = NULL;
+  self->model_avg_us = 0;
+  self->size_frames = 0;
+
+  GST_OBJECT_LOCK (self);
+  self->input_width = in_dim[1];
+  self->input_height = in_dim[2];
+  target_fps = self->target_fps;
+  tokens = g_strsplit (self->input_sizes ? self->input_sizes : "", ",", -1);
+  GST_OBJECT_UNLOCK (self);
+
+  /* the output caps of mode=tensor follow the output property */
+  if (target_fps <= 0 || self->mode == SSCMA_YOLOV5_MODE_TENSOR ||
+      prop->num_models == 0 || in_dim[1] == 0 || in_dim[2] == 0 ||
+      out_dim[1] == 0) {
+    g_strfreev (tokens);
+    return;
+  }
+
+  self->sizes = g_array_new (FALSE, FALSE, sizeof (GstSscmaYolov5InputSize));
+  size.width = in_dim[1];
+  size.height = in_dim[2];
+  size.n_anchors = out_dim[1];
+  gst_sscma_yolov5_add_input_size (self->sizes, &size);
+
+  for (i = 0; tokens[i]; i++) {
+    gint64 width = g_ascii_strtoll (g_strstrip (tokens[i]), NULL, 10);
+
+    /* the grids of the 8, 16 and 32 pixel strides must divide the size */
+    if (width <= 0 || width % 32) {
+      g_print ("sscma_yolov5: Ignoring the input size %s, it must be a multiple of 32.\n",
+          tokens[i]);
+      continue;
+    }
+    size.width = (gint) width;
+    size.height = MAX (32, (gint) ((width * in_dim[2] / in_dim[1] + 16) / 32 * 32));
+    /* the anchors per grid cell are fixed, so the rows follow the area */
+    size.n_anchors = (guint) ((guint64) out_dim[1] * size.width * size.height /
+        ((guint64) in_dim[1] * in_dim[2]));
+    if (size.width == (gint) in_dim[1])
+      continue;
+    if (!gst_sscma_yolov5_check_input_size (self, &size)) {
+      g_print ("sscma_yolov5: The model does not take a %d:%d input, target-fps will not use it.\n",
+          size.width, size.height);
+      continue;
+    }
+    gst_sscma_yolov5_add_input_size (self->sizes, &size);
+  }
+  g_strfreev (tokens);
+
+  size.width = in_dim[1];
+  self->size_index = gst_sscma_yolov5_add_input_size (self->sizes, &size);
+}
+
+/**
+ * @brief Follow target-fps at the end of an inferred frame. The time the first
+ * model took is averaged; after SSCMA_YOLOV5_SIZE_HOLD_FRAMES at a size the
+ * next frame may use a smaller size if the frame period is exceeded, or the
+ * next bigger one if it is predicted to take less than 70% of the period.
+ * The time is predicted proportional to the input area.
+ */
+static void
+gst_sscma_yolov5_adapt_input_size (GstSscmaYolov5 * self)
+{
+  const GstSscmaYolov5InputSize *cur, *size;
+  gdouble period_us, predicted = 0;
+  gdouble target_fps;
+  guint index;
+
+  if (self->sizes == NULL || self->sizes->len < 2)
+    return;
+  GST_OBJECT_LOCK (self);
+  target_fps = self->target_fps;
+  GST_OBJECT_UNLOCK (self);
+  if (target_fps <= 0)
+    return;
+
+  self->model_avg_us = self->model_avg_us == 0 ? self->model_us :
+      self->model_avg_us * 0.8 + self->model_us * 0.2;
+  if (++self->size_frames < SSCMA_YOLOV5_SIZE_HOLD_FRAMES)
+    return;
+
+  period_us = G_USEC_PER_SEC / target_fps;
+  cur = &g_array_index (self->sizes, GstSscmaYolov5InputSize,
+      self->size_index);
+  index = self->size_index;
+  if (self->model_avg_us > period_us) {
+    /* the biggest smaller size that fits, with some room */
+    while (index > 0) {
+      size = &g_array_index (self->sizes, GstSscmaYolov5InputSize, --index);
+      predicted = self->model_avg_us * size->width * size->height /
+          ((gdouble) cur->width * cur->height);
+      if (predicted <= period_us * 0.9)
+        break;
+    }
+  } else if (index + 1 < self->sizes->len) {
+    size = &g_array_index (self->sizes, GstSscmaYolov5InputSize, index + 1);
+    predicted = self->model_avg_us * size->width * size->height /
+        ((gdouble) cur->width * cur->height);
+    if (predicted < period_us * 0.7)
+      index++;
+  }
+  if (index == self->size_index)
+    return;
+
+  size = &g_array_index (self->sizes, GstSscmaYolov5InputSize, index);
+  GST_INFO_OBJECT (self, "%.0fus per frame at %d:%d for a %.0fus period, switching to %d:%d",
+      self->model_avg_us, cur->width, cur->height, period_us, size->width,
+      size->height);
+  self->size_index = index;
+  self->model_avg_us = predicted;
+  self->size_frames = 0;
+  GST_OBJECT_LOCK (self);
+  self->input_width = size->width;
+  self->input_height = size->height;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * @brief Run the model on a preprocessed other/tensors buffer.
+ * Planar tensors whose channels already have ncnn's 16-byte alignment are
+ * handed to the model in place; others are repacked.
+ */
+static gboolean
+gst_sscma_yolov5_forward_tensor (GstSscmaYolov5 * self, GstBuffer * buf,
+    ncnn::Mat & out)
+{
+  const guint32 *dim = self->prop.input_meta.info[0].dimension;
+  gint c = dim[0], w = dim[1], h = dim[2];
+  gsize plane = (gsize) w * h;
+  const float *src;
+  GstMapInfo map;
+  ncnn::Mat in;
+  gboolean ret;
+  gint q;
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ)) {
+    g_print ("sscma_yolov5: Cannot map the incoming tensor for reading.\n");
+    return FALSE;
+  }
+  if (map.size < plane * c * sizeof (float)) {
+    g_print ("sscma_yolov5: The incoming tensor is too small for the input property.\n");
+    gst_buffer_unmap (buf, &map);
+    return FALSE;
+  }
+
+  src = (const float *) map.data;
+  if (self->tensor_planar)
+    in = ncnn::Mat (w, h, c, (void *) src);
+  if (!self->tensor_planar || in.cstep != plane) {
+    in.create (w, h, c);
+    for (q = 0; q < c; q++) {
+      float *dst = in.channel (q);
+      gsize i;
+
+      if (self->tensor_planar) {
+        memcpy (dst, src + q * plane, plane * sizeof (float));
+        continue;
+      }
+      for (i = 0; i < plane; i++)
+        dst[i] = src[i * c + q];
+    }
+  }
+
+  ret = gst_sscma_yolov5_forward (self->net, self->input_name, self->output_name,
+      self->output_raw, in, out);
+  gst_buffer_unmap (buf, &map);
+  return ret;
+}
+
+/**
+ * @brief Run the model on one rectangle of the image.
+ * @param input The rectangle already preprocessed, or NULL.
+ * @param[out] out Receives the raw output tensor (out_size bytes), decoded
+ * in place while it holds the blob.
+ */
+static gboolean
+gst_sscma_yolov5_infer (GstSscmaYolov5 * self, const SscmaImage * image,
+    const SscmaRect * roi, const ncnn::Mat * input, gsize out_size,
+    ncnn::Mat & out)
+{
+  gint64 t0;
+
+  if (input) {
+    t0 = g_get_monotonic_time ();
+    if (!gst_sscma_yolov5_forward (self->net, self->input_name, self->output_name,
+            self->output_raw, *input, out))
+      return FALSE;
+    self->model_us += g_get_monotonic_time () - t0;
+  } else if (!gst_sscma_yolov5_forward_image (self, image, roi, out))
+    return FALSE;
+  /* e.g. outputtype=float16 on a net that does not store float16 */
+  if (out.total() * out.elemsize != out_size) {
+    GST_ERROR_OBJECT (self, "The model output (%" G_GSIZE_FORMAT
+        " bytes per element) does not match the output and outputtype properties.",
+        out.elemsize);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Free the reference on an output blob held by a wrapped GstMemory.
+ */
+static void
+gst_sscma_yolov5_mat_free (gpointer data)
+{
+  delete (ncnn::Mat *) data;
+}
+
+/**
+ * @brief Wrap an output blob into an other/tensors buffer.
+ * The blob is reference counted, so the buffer keeps it alive without a copy
+ * until downstream releases it. Blobs with padded channels are copied.
+ * @return NULL if the blob does not match the "output" property.
+ */
+static GstBuffer *
+gst_sscma_yolov5_wrap_mat (GstSscmaYolov5 * self, const ncnn::Mat & out)
+{
+  const GstTensorInfo *info = &self->prop.output_meta.info[0];
+  gsize size = tensor_element_size[info->type];
+  gsize channel_size;
+  GstBuffer *outbuf;
+  GstMapInfo map;
+  guint i;
+
+  for (i = 0; i < gst_tensor_dimension_get_rank (info->dimension); i++)
+    size *= info->dimension[i];
+
+  channel_size = (gsize) out.w * out.h * out.d * out.elemsize;
+  if (channel_size * out.c != size) {
+    GST_ERROR_OBJECT (self, "The model output (%d:%d:%d:%d, %" G_GSIZE_FORMAT
+        " bytes per element) does not match the output property.", out.w,
+        out.h, out.d, out.c, out.elemsize);
+    return NULL;
+  }
+
+  if (out.c == 1 || out.cstep * out.elemsize == channel_size) {
+    outbuf = gst_buffer_new ();
+    gst_buffer_append_memory (outbuf,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, out.data, size, 0,
+            size, new ncnn::Mat (out), gst_sscma_yolov5_mat_free));
+    return outbuf;
+  }
+
+  /* channels are aligned to 16 bytes in ncnn, pack them */
+  outbuf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  for (i = 0; i < (guint) out.c; i++)
+    memcpy (map.data + i * channel_size, out.channel (i).data, channel_size);
+  gst_buffer_unmap (outbuf, &map);
+  return outbuf;
+}
+
+/**
+ * @brief Push the raw model output of a frame downstream (mode=tensor).
+ * Decoding, drawing and the per-object stages are left to downstream; the
+ * model looks at the whole frame, or at the tensor prepared upstream.
+ */
+static GstFlowReturn
+gst_sscma_yolov5_push_tensor (GstSscmaYolov5 * self, GstBuffer * buf)
+{
+  GstVideoFrame frame;
+  SscmaImage image;
+  SscmaDmabufAccess access = { { NULL }, 0 };
+  SscmaRect roi;
+  ncnn::Mat out;
+  GstBuffer *outbuf = NULL;
+  gboolean mapped = FALSE;
+  gint64 t0;
+
+  t0 = g_get_monotonic_time ();
+  if (self->is_tensor) {
+    /* preprocessed upstream */
+    if (gst_sscma_yolov5_forward_tensor (self, buf, out))
+      outbuf = gst_sscma_yolov5_wrap_mat (self, out);
+    goto done;
+  }
+
+  if (self->is_dmabuf) {
+    if (!sscma_dmabuf_cache_map_frame (self->dmabuf_cache, buf, &self->vinfo,
+            &image, &access)) {
+      g_print ("sscma_yolov5: Cannot import the incoming DMABuf frame.\n");
+      goto error;
+    }
+  } else {
+    if (!gst_video_frame_map (&frame, &self->vinfo, buf, GST_MAP_READ)) {
+      g_print ("sscma_yolov5: Cannot map the incoming video frame for reading.\n");
+      goto error;
+    }
+    mapped = TRUE;
+    sscma_image_from_video_frame (&image, &frame);
+  }
+
+  roi.x = roi.y = 0;
+  roi.width = image.width;
+  roi.height = image.height;
+  if (gst_sscma_yolov5_forward_image (self, &image, &roi, out))
+    outbuf = gst_sscma_yolov5_wrap_mat (self, out);
+  if (mapped)
+    gst_video_frame_unmap (&frame);
+  sscma_dmabuf_cache_unmap_frame (&access);
+done:
+  if (outbuf == NULL)
+    goto error;
+
+  GST_OBJECT_LOCK (self);
+  memset (self->stage_us, 0, sizeof (self->stage_us));
+  self->stage_us[SSCMA_YOLOV5_STAGE_INFERENCE] = g_get_monotonic_time () - t0;
+  self->frame_count++;
+  GST_OBJECT_UNLOCK (self);
+  gst_sscma_yolov5_update_latency (self,
+      (g_get_monotonic_time () - t0) * GST_USECOND);
+
+  gst_buffer_copy_into (outbuf, buf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+  gst_buffer_unref (buf);
+  return gst_pad_push (self->srcpad, outbuf);
+error:
+  gst_buffer_unref (buf);
+  return GST_FLOW_ERROR;
+}
+
+/**
+ * @brief Get the start of tile i of n covering [0, size) with tiles of tile
+ * pixels; the first and last tiles are flush with the edges.
+ */
+static inline gint
+gst_sscma_yolov5_tile_start (gint i, gint n, gint size, gint tile)
+{
+  return n > 1 ? (gint) ((gint64) i * (size - tile) / (n - 1)) : 0;
+}
+
+/**
+ * @brief Get how many tiles of tile pixels overlapping by overlap cover size pixels.
+ */
+static inline gint
+gst_sscma_yolov5_tile_count (gint size, gint tile, gfloat overlap)
+{
+  gint step = MAX (1, (gint) (tile * (1.f - overlap)));
+
+  if (size <= tile)
+    return 1;
+  return (size - tile + step - 1) / step + 1;
+}
+
+/**
+ * @brief Detect objects in one region, either scaled whole into the model
+ * input or split into overlapping tiles (SAHI-style slicing) so that small
+ * objects keep enough pixels. Duplicates on tile seams are left to nms().
  */
 static gboolean
-gst_sscma_yolov5_sink_event (GstPad * pad, GstObject * parent,
-    GstEvent * event)
+gst_sscma_yolov5_detect_region (GstSscmaYolov5 * self,
+    const SscmaImage * image, const SscmaRect * roi,
+    const SscmaRegion * region, const GstSscmaYolov5FrameParams * params,
+    const ncnn::Mat * input, gsize out_size, GArray * results)
 {
-  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
-  gboolean ret;
-  GST_DEBUG_OBJECT (self, "Received %s event: %" GST_PTR_FORMAT,
-      GST_EVENT_TYPE_NAME (event), event);
+  ncnn::Mat out;
+  GArray *coarse = NULL;
+  gint tile_w, tile_h, nx, ny, tx, ty;
+  gboolean ret = TRUE;
+  guint i;
 
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_STREAM_START:
-    {
-      // load model
-      if (self->prop.num_models > 0) {
-        net.load_param(self->prop.model_files[1]);
-        net.load_model(self->prop.model_files[0]);
-      }
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
+  if (params->tile_size == 0 ||
+      (roi->width <= (gint) params->tile_size &&
+          roi->height <= (gint) params->tile_size)) {
+    if (!gst_sscma_yolov5_infer (self, image, roi, input, out_size, out))
+      return FALSE;
+    gst_sscma_yolov5_decode (self, (const gfloat *) out.data, params, roi,
+        region, results);
+    return TRUE;
+  }
+
+  if (params->tile_activity_threshold > 0.f) {
+    GstSscmaYolov5FrameParams coarse_params = *params;
+
+    /* a cheap look at the whole region tells where the activity is, and
+     * keeps what is confident enough to be a detection already */
+    coarse_params.conf_threshold = MIN (params->tile_activity_threshold,
+        params->conf_threshold);
+    if (!gst_sscma_yolov5_infer (self, image, roi, input, out_size, out))
+      return FALSE;
+    coarse = g_array_new (FALSE, FALSE, sizeof (detectedObject));
+    gst_sscma_yolov5_decode (self, (const gfloat *) out.data, &coarse_params,
+        roi, region, coarse);
+
+    /* big objects are found by the coarse pass already */
+    for (i = 0; i < coarse->len; i++) {
+      detectedObject *a = &g_array_index (coarse, detectedObject, i);
+      if (a->prob > params->conf_threshold)
+        g_array_append_val (results, *a);
     }
-    case GST_EVENT_CAPS:
-    {
-      GstCaps *in_caps;
-      gst_event_parse_caps (event, &in_caps);
+  }
 
-      if (gst_sscma_yolov5_parse_caps (self, in_caps)) {
-        // ret = gst_sscma_yolov5_update_caps (self);
-        gst_event_unref (event);
-      } else {
-        gst_event_unref (event);
-        // ret = FALSE;
+  tile_w = MIN ((gint) params->tile_size, roi->width);
+  tile_h = MIN ((gint) params->tile_size, roi->height);
+  nx = gst_sscma_yolov5_tile_count (roi->width, tile_w, params->tile_overlap);
+  ny = gst_sscma_yolov5_tile_count (roi->height, tile_h, params->tile_overlap);
+
+  for (ty = 0; ty < ny && ret; ty++) {
+    for (tx = 0; tx < nx && ret; tx++) {
+      SscmaRect tile;
+
+      tile.x = roi->x + gst_sscma_yolov5_tile_start (tx, nx, roi->width, tile_w);
+      tile.y = roi->y + gst_sscma_yolov5_tile_start (ty, ny, roi->height, tile_h);
+      tile.width = tile_w;
+      tile.height = tile_h;
+
+      if (coarse) {
+        for (i = 0; i < coarse->len; i++) {
+          detectedObject *a = &g_array_index (coarse, detectedObject, i);
+          /* the coarse pass also holds the detections below the activity threshold */
+          if (a->prob < params->tile_activity_threshold)
+            continue;
+          if (a->x < tile.x + tile.width && a->x + a->width > tile.x &&
+              a->y < tile.y + tile.height && a->y + a->height > tile.y)
+            break;
+        }
+        /* nothing going on here */
+        if (i == coarse->len)
+          continue;
       }
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
+
+      ret = gst_sscma_yolov5_infer (self, image, &tile, NULL, out_size, out);
+      if (ret)
+        gst_sscma_yolov5_decode (self, (const gfloat *) out.data, params,
+            &tile, region, results);
     }
-    default:
-      break;
   }
 
+  if (coarse)
+    g_array_free (coarse, TRUE);
   return ret;
 }
 
 /**
- * @brief This function handles sink pad query.
+ * @brief Model inputs of one region, preprocessed once per input size and
+ * normalisation.
  */
-static gboolean
-gst_sscma_yolov5_sink_query (GstPad * pad, GstObject * parent,
-    GstQuery * query)
+typedef struct
 {
-  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
-  gboolean ret;
-  GST_DEBUG_OBJECT (self, "Received %s query: %" GST_PTR_FORMAT,
-      GST_QUERY_TYPE_NAME (query), query);
+  guint n; /**< number of inputs */
+  gint width[SSCMA_YOLOV5_MAX_SHARED_INPUTS]; /**< input width */
+  gint height[SSCMA_YOLOV5_MAX_SHARED_INPUTS]; /**< input height */
+  const gfloat *mean[SSCMA_YOLOV5_MAX_SHARED_INPUTS]; /**< per channel mean */
+  const gfloat *norm[SSCMA_YOLOV5_MAX_SHARED_INPUTS]; /**< per channel scale */
+  ncnn::Mat mat[SSCMA_YOLOV5_MAX_SHARED_INPUTS]; /**< preprocessed region */
+} GstSscmaYolov5Inputs;
 
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_CAPS:
-    {
-      GstCaps *caps;
-      GstCaps *filter;
+/**
+ * @brief One extra model running on one region on the worker pool.
+ */
+typedef struct
+{
+  GstSscmaYolov5Model *model; /**< the model, loaded */
+  const ncnn::Mat *input; /**< shared input, NULL to preprocess in the job */
+  const SscmaImage *image; /**< the frame */
+  SscmaRect roi; /**< bounds of the region */
+  const SscmaRegion *region; /**< the region, NULL for the whole frame */
+  GstSscmaYolov5FrameParams params; /**< frame parameters for this model */
+  GArray *results; /**< detections of this model, NULL if it is not running */
+} GstSscmaYolov5ModelJob;
 
-      gst_query_parse_caps (query, &filter);
-      // TODO:输入应固定为模型需要的视频大小
-      // caps = gst_caps_new_any ();
-      // gst_query_set_caps_result (query, caps);
-      // gst_caps_unref (caps);
-      ret = gst_pad_query_default (pad, parent, query);
+/**
+ * @brief Check if the first model looks at the region as a whole (rather than
+ * only at its tiles), so its input can be shared.
+ */
+static inline gboolean
+gst_sscma_yolov5_whole_region_pass (const GstSscmaYolov5FrameParams * params,
+    const SscmaRect * roi)
+{
+  return params->tile_size == 0 || params->tile_activity_threshold > 0.f ||
+      (roi->width <= (gint) params->tile_size &&
+          roi->height <= (gint) params->tile_size);
+}
 
-    }
-    case GST_QUERY_ACCEPT_CAPS:
-    {
-      GstCaps *caps;
-      GstCaps *template_caps;
-      gboolean res = FALSE;
-      // TODO:根据下一个插件选择输出类型
-      // gst_query_parse_accept_caps (query, &caps);
+/**
+ * @brief Get the region preprocessed for an input size and normalisation,
+ * preprocessing it the first time they are asked for.
+ * @return NULL if too many inputs are asked for or preprocessing fails.
+ */
+static const ncnn::Mat *
+gst_sscma_yolov5_inputs_get (GstSscmaYolov5Inputs * inputs,
+    const SscmaImage * image, const SscmaRect * roi, gint width, gint height,
+    const gfloat mean[3], const gfloat norm[3])
+{
+  guint i;
+
+  for (i = 0; i < inputs->n; i++) {
+    if (inputs->width[i] == width && inputs->height[i] == height &&
+        memcmp (inputs->mean[i], mean, 3 * sizeof (gfloat)) == 0 &&
+        memcmp (inputs->norm[i], norm, 3 * sizeof (gfloat)) == 0)
+      return &inputs->mat[i];
+  }
+  if (inputs->n == SSCMA_YOLOV5_MAX_SHARED_INPUTS ||
+      !sscma_preprocess (image, roi, width, height, mean, norm,
+          inputs->mat[inputs->n]))
+    return NULL;
+
+  inputs->width[inputs->n] = width;
+  inputs->height[inputs->n] = height;
+  inputs->mean[inputs->n] = mean;
+  inputs->norm[inputs->n] = norm;
+  return &inputs->mat[inputs->n++];
+}
 
-      // if (gst_caps_is_fixed (caps)) {
-      //   template_caps = gst_pad_get_pad_template_caps (pad);
+/**
+ * @brief Run an extra model on a region (worker pool thread).
+ */
+static void
+gst_sscma_yolov5_model_job (gpointer data, gpointer user_data)
+{
+  GstSscmaYolov5ModelJob *job = (GstSscmaYolov5ModelJob *) data;
+  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (user_data);
+  const GstSscmaYolov5Shape *shape = &job->params.shape;
+  const ncnn::Mat *input = job->input;
+  ncnn::Mat in, out;
+
+  if (input == NULL && sscma_preprocess (job->image, &job->roi,
+          shape->input_width, shape->input_height, job->model->mean,
+          job->model->norm, in))
+    input = &in;
+
+  /* the extractor hands out float32, as the decoder of the model expects */
+  if (input && gst_sscma_yolov5_forward (job->model->net,
+          job->model->input_name, job->model->output_name, FALSE, *input,
+          out)) {
+    if (out.c == 1 && (gsize) out.w * out.h ==
+        (gsize) shape->n_anchors * (shape->n_classes + DETECTION_NUM_INFO))
+      gst_sscma_yolov5_decode (self, (const gfloat *) out.data, &job->params,
+          &job->roi, job->region, job->results);
+    else
+      GST_WARNING_OBJECT (self, "The output of model %u does not match its spec.",
+          shape->model_id);
+  }
 
-      //   res = gst_caps_can_intersect (template_caps, caps);
-      //   gst_caps_unref (template_caps);
-      // }
+  g_mutex_lock (&self->fanout_lock);
+  if (--self->fanout_pending == 0)
+    g_cond_signal (&self->fanout_cond);
+  g_mutex_unlock (&self->fanout_lock);
+}
 
-      // gst_query_set_accept_caps_result (query, res);
-      ret = gst_pad_query_default (pad, parent, query);
+/**
+ * @brief Load and warm up the models after the first one and start the
+ * worker pool they run on, going to PAUSED or when the model property
+ * changes while streaming, so the first frame does not pay for it.
+ */
+static void
+gst_sscma_yolov5_load_models (GstSscmaYolov5 * self, GPtrArray * models)
+{
+  ncnn::Mat in;
+  guint i, runs;
 
-    }
-    default:
-      ret = gst_pad_query_default (pad, parent, query);
-      break;
+  if (models == NULL)
+    return;
+  GST_OBJECT_LOCK (self);
+  runs = self->warmup;
+  GST_OBJECT_UNLOCK (self);
+  for (i = 0; i < models->len; i++) {
+    GstSscmaYolov5Model *model =
+        (GstSscmaYolov5Model *) g_ptr_array_index (models, i);
+
+    if (gst_sscma_yolov5_model_load (self, model, i + 1) &&
+        gst_sscma_yolov5_warmup_net (model->net, model->input_name,
+            model->output_name, FALSE, in, model->shape.input_width,
+            model->shape.input_height, runs) < runs)
+      g_print ("sscma_yolov5: The warm-up inference of %s failed, please check its input and output.\n",
+          model->bin);
   }
+  if (self->model_pool == NULL)
+    self->model_pool = g_thread_pool_new (gst_sscma_yolov5_model_job, self,
+        -1, FALSE, NULL);
+}
 
-  return ret;
+/**
+ * @brief Start the extra models on a region. Models of the same input size
+ * and normalisation share one preprocessed input.
+ */
+static void
+gst_sscma_yolov5_dispatch_models (GstSscmaYolov5 * self, GPtrArray * models,
+    GstSscmaYolov5ModelJob * jobs, GstSscmaYolov5Inputs * inputs,
+    const SscmaImage * image, const SscmaRect * roi, const SscmaRegion * region,
+    const GstSscmaYolov5FrameParams * params)
+{
+  guint i;
+
+  for (i = 0; i < models->len; i++) {
+    GstSscmaYolov5Model *model =
+        (GstSscmaYolov5Model *) g_ptr_array_index (models, i);
+    GstSscmaYolov5ModelJob *job = &jobs[i];
+
+    job->results = NULL;
+    if (!model->loaded)
+      continue;
+
+    job->model = model;
+    job->image = image;
+    job->roi = *roi;
+    job->region = region;
+    job->params = *params;
+    job->params.shape = model->shape;
+    if (model->conf_threshold > 0.f)
+      job->params.conf_threshold = model->conf_threshold;
+    /* the classes allow-list is made of the first model's labels */
+    job->params.filter_classes = FALSE;
+    job->input = gst_sscma_yolov5_inputs_get (inputs, image, roi,
+        model->shape.input_width, model->shape.input_height, model->mean,
+        model->norm);
+    job->results = g_array_new (FALSE, FALSE, sizeof (detectedObject));
+
+    g_mutex_lock (&self->fanout_lock);
+    self->fanout_pending++;
+    g_mutex_unlock (&self->fanout_lock);
+    g_thread_pool_push (self->model_pool, job, NULL);
+  }
 }
 
 /**
- * @brief This function handles src pad query.
+ * @brief Wait for the extra models of a region and merge their detections.
+ */
+static void
+gst_sscma_yolov5_collect_models (GstSscmaYolov5 * self,
+    GstSscmaYolov5ModelJob * jobs, guint n_jobs, GArray * results)
+{
+  guint i;
+
+  g_mutex_lock (&self->fanout_lock);
+  while (self->fanout_pending > 0)
+    g_cond_wait (&self->fanout_cond, &self->fanout_lock);
+  g_mutex_unlock (&self->fanout_lock);
+
+  for (i = 0; i < n_jobs; i++) {
+    if (jobs[i].results == NULL)
+      continue;
+    g_array_append_vals (results, jobs[i].results->data, jobs[i].results->len);
+    g_array_free (jobs[i].results, TRUE);
+    jobs[i].results = NULL;
+  }
+}
+
+/**
+ * @brief Check if a label index is in a snapshotted allow-list.
  */
+static inline gboolean
+gst_sscma_yolov5_class_allowed (const guint * allowed, guint n_allowed,
+    guint class_id)
+{
+  guint i;
+
+  for (i = 0; i < n_allowed; i++) {
+    if (allowed[i] == class_id)
+      return TRUE;
+  }
+  return FALSE;
+}
+
 static gboolean
-gst_sscma_yolov5_src_query (GstPad * pad, GstObject * parent,
-    GstQuery * query)
+gst_sscma_yolov5_secondary_expired (G_GNUC_UNUSED gpointer key,
+    gpointer value, gpointer user_data)
 {
-  GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
-  gboolean ret;
-  GST_DEBUG_OBJECT (self, "Received %s query: %" GST_PTR_FORMAT,
-      GST_QUERY_TYPE_NAME (query), query);
+  GstSscmaYolov5SecondaryResult *cached =
+      (GstSscmaYolov5SecondaryResult *) value;
 
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_CAPS:
-    {
-      GstCaps *caps;
-      GstCaps *filter;
+  return cached->seen + SECONDARY_CACHE_TTL < *(guint64 *) user_data;
+}
 
-      gst_query_parse_caps (query, &filter);
+/**
+ * @brief Run the secondary model on the crop of every selected detection.
+ * Tracked objects keep their result for secondary-interval frames, so each
+ * object is only classified again every few frames.
+ */
+static void
+gst_sscma_yolov5_classify (GstSscmaYolov5 * self, const SscmaImage * image,
+    const GstSscmaYolov5FrameParams * params, GArray * results)
+{
+  guint i;
 
-      caps = gst_caps_new_simple("video/x-raw",
-                                        "width", G_TYPE_INT, 320,
-                                        "height", G_TYPE_INT, 320,
-                                        "format", G_TYPE_STRING, "RGB",
-                                        NULL);
-      gst_query_set_caps_result (query, caps);
-      gst_caps_unref (caps);
-      ret = TRUE;
-      ret = gst_pad_query_default (pad, parent, query);
-      break;
+  if (self->classifier == NULL)
+    return;
+
+  for (i = 0; i < results->len; i++) {
+    detectedObject *a = &g_array_index (results, detectedObject, i);
+    GstSscmaYolov5SecondaryResult *cached = NULL;
+    SscmaRect crop = { a->x, a->y, a->width, a->height };
+    gint class_id;
+    gfloat prob;
+
+    /* the allow-list is made of the first model's labels */
+    if (params->secondary_filter_classes && (a->model_id != 0 ||
+            !gst_sscma_yolov5_class_allowed (params->secondary_allowed,
+                params->n_secondary_allowed, a->class_id)))
+      continue;
+
+    if (a->tracking_id >= 0) {
+      cached = (GstSscmaYolov5SecondaryResult *) g_hash_table_lookup (
+          self->secondary_cache, GINT_TO_POINTER (a->tracking_id));
+      if (cached) {
+        cached->seen = self->frame_count;
+        if (self->frame_count - cached->classified < self->secondary_interval) {
+          a->secondary_class_id = cached->class_id;
+          a->secondary_prob = cached->prob;
+          continue;
+        }
+      }
+    }
+
+    if (!sscma_classifier_classify (self->classifier, image, &crop, &class_id,
+            &prob))
+      continue;
+    a->secondary_class_id = class_id;
+    a->secondary_prob = prob;
+
+    if (a->tracking_id >= 0) {
+      if (cached == NULL) {
+        cached = g_new0 (GstSscmaYolov5SecondaryResult, 1);
+        g_hash_table_insert (self->secondary_cache,
+            GINT_TO_POINTER (a->tracking_id), cached);
+      }
+      cached->class_id = class_id;
+      cached->prob = prob;
+      cached->classified = cached->seen = self->frame_count;
     }
-    default:
-      ret = gst_pad_query_default (pad, parent, query);
-      break;
   }
 
-  return ret;
+  /* forget the tracks that are gone */
+  if (self->frame_count % SECONDARY_CACHE_TTL == 0)
+    g_hash_table_foreach_remove (self->secondary_cache,
+        gst_sscma_yolov5_secondary_expired, &self->frame_count);
 }
+
 /**
  * @brief Check input paramters for gst_tensor_filter_transform ();
  */
@@ -687,20 +3600,25 @@ gst_sscma_yolov5_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstSscmaYolov5 *self = GST_SWIFT_YOLOV5 (parent);
   GstSscmaYolov5Properties *prop = &self->prop;
-  GstBuffer *inbuf;
-  GstMapInfo src_info, dest_info;
-  GstTensorsInfo *info;
-  GstTensorInfo *_info;
-  gsize buf_size, frame_size, out_size, type;
-  guint color, width, height, max_index, cIdx_max;
-  gfloat *data, max_index_val;
+  GstVideoFrame frame;
+  gboolean mapped = FALSE;
+  SscmaImage image;
+  gsize buf_size, out_size;
   GArray *results = NULL;
+  GArray *regions = NULL;
+  guint n_regions;
+  GPtrArray *models = NULL;
+  GstSscmaYolov5Labels *labels = NULL, *secondary_labels = NULL;
+  GstSscmaYolov5ModelJob *jobs = NULL;
+  GstSscmaYolov5FrameParams params;
+  gboolean track, late;
+  gfloat conf_threshold;
+  guint64 stage_us[SSCMA_YOLOV5_STAGE_N] = { 0 };
+  gint64 start, t0, t1;
+  GstClockTime timestamp;
+  GQueue events = G_QUEUE_INIT;
   // UNUSED (pad);
 
-  ncnn::Mat in_pad;
-  ncnn::Mat out;
-  ncnn::Extractor ex = net.create_extractor();
-
   /* 0. validate input */
   buf_size = gst_buffer_get_size (buf);
   g_return_val_if_fail (buf_size > 0, GST_FLOW_ERROR);
@@ -710,112 +3628,267 @@ gst_sscma_yolov5_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   if (retval != GST_FLOW_OK)
     return retval;
 
+  /* scheduled threshold changes */
+  if (GST_BUFFER_PTS_IS_VALID (buf))
+    gst_object_sync_values (GST_OBJECT (self), GST_BUFFER_PTS (buf));
+  /* dwell times follow the stream, or the wall clock without timestamps */
+  timestamp = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      (GstClockTime) g_get_monotonic_time () * GST_USECOND;
+
+  start = g_get_monotonic_time ();
+  self->model_us = 0;
+  /* late for downstream, or kept within the latency budget */
+  late = gst_sscma_yolov5_is_late (self, buf) ||
+      gst_sscma_yolov5_over_budget (self, buf);
+  if (self->mode == SSCMA_YOLOV5_MODE_TENSOR) {
+    /* there are no detections to show again, drop it */
+    if (late) {
+      gst_buffer_unref (buf);
+      return GST_FLOW_OK;
+    }
+    GST_OBJECT_LOCK (self);
+    self->qos_processed++;
+    GST_OBJECT_UNLOCK (self);
+    return gst_sscma_yolov5_push_tensor (self, buf);
+  }
+  conf_threshold = self->conf_threshold;
+  track = self->track;
+  /* the tracker also looks at the less confident detections */
+  params.conf_threshold = track ? conf_threshold * self->track_low_ratio :
+      conf_threshold;
+  params.shape.model_id = 0;
+  params.shape.input_width = prop->input_meta.info[0].dimension[1];
+  params.shape.input_height = prop->input_meta.info[0].dimension[2];
+  params.shape.n_anchors = prop->output_meta.info[0].dimension[1];
+  if (self->sizes) {
+    /* picked by target-fps, the rows of the output follow the input size */
+    const GstSscmaYolov5InputSize *size = &g_array_index (self->sizes,
+        GstSscmaYolov5InputSize, self->size_index);
+
+    params.shape.input_width = size->width;
+    params.shape.input_height = size->height;
+    params.shape.n_anchors = size->n_anchors;
+  }
+  params.tile_size = self->tile_size;
+  params.tile_overlap = self->tile_overlap;
+  params.tile_activity_threshold = self->tile_activity_threshold;
+
+  GST_OBJECT_LOCK (self);
+  /* the decoder is specialized for the number of labels, the frame is drawn
+   * with the labels it was decoded for */
+  labels = gst_sscma_yolov5_labels_ref (prop->labels);
+  secondary_labels = gst_sscma_yolov5_labels_ref (self->secondary_labels);
+  params.shape.n_classes = gst_sscma_yolov5_labels_count (labels);
+  params.shape.decode = self->decode;
+  params.shape.scale = self->output_scale;
+  params.shape.zero_point = self->output_zero_point;
+  if (self->class_filter_dirty)
+    gst_sscma_yolov5_update_class_filter (self);
+  params.filter_classes = self->class_filter_active;
+  params.secondary_filter_classes = self->secondary_filter_active;
+  /* the copies live on the stack until the chain returns */
+  gst_sscma_yolov5_copy_filter (self->class_filter, params.allowed,
+      params.n_allowed);
+  gst_sscma_yolov5_copy_filter (self->secondary_filter,
+      params.secondary_allowed, params.n_secondary_allowed);
+  GST_OBJECT_UNLOCK (self);
+
   /* 2. preprocess data */
   // g_assert (self->tensors_configured);
-  info = &self->input_info;
-  color = info->info[0].dimension[0];
-  width = info->info[0].dimension[1];
-  height = info->info[0].dimension[2];
-  type = tensor_element_size[info->info[0].type];
-  /** type * colorspace * width * height */
-  frame_size = type * color * width * height;
-  /** supposed 1 frame in buffer */
-  g_assert ((buf_size / frame_size) == 1);
-
-  if (!gst_buffer_map (buf, &src_info, GST_MAP_READ)) {
-    g_print
-        ("tensor_converter: Cannot map src buffer at tensor_converter/video. The incoming buffer (GstBuffer) for the sinkpad of tensor_converter cannot be mapped for reading.\n");
-    goto error;
+
+  if (gst_pad_check_reconfigure (self->srcpad)) {
+    GstCaps *caps = gst_pad_get_current_caps (self->srcpad);
+    if (caps) {
+      gst_sscma_yolov5_decide_allocation (self, caps);
+      gst_caps_unref (caps);
+    }
   }
-  /* output size*/
-  out_size = tensor_element_size[prop->output_meta.info[0].type];
-  for(int i = 0; i <3; i++){
-    out_size *= prop->output_meta.info[0].dimension[i];
+
+  if (self->is_dmabuf) {
+    SscmaDmabufAccess access = { { NULL }, 0 };
+    GstBuffer *outbuf;
+
+    /* read the camera's dma-buf through a cached read-only mapping, and copy
+     * it into system memory, the boxes cannot be drawn on the dma-buf. The
+     * model preprocesses the copy, and frames only drawn on are copied too */
+    if (!sscma_dmabuf_cache_map_frame (self->dmabuf_cache, buf, &self->vinfo,
+            &image, &access)) {
+      g_print ("sscma_yolov5: Cannot import the incoming DMABuf frame.\n");
+      goto error;
+    }
+    outbuf = gst_sscma_yolov5_copy_dmabuf_frame (self, buf, &image);
+    sscma_dmabuf_cache_unmap_frame (&access);
+    if (outbuf == NULL) {
+      g_print ("sscma_yolov5: Cannot copy the incoming DMABuf frame to draw on it.\n");
+      goto error;
+    }
+    gst_buffer_unref (buf);
+    buf = outbuf;
+  } else {
+    /* the boxes are drawn on the frame that is pushed downstream */
+    buf = gst_sscma_yolov5_prepare_output_buffer (self, buf);
   }
 
-  inbuf = gst_buffer_new_and_alloc (out_size);
-  gst_buffer_memset (inbuf, 0, 0, out_size);
-  if (!gst_buffer_map (inbuf, &dest_info, GST_MAP_WRITE)) {
+  /* honours GstVideoMeta, so padded rows from upstream pools need no copy */
+  if (!gst_video_frame_map (&frame, &self->vinfo, buf, GST_MAP_READWRITE)) {
     g_print
-        ("tensor_converter: Cannot map dest buffer at tensor_converter/video. The outgoing buffer (GstBuffer) for the srcpad of tensor_converter cannot be mapped for writing.\n");
-    gst_buffer_unmap (buf, &src_info);
+        ("sscma_yolov5: Cannot map the incoming video frame for reading and writing.\n");
     goto error;
   }
-
-  /* 3. inference*/
-  for (uint i = 0; i < self->input_info.num_tensors; ++i) {
-    _info = gst_tensors_info_get_nth_info (info, i);
-    in_pad = ncnn::Mat::from_pixels_resize(src_info.data, ncnn::Mat::PIXEL_RGB, width, height, prop->input_meta.info[i].dimension[1], prop->input_meta.info[i].dimension[2]);
-    const float norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
-    in_pad.substract_mean_normalize(0, norm_vals);
-    ex.input("in0", in_pad);
-    ex.extract("out0", out);
-    g_assert (out.total() * out.elemsize == out_size);
-    memcpy (dest_info.data, out.data, out_size);
+  mapped = TRUE;
+  sscma_image_from_video_frame (&image, &frame);
+  /* not inferred, show the last detections again */
+  if (late) {
+    GST_OBJECT_LOCK (self);
+    models = self->extra_models ? g_ptr_array_ref (self->extra_models) : NULL;
+    GST_OBJECT_UNLOCK (self);
+    results = g_array_sized_new (FALSE, FALSE, sizeof (detectedObject),
+        self->last_results->len);
+    g_array_append_vals (results, self->last_results->data,
+        self->last_results->len);
+    t1 = g_get_monotonic_time ();
+    goto draw;
   }
+  /* the regions of the frame the model looks at, the whole frame by default */
+  GST_OBJECT_LOCK (self);
+  regions = self->regions ? g_array_ref (self->regions) : NULL;
+  GST_OBJECT_UNLOCK (self);
+  n_regions = regions ? regions->len : 1;
+
+  /* the other detectors of the model property */
+  GST_OBJECT_LOCK (self);
+  models = self->extra_models ? g_ptr_array_ref (self->extra_models) : NULL;
+  GST_OBJECT_UNLOCK (self);
+  /* loaded with the pool going to PAUSED or when they were set */
+  if (models && self->model_pool)
+    jobs = g_new0 (GstSscmaYolov5ModelJob, models->len);
+
+  /* output size*/
+  out_size = tensor_element_size[prop->output_meta.info[0].type] *
+      prop->output_meta.info[0].dimension[0] * params.shape.n_anchors *
+      prop->output_meta.info[0].dimension[2];
 
-  /* 4. Post-processing of the data*/
-  cIdx_max = prop->total_labels + DETECTION_NUM_INFO;
   results = g_array_sized_new (FALSE, TRUE, sizeof (detectedObject), prop->output_meta.info[0].dimension[2]);
-  data = (float *)dest_info.data;
-  for (int delect_num = 0; delect_num < prop->output_meta.info[0].dimension[1]; delect_num++) {
-    max_index_val = 0;
-    max_index = 0;
-    // Find the class with the maximum confidence
-    // todo: 可配置阈值
-    for (int i = DETECTION_NUM_INFO; i < prop->total_labels; ++i) {
-      if (data[delect_num * cIdx_max + i] > max_index_val) {
-        max_index_val = data[delect_num * cIdx_max + i];
-        max_index = i;
-      }
-    }
+  t0 = g_get_monotonic_time ();
+  for (guint r = 0; r < n_regions; r++) {
+    const SscmaRegion *region =
+        regions ? &g_array_index (regions, SscmaRegion, r) : NULL;
+    SscmaRect roi = { 0, 0, image.width, image.height };
+    GstSscmaYolov5Inputs inputs;
+    const ncnn::Mat *input = NULL;
+    gboolean ok;
+
+    if (region && !sscma_region_get_bounds (region, image.width, image.height,
+            &roi))
+      continue;
 
-    // If the maximum confidence is greater than the threshold, then the result is valid
-    // TODO ：可配置阈值
-    if (max_index_val * data[delect_num * cIdx_max + 4] > 2500) {
-      detectedObject object;
-      float cx, cy, w, h;
-      cx = data[delect_num * cIdx_max + 0];
-      cy = data[delect_num * cIdx_max + 1];
-      w = data[delect_num * cIdx_max + 2];
-      h = data[delect_num * cIdx_max + 3];
-
-      // todo:可配置是否归一化
-      // if (!is_output_scaled) {
-      //   cx *= (float) width;
-      //   cy *= (float) height;
-      //   w *= (float) width;
-      //   h *= (float) height;
-      // }
-
-      object.x = (int) (MAX (0.f, (cx - w / 2.f)));
-      object.y = (int) (MAX (0.f, (cy - h / 2.f)));
-      object.width = (int) (MIN ((float) width, w));
-      object.height = (int) (MIN ((float) height, h));
-
-      object.prob = max_index_val * data[delect_num * cIdx_max + 4];
-      object.class_id = max_index - DETECTION_NUM_INFO;
-      object.tracking_id = int(max_index_val);
-      object.valid = TRUE;
-      g_array_append_val (results, object);
+    /* the extra models run next to the first one, sharing its input */
+    inputs.n = 0;
+    if (jobs) {
+      if (gst_sscma_yolov5_whole_region_pass (&params, &roi))
+        input = gst_sscma_yolov5_inputs_get (&inputs, &image, &roi,
+            params.shape.input_width, params.shape.input_height,
+            self->mean_vals, self->norm_vals);
+      gst_sscma_yolov5_dispatch_models (self, models, jobs, &inputs, &image,
+          &roi, region, &params);
     }
+
+    /* 3. inference and 4. post-processing of the data */
+    ok = gst_sscma_yolov5_detect_region (self, &image, &roi, region, &params,
+        input, out_size, results);
+    if (jobs)
+      gst_sscma_yolov5_collect_models (self, jobs, models->len, results);
+    if (!ok)
+      goto error;
+  }
+  if (regions)
+    g_array_unref (regions);
+  regions = NULL;
+
+  t1 = g_get_monotonic_time ();
+  stage_us[SSCMA_YOLOV5_STAGE_INFERENCE] = t1 - t0;
+
+  /* boxes found in overlapping regions or by the other models are merged here as well */
+  nms (results, self->iou_threshold, self->max_detections);
+  t0 = g_get_monotonic_time ();
+  stage_us[SSCMA_YOLOV5_STAGE_NMS] = t0 - t1;
+
+  /* 4-1. persistent ids, low score boxes only survive by continuing a track */
+  if (track) {
+    sscma_tracker_update (self->tracker, results, conf_threshold,
+        self->track_max_age);
+    t1 = g_get_monotonic_time ();
+    stage_us[SSCMA_YOLOV5_STAGE_TRACKER] = t1 - t0;
+    t0 = t1;
   }
-  /* clear inbuf */
-  gst_buffer_unmap (inbuf, &dest_info);
-  gst_buffer_unref (inbuf);
-  // todo: 可配置阈值
-  nms (results, 0.25);
 
+  /* 4-2. second stage on the crops of the surviving boxes */
+  gst_sscma_yolov5_classify (self, &image, &params, results);
+  t1 = g_get_monotonic_time ();
+  stage_us[SSCMA_YOLOV5_STAGE_SECONDARY] = t1 - t0;
+
+  /* 4-3. line crossings and zones, posted once the lock is released */
+  GST_OBJECT_LOCK (self);
+  if (sscma_analytics_is_active (self->analytics))
+    sscma_analytics_update (self->analytics, results, image.width,
+        image.height, timestamp, &events);
+  GST_OBJECT_UNLOCK (self);
+  while (!g_queue_is_empty (&events))
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self),
+            (GstStructure *) g_queue_pop_head (&events)));
+  g_array_set_size (self->last_results, 0);
+  g_array_append_vals (self->last_results, results->data, results->len);
+
+draw:
   /* 5. draw box */
-  // TODO：支持多个输出格式 主要是RGB RGBA
-  draw (&src_info, self, results);
+  if (mapped)
+    draw (&frame, self, models, labels, secondary_labels, results);
   g_array_free (results, TRUE);
-  
-  gst_buffer_unmap (buf, &src_info);
+  if (models)
+    g_ptr_array_unref (models);
+  gst_sscma_yolov5_labels_unref (labels);
+  gst_sscma_yolov5_labels_unref (secondary_labels);
+  g_free (jobs);
+  stage_us[SSCMA_YOLOV5_STAGE_DRAW] = g_get_monotonic_time () - t1;
+
+  GST_OBJECT_LOCK (self);
+  /* the stats describe the last frame that went through the model */
+  if (!late) {
+    memcpy (self->stage_us, stage_us, sizeof (stage_us));
+    self->n_tracks = track ? sscma_tracker_get_n_tracks (self->tracker) : 0;
+    self->qos_processed++;
+  }
+  self->frame_count++;
+  GST_OBJECT_UNLOCK (self);
+  /* the next frame may run at another input size */
+  if (!late)
+    gst_sscma_yolov5_adapt_input_size (self);
+  GST_LOG_OBJECT (self, "inference %" G_GUINT64_FORMAT "us, nms %"
+      G_GUINT64_FORMAT "us, tracker %" G_GUINT64_FORMAT "us, secondary %"
+      G_GUINT64_FORMAT "us, draw %" G_GUINT64_FORMAT "us",
+      stage_us[SSCMA_YOLOV5_STAGE_INFERENCE], stage_us[SSCMA_YOLOV5_STAGE_NMS],
+      stage_us[SSCMA_YOLOV5_STAGE_TRACKER],
+      stage_us[SSCMA_YOLOV5_STAGE_SECONDARY], stage_us[SSCMA_YOLOV5_STAGE_DRAW]);
+
+  if (mapped)
+    gst_video_frame_unmap (&frame);
+  if (!late)
+    gst_sscma_yolov5_update_latency (self,
+        (g_get_monotonic_time () - start) * GST_USECOND);
   return gst_pad_push (self->srcpad, buf);
 error:
-  if (inbuf)
-    gst_buffer_unref (inbuf);
+  if (mapped)
+    gst_video_frame_unmap (&frame);
+  if (regions)
+    g_array_unref (regions);
+  if (results)
+    g_array_free (results, TRUE);
+  if (models)
+    g_ptr_array_unref (models);
+  gst_sscma_yolov5_labels_unref (labels);
+  gst_sscma_yolov5_labels_unref (secondary_labels);
+  g_free (jobs);
   gst_buffer_unref (buf);
   return GST_FLOW_ERROR;
 }
@@ -884,6 +3957,16 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
       info->info[0].type = _TENOR_UINT8;
       info->info[0].dimension[0] = 3;
       break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+      /* converted to RGB while scaling to the model input */
+      info->info[0].type = _TENOR_UINT8;
+      info->info[0].dimension[0] = 3;
+      break;
     case GST_VIDEO_FORMAT_RGBx:
     case GST_VIDEO_FORMAT_BGRx:
     case GST_VIDEO_FORMAT_xRGB:
@@ -897,7 +3980,7 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
       break;
     default:
       GST_WARNING_OBJECT (self,
-          "The given video caps with format \"%s\" is not supported. Please use GRAY8, GRAY16_LE, GRAY16_BE, RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, or ABGR.\n",
+          "The given video caps with format \"%s\" is not supported. Please use GRAY8, GRAY16_LE, GRAY16_BE, RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR, NV12, NV21, I420, YV12, YUY2 or UYVY.\n",
           GST_STR_NULL (gst_video_format_to_string (format)));
       break;
   }
@@ -912,6 +3995,7 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
 
   self->rate_n = GST_VIDEO_INFO_FPS_N (&vinfo);
   self->rate_d = GST_VIDEO_INFO_FPS_D (&vinfo);
+  self->vinfo = vinfo;
 
   /**
    * @todo The actual list is much longer, fill them.
@@ -921,7 +4005,6 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
     case GST_VIDEO_FORMAT_GRAY8:
     case GST_VIDEO_FORMAT_RGB:
     case GST_VIDEO_FORMAT_BGR:
-    case GST_VIDEO_FORMAT_I420:
       if (width % 4) {
         GST_ERROR_OBJECT (self,
           "\nYOUR STREAM INFOURATION INCURS PERFORMANCE DETERIORATION!\n"
@@ -937,32 +4020,110 @@ gst_sscma_yolov5_parse_video (GstSscmaYolov5 * self,
   return (info->info[0].type != _TENOR_END);
 }
 
+/**
+ * @brief Get the caps the element can handle on a pad, whatever its peers.
+ * Frames go through unchanged, in any format the preprocessing reads. The
+ * sink also takes dma-bufs, which are copied into system memory to draw on,
+ * so the src only pushes system memory. In tensor mode the sink also takes
+ * preprocessed tensors matching the input property (C:W:H or W:H:C) and the
+ * src pushes the model output.
+ */
+static GstCaps *
+gst_sscma_yolov5_get_media_caps (GstSscmaYolov5 * self, GstPad * pad)
+{
+  const guint32 *dim = self->prop.input_meta.info[0].dimension;
+  GstTensorsInfo info;
+  GstCaps *caps, *tensor_caps;
+
+  if (self->mode == SSCMA_YOLOV5_MODE_TENSOR && pad == self->srcpad) {
+    caps = gst_tensors_info_get_caps (&self->prop.output_meta, self->rate_n,
+        self->rate_d);
+    return caps ? caps : gst_caps_new_empty ();
+  }
+
+  caps = gst_caps_new_empty ();
+  append_video_caps_template (caps);
+  if (pad == self->sinkpad)
+    gst_caps_append (caps, gst_caps_from_string (DMABUF_CAPS_STR));
+  if (self->mode != SSCMA_YOLOV5_MODE_TENSOR)
+    return caps;
+
+  /* the same checks as gst_sscma_yolov5_parse_tensors () */
+  gst_tensors_info_init (&info);
+  info.num_tensors = 1;
+  info.info[0].type = _TENOR_FLOAT32;
+  memcpy (info.info[0].dimension, dim, sizeof (tensor_dim));
+  tensor_caps = gst_tensors_info_get_caps (&info, 0, 0);
+  if (tensor_caps)
+    gst_caps_append (caps, tensor_caps);
+  info.info[0].dimension[0] = dim[1];
+  info.info[0].dimension[1] = dim[2];
+  info.info[0].dimension[2] = dim[0];
+  tensor_caps = gst_tensors_info_get_caps (&info, 0, 0);
+  if (tensor_caps)
+    gst_caps_append (caps, tensor_caps);
+  return caps;
+}
+
+/**
+ * @brief Turn caps of the other pad into caps of this one: upstream may send
+ * dma-bufs for any system memory caps downstream takes, downstream gets them
+ * in system memory.
+ */
+static GstCaps *
+gst_sscma_yolov5_transform_memory (GstSscmaYolov5 * self, GstPad * pad,
+    GstCaps * caps)
+{
+  GstCaps *result = gst_caps_copy (caps);
+  guint i, n = gst_caps_get_size (caps);
+
+  if (pad == self->srcpad) {
+    gst_caps_set_features_simple (result, NULL);
+    return gst_caps_simplify (result);
+  }
+  for (i = 0; i < n; i++) {
+    if (!gst_caps_features_is_equal (gst_caps_get_features (caps, i),
+            GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY))
+      continue;
+    gst_caps_append_structure_full (result,
+        gst_structure_copy (gst_caps_get_structure (caps, i)),
+        gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_DMABUF, NULL));
+  }
+  return result;
+}
+
 /**
  * @brief Get pad caps for caps negotiation.
+ * Frames pass through, so outside tensor mode the other side's peer narrows
+ * the caps: upstream can produce straight away what downstream takes, with
+ * no videoconvert or videoscale in between.
  */
 static GstCaps *
 gst_sscma_yolov5_query_caps (GstSscmaYolov5 * self, GstPad * pad,
     GstCaps * filter)
 {
-  GstCaps *caps;
+  GstPad *otherpad = (pad == self->srcpad) ? self->sinkpad : self->srcpad;
+  GstCaps *caps, *peer_caps;
 
-  caps = gst_pad_get_current_caps (pad);
-  if (!caps) {
-    caps = gst_pad_get_pad_template_caps (pad);
-  }
+  /* not the current caps, upstream may switch to another size */
+  caps = gst_sscma_yolov5_get_media_caps (self, pad);
+
+  if (self->mode != SSCMA_YOLOV5_MODE_TENSOR) {
+    GstCaps *peer_filter = filter ?
+        gst_sscma_yolov5_transform_memory (self, otherpad, filter) : NULL;
 
-  if (pad == self->sinkpad) {
-    GstCaps *media_caps;
+    peer_caps = gst_pad_peer_query_caps (otherpad, peer_filter);
+    if (peer_filter)
+      gst_caps_unref (peer_filter);
+    if (peer_caps) {
+      GstCaps *tmp = gst_sscma_yolov5_transform_memory (self, pad, peer_caps);
 
-    // media_caps = gst_sscma_yolov5_get_possible_media_caps (self);
-    if (media_caps) {
-      /* intersect with pad caps */
-      GstCaps *tmp = gst_caps_intersect_full (media_caps, caps,
-          GST_CAPS_INTERSECT_FIRST);
+      gst_caps_unref (peer_caps);
+      peer_caps = tmp;
+      tmp = gst_caps_intersect_full (peer_caps, caps, GST_CAPS_INTERSECT_FIRST);
       gst_caps_unref (caps);
+      gst_caps_unref (peer_caps);
       caps = tmp;
-
-      gst_caps_unref (media_caps);
     }
   }
 
@@ -977,6 +4138,60 @@ gst_sscma_yolov5_query_caps (GstSscmaYolov5 * self, GstPad * pad,
   return caps;
 }
 
+/**
+ * @brief Check other/tensors sink caps against the input property.
+ * The tensor must be normalized float32, either interleaved like the input
+ * property (C:W:H, e.g. from tensor_converter) or planar (W:H:C) as ncnn
+ * takes it. There are no frames to draw on, so this needs mode=tensor.
+ */
+static gboolean
+gst_sscma_yolov5_parse_tensors (GstSscmaYolov5 * self, const GstCaps * caps)
+{
+  const guint32 *dim = self->prop.input_meta.info[0].dimension;
+  GstTensorsInfo info, expected;
+
+  if (self->mode != SSCMA_YOLOV5_MODE_TENSOR) {
+    GST_ERROR_OBJECT (self,
+        "other/tensors input has no frames to draw on, please set mode=tensor.");
+    return FALSE;
+  }
+  if (!gst_tensors_info_from_caps (&info, caps) ||
+      !gst_tensors_info_validate (&info)) {
+    GST_ERROR_OBJECT (self, "Failed to get static tensors info from %"
+        GST_PTR_FORMAT, caps);
+    gst_tensors_info_free (&info);
+    return FALSE;
+  }
+
+  gst_tensors_info_init (&expected);
+  expected.num_tensors = 1;
+  expected.info[0].type = _TENOR_FLOAT32;
+  self->tensor_planar = (info.info[0].dimension[0] != dim[0]);
+  if (self->tensor_planar) {
+    expected.info[0].dimension[0] = dim[1];
+    expected.info[0].dimension[1] = dim[2];
+    expected.info[0].dimension[2] = dim[0];
+  } else {
+    memcpy (expected.info[0].dimension, dim, sizeof (tensor_dim));
+  }
+
+  if (!gst_tensors_info_is_equal (&info, &expected)) {
+    GST_ERROR_OBJECT (self,
+        "The incoming tensors %" GST_PTR_FORMAT " do not match the input property, expected a float32 %u:%u:%u or %u:%u:%u tensor.",
+        caps, dim[0], dim[1], dim[2], dim[1], dim[2], dim[0]);
+    gst_tensors_info_free (&info);
+    return FALSE;
+  }
+
+  if (!gst_structure_get_fraction (gst_caps_get_structure (caps, 0),
+          "framerate", &self->rate_n, &self->rate_d)) {
+    self->rate_n = 0;
+    self->rate_d = 1;
+  }
+  self->input_info = info;
+  return TRUE;
+}
+
 /**
  * @brief Parse caps and set tensors info.
  */
@@ -987,6 +4202,8 @@ gst_sscma_yolov5_parse_caps (GstSscmaYolov5 * self,
   GstStructure *structure;
   GstTensorsInfo info;
   const gchar *name;
+  GstVideoFormat format = GST_VIDEO_INFO_FORMAT (&self->vinfo);
+  gboolean is_dmabuf;
 
   gint frames_dim = -1; /** dimension index of frames in infoured tensors */
 
@@ -998,9 +4215,21 @@ gst_sscma_yolov5_parse_caps (GstSscmaYolov5 * self,
   name = gst_structure_get_name (structure);
   g_return_val_if_fail (name != NULL, FALSE);
 
+  is_dmabuf = gst_caps_features_contains (gst_caps_get_features (caps, 0),
+      GST_CAPS_FEATURE_MEMORY_DMABUF);
+  /* cached mappings belong to the previous stream's buffers */
+  if (is_dmabuf || self->is_dmabuf)
+    sscma_dmabuf_cache_clear (self->dmabuf_cache);
+  self->is_dmabuf = is_dmabuf;
+
+  /* preprocessed upstream, e.g. by tensor_converter and tensor_transform */
+  self->is_tensor = g_str_equal (name, NNS_MIMETYPE_TENSORS);
+  if (self->is_tensor)
+    return gst_sscma_yolov5_parse_tensors (self, caps);
+
   if (!g_str_has_prefix (name, "video/")) {
     GST_ERROR_OBJECT (self,
-        "Failed to configure tensor: sink must be video stream.");
+        "Failed to configure tensor: sink must be video stream or other/tensors.");
     return FALSE;
   }
 
@@ -1023,22 +4252,34 @@ gst_sscma_yolov5_parse_caps (GstSscmaYolov5 * self,
   }
   // self->tensors_configured = TRUE;
   self->input_info = info;
+
+  /* a size change keeps the overlay, it only depends on the format */
+  if (self->sink_caps && format == GST_VIDEO_INFO_FORMAT (&self->vinfo))
+    return TRUE;
+  if (!sscma_overlay_set_format (self->overlay,
+          GST_VIDEO_INFO_FORMAT (&self->vinfo)))
+    GST_WARNING_OBJECT (self, "Boxes cannot be drawn on %s frames.",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&self->vinfo)));
   return TRUE;
 }
 
 /**
- * @brief Update src pad caps from tensors config.
+ * @brief Update src pad caps from tensors config (mode=tensor).
  */
 static gboolean
 gst_sscma_yolov5_update_caps (GstSscmaYolov5 * self)
 {
-  GstTensorsInfo *info;
   GstCaps *curr_caps, *out_caps;
-  gboolean ret = FALSE;
+  gboolean ret = TRUE;
 
-  info = &self->input_info;
-  // out cap is ANY
-  out_caps = gst_caps_new_any ();
+  /* the raw model output as described by the output and outputtype properties */
+  out_caps = gst_tensors_info_get_caps (&self->prop.output_meta, self->rate_n,
+      self->rate_d);
+  if (out_caps == NULL) {
+    GST_ERROR_OBJECT (self,
+        "Cannot output tensors, please check the output and outputtype properties.");
+    return FALSE;
+  }
 
   /* Update src pad caps if it is different. */
   curr_caps = gst_pad_get_current_caps (self->srcpad);
@@ -1076,23 +4317,29 @@ iou (detectedObject * a, detectedObject * b)
   int y1 = MAX (a->y, b->y);
   int x2 = MIN (a->x + a->width, b->x + b->width);
   int y2 = MIN (a->y + a->height, b->y + b->height);
-  int w = MAX (0, (x2 - x1 + 1));
-  int h = MAX (0, (y2 - y1 + 1));
+  int w = MAX (0, (x2 - x1));
+  int h = MAX (0, (y2 - y1));
   float inter = w * h;
   float areaA = a->width * a->height;
   float areaB = b->width * b->height;
-  float o = inter / (areaA + areaB - inter);
+  float uni = areaA + areaB - inter;
+  float o;
+
+  if (uni <= 0.f)
+    return 0;
+  o = inter / uni;
   return (o >= 0) ? o : 0;
 }
 
 /**
  * @brief Apply NMS to the given results (objects[MOBILENET_SSD_DETECTION_MAX])
  * @param[in/out] results The results to be filtered with nms
+ * @param[in] max_detections Keep at most this many boxes (best first), 0 for all
  */
 static void
-nms (GArray * results, gfloat threshold)
+nms (GArray * results, gfloat threshold, guint max_detections)
 {
-  guint boxes_size;
+  guint boxes_size, kept = 0;
   guint i, j;
 
   boxes_size = results->len;
@@ -1104,9 +4351,16 @@ nms (GArray * results, gfloat threshold)
   for (i = 0; i < boxes_size; i++) {
     detectedObject *a = &g_array_index (results, detectedObject, i);
     if (a->valid == TRUE) {
+      /* the rest score lower than everything kept, no need to compare them */
+      if (max_detections && kept == max_detections) {
+        a->valid = FALSE;
+        continue;
+      }
+      kept++;
       for (j = i + 1; j < boxes_size; j++) {
         detectedObject *b = &g_array_index (results, detectedObject, j);
-        if (b->valid == TRUE) {
+        /* detectors only suppress their own boxes */
+        if (b->valid == TRUE && b->model_id == a->model_id) {
           if (iou (a, b) > threshold) {
             b->valid = FALSE;
           }
@@ -1115,104 +4369,85 @@ nms (GArray * results, gfloat threshold)
     }
   }
 
-  i = 0;
-  do {
+  /* compact the surviving boxes in place, keeping the score order */
+  for (i = 0, j = 0; i < boxes_size; i++) {
     detectedObject *a = &g_array_index (results, detectedObject, i);
     if (a->valid == FALSE)
-      g_array_remove_index (results, i);
-    else
-      i++;
-  } while (i < results->len);
-
+      continue;
+    if (i != j)
+      g_array_index (results, detectedObject, j) = *a;
+    j++;
+  }
+  g_array_set_size (results, j);
 }
 
 /**
  * @brief Draw with the given results (objects[MOBILENET_SSD_DETECTION_MAX]) to the output buffer
- * @param[out] out_info The output buffer (RGBA plain)
- * @param[in] prop The bounding-box internal data.
+ * @param[out] frame The mapped output frame
+ * @param[in] labels The labels of the first model the frame was decoded with.
+ * @param[in] secondary_labels The labels of the secondary model.
  * @param[in] results The final results to be drawn.
  */
 static void
-draw (GstMapInfo * out_info, GstSscmaYolov5 *self, GArray * results)
+draw (GstVideoFrame * frame, GstSscmaYolov5 *self, GPtrArray * models,
+    const GstSscmaYolov5Labels * labels,
+    const GstSscmaYolov5Labels * secondary_labels, GArray * results)
 {
-  GstSscmaYolov5Properties *prop = &self->prop;
-  uint8_t *frame = (uint8_t *) out_info->data;        /* Let's draw per pixel (4bytes) */
   unsigned int i;
-  guint color = self->input_info.info[0].dimension[0];
-  guint width = self->input_info.info[0].dimension[1];
-  guint height = self->input_info.info[0].dimension[2];
-  guint widthi = prop->input_meta.info[0].dimension[1];
-  guint heighti = prop->input_meta.info[0].dimension[2];
-  
+  gint height = GST_VIDEO_FRAME_HEIGHT (frame);
+  /* 2px at 480p, 4px at 1080p */
+  gint thickness = MAX (2, height / 270);
+  /* 13px glyphs at 720p, twice that at 1080p and four times at 4K */
+  gint scale = self->font_scale ? self->font_scale : MAX (1, height / 540);
+
   for (i = 0; i < results->len; i++) {
-    int x1, x2, y1, y2;         /* Box positions on the output surface */
-    int j;
-    uint8_t *pos1, *pos2;
+    SscmaRect box;
+    gint label_y;
     detectedObject *a = &g_array_index (results, detectedObject, i);
+    const GstSscmaYolov5Labels *model_labels = labels;
+    guint color;
+
+    /* labels of the other detectors of the model property */
+    if (a->model_id > 0) {
+      GstSscmaYolov5Model *model = models && (guint) a->model_id <= models->len ?
+          (GstSscmaYolov5Model *) g_ptr_array_index (models, a->model_id - 1) :
+          NULL;
+      model_labels = model ? model->labels : NULL;
+    }
+    /* each detector in its own colours */
+    color = a->class_id + a->model_id * 7;
 
+    /* drawing the other detectors needs their labels */
+    if (model_labels == NULL)
+      continue;
     if ((a->class_id < 0 ||
-                a->class_id >= (int) prop->total_labels)) {
+                a->class_id >= (int) model_labels->total)) {
       /** @todo make it "logw_once" after we get logw_once API. */
       g_print ("Invalid class found with tensordec-boundingbox.c.\n");
       continue;
     }
 
-    /* 1. Draw Boxes */
-    x1 =  a->x * width / widthi;
-    x2 = MIN (width - 1, (a->x + a->width)) * width / widthi;
-    y1 = a->y * height / heighti;
-    y2 = MIN (height - 1,(a->y + a->height)) * height / heighti;
-    /* 1-1. Horizontal */
-    pos1 = &frame[(y1 * width + x1) * 3];
-    pos2 = &frame[(y2 * width + x1) * 3];
-    for (j = x1; j <= x2; j++) {
-      *pos1 = PIXEL_VALUE;
-      *pos2 = PIXEL_VALUE;
-      pos1 += 3;
-      pos2 += 3;
-    }
-
-    /* 1-2. Vertical */
-    pos1 = &frame[((y1 + 1) * width + x1) * 3];
-    pos2 = &frame[((y1 + 1) * width + x2) * 3];
-    for (j = y1 + 1; j < y2; j++) {
-      *pos1 = PIXEL_VALUE;
-      *pos2 = PIXEL_VALUE;
-      pos1 += width * 3;
-      pos2 += width * 3;
-    }
-
-    /* 2. Write Labels + tracking ID */
-    g_autofree gchar *label = NULL;
-    gsize label_len;
-    label = g_strdup_printf ("%s %d", prop->labels[a->class_id],
-            a->tracking_id);
-    label_len = strlen (label);
-    /* x1 is the same: x1 = MAX (0, (width * a->x) / bdata->i_width); */
-    y1 = MAX (0, (y1 - 14));
-    pos1 = &frame[(y1 * width + x1) * 3];
-    for (guint j = 0; j < label_len; j++) {
-      unsigned int char_index = label[j];
-      if (char_index < 32 || char_index >= 127) {
-        /* It's not ASCII */
-        char_index = '*';
-      }
-      char_index -= 32;
-      if ((x1 + 8) > (int) width)
-        break;                /* Stop drawing if it may overfill */
-      pos2 = pos1;
-      for (y2 = 0; y2 < 13; y2++) {
-        /* 13 : character height */
-        for (x2 = 0; x2 < 8; x2++) {
-          /* 8: character width */
-          *(pos2 + x2 * 3) = rasters[char_index][13-y2] & (1 << (7 - x2)) ?
-              PIXEL_VALUE : 0;
-        }
-        pos2 += width * 3;
-      }
-      x1 += 9;
-      pos1 += 9 * 3;              /* charater width + 1px */
-    }
+    /* 1. Draw Boxes (already in frame pixels, the overlay clips them) */
+    box.x = a->x;
+    box.y = a->y;
+    box.width = a->width;
+    box.height = a->height;
+    sscma_overlay_draw_box (self->overlay, frame, &box, color, thickness);
+
+    /* 2. Write Labels + tracking ID, above the box or inside if there is no room */
+    label_y = box.y - sscma_overlay_label_height (scale);
+    if (label_y < 0)
+      label_y = MAX (box.y, 0);
+    sscma_overlay_draw_label (self->overlay, frame, MAX (box.x, 0), label_y,
+        model_labels->strips[a->class_id], a->tracking_id, color, scale);
+
+    /* 3. Secondary class right under the label */
+    if (secondary_labels && a->secondary_class_id >= 0 &&
+        a->secondary_class_id < (int) secondary_labels->total)
+      sscma_overlay_draw_label (self->overlay, frame, MAX (box.x, 0),
+          label_y + sscma_overlay_label_height (scale),
+          secondary_labels->strips[a->secondary_class_id], -1,
+          color, scale);
   }
 }
 /* entry point to initialize the plug-in
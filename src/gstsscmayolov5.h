@@ -49,8 +49,16 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
-#include <gst/video/video-info.h>
+#include <gst/video/video.h>
 #include "tensor_info.h"
+#include "dmabuf_import.h"
+#include "overlay.h"
+#include "region.h"
+#include "classifier.h"
+#include "tracker.h"
+#include "analytics.h"
+#include "config.h"
+#include "decoder.h"
 #include <net.h>
 
 G_BEGIN_DECLS
@@ -78,15 +86,54 @@ G_BEGIN_DECLS
 /**
  * @brief Caps string for supported video format
  */
+#define VIDEO_FORMATS_STR \
+    "{ RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR, GRAY8, GRAY16_BE, GRAY16_LE, NV12, NV21, I420, YV12, YUY2, UYVY }"
+
 #define VIDEO_CAPS_STR \
-    GST_VIDEO_CAPS_MAKE ("{ RGB, BGR, RGBx, BGRx, xRGB, xBGR, RGBA, BGRA, ARGB, ABGR, GRAY8, GRAY16_BE, GRAY16_LE }") \
+    GST_VIDEO_CAPS_MAKE (VIDEO_FORMATS_STR) \
+    ", interlace-mode = (string) progressive"
+
+/**
+ * @brief Caps string for dma-buf frames on the sink, mapped read-only by
+ * dmabuf_import.cc and copied into system memory to draw on
+ */
+#define DMABUF_CAPS_STR \
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES (GST_CAPS_FEATURE_MEMORY_DMABUF, \
+        VIDEO_FORMATS_STR) \
     ", interlace-mode = (string) progressive"
 
 #define append_video_caps_template(caps) \
     gst_caps_append (caps, gst_caps_from_string (VIDEO_CAPS_STR))
 
+/**
+ * @brief Row stride alignment (as a GstVideoAlignment mask) proposed upstream,
+ * so the preprocessing loads whole SIMD vectors (32 bytes covers NEON and AVX2).
+ */
+#define SSCMA_YOLOV5_STRIDE_ALIGN (31)
+
 #define DETECTION_NUM_INFO 5
-#define PIXEL_VALUE                             (0xFF) 
+
+/**
+ * @brief Processing stages timed per frame (see the "stats" property).
+ */
+typedef enum
+{
+  SSCMA_YOLOV5_STAGE_INFERENCE = 0, /**< preprocessing, model and decoding */
+  SSCMA_YOLOV5_STAGE_NMS,
+  SSCMA_YOLOV5_STAGE_TRACKER,
+  SSCMA_YOLOV5_STAGE_SECONDARY,
+  SSCMA_YOLOV5_STAGE_DRAW,
+  SSCMA_YOLOV5_STAGE_N
+} SscmaYolov5Stage;
+
+/**
+ * @brief What is pushed downstream (see the "mode" property).
+ */
+typedef enum
+{
+  SSCMA_YOLOV5_MODE_VIDEO = 0, /**< the frames, with the detections drawn on them */
+  SSCMA_YOLOV5_MODE_TENSOR, /**< the raw model output as other/tensors */
+} SscmaYolov5Mode;
 
 /** @brief Represents a detect object */
 typedef struct
@@ -99,9 +146,75 @@ typedef struct
   int height;
   gfloat prob;
 
+  int model_id; /**< index of the detector in the model property, 0 for the first */
   int tracking_id;
+  int secondary_class_id; /**< class from the secondary model, -1 if not classified */
+  gfloat secondary_prob; /**< score of secondary_class_id */
 } detectedObject;
 
+/**
+ * @brief Shape of a YOLOv5 model, all that decoding its output needs.
+ */
+typedef struct
+{
+  guint model_id; /**< index of the model in the model property */
+  gint input_width; /**< model input width */
+  gint input_height; /**< model input height */
+  guint n_anchors; /**< output rows */
+  guint n_classes; /**< class scores after the box and objectness of a row */
+  SscmaDecodeFunc decode; /**< decoder specialized for the layout, type and n_classes */
+  gfloat scale; /**< real value of one step of an int8/uint8 output */
+  gint zero_point; /**< int8/uint8 value of a real zero */
+} GstSscmaYolov5Shape;
+
+/**
+ * @brief An input size target-fps can run the first model at.
+ */
+typedef struct
+{
+  gint width; /**< model input width */
+  gint height; /**< model input height */
+  guint n_anchors; /**< output rows at this size */
+} GstSscmaYolov5InputSize;
+
+/**
+ * @brief Labels and their pre-rendered strips. Never changed once made, a new
+ * set replaces the old one as a whole, so a frame keeps drawing with the set
+ * it took a reference on.
+ */
+typedef struct
+{
+  gint refcount; /**< references, the set is freed at 0 */
+  char **names; /**< the labels */
+  SscmaTextStrip **strips; /**< labels pre-rendered for drawing, one per label */
+  guint total; /**< number of labels */
+  guint max_word_length; /**< length of the longest label */
+} GstSscmaYolov5Labels;
+
+/**
+ * @brief A detector of the model property after the first one. It looks at
+ * the same regions of the same frames on the worker pool, sharing the
+ * preprocessing with the detectors of the same input size and
+ * normalisation.
+ */
+typedef struct
+{
+  gchar *bin; /**< model.bin */
+  gchar *param; /**< model.param */
+  ncnn::Net net; /**< loaded on first use */
+  gboolean loaded; /**< TRUE once net is loaded */
+  gboolean failed; /**< TRUE if net cannot be loaded, not tried again */
+
+  GstSscmaYolov5Shape shape; /**< zeros from the spec follow the input and output properties */
+  SscmaOutputLayout layout; /**< layout of the output */
+  GstSscmaYolov5Labels *labels; /**< labels, for drawing, NULL if not set */
+  gfloat conf_threshold; /**< minimum class score * objectness, 0 to follow conf-threshold */
+  gchar *input_name; /**< input blob */
+  gchar *output_name; /**< output blob */
+  gfloat mean[3]; /**< per channel mean subtracted from the 0..255 pixel values */
+  gfloat norm[3]; /**< per channel scale applied after the mean */
+} GstSscmaYolov5Model;
+
 typedef struct _GstSscmaYolov5 GstSscmaYolov5;
 typedef struct _GstSscmaYolov5Class GstSscmaYolov5Class;
 
@@ -128,19 +241,13 @@ typedef struct _GstSscmaYolov5Properties
   const char **model_files; /**< Filepath to the model file (as an argument for NNFW). char instead of gchar for non-glib custom plugins */
   int num_models; /**< number of model files. Some frameworks need multiple model files to initialize the graph (caffe, caffe2) */
 
-  char **labels; /**< The list of loaded labels. Null if not loaded */
-  uint total_labels; /**< The number of loaded labels */
-  uint max_word_length; /**< The max size of labels */
+  GstSscmaYolov5Labels *labels; /**< The loaded labels, NULL if not loaded. Replaced under the object lock */
 
   int input_configured; /**< TRUE if input tensor is configured. Use int instead of gboolean because this is refered by custom plugins. */
   GstTensorsInfo input_meta; /**< configured input tensor info */
-  tensors_layout input_layout; /**< data layout info provided as a property to sscma_yolov5 for the input, defaults to _NNS_LAYOUT_ANY for all the tensors */
-  unsigned int input_ranks[NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT];  /**< the rank list of input tensors, it is calculated based on the dimension string. */
 
   int output_configured; /**< TRUE if output tensor is configured. Use int instead of gboolean because this is refered by custom plugins. */
   GstTensorsInfo output_meta; /**< configured output tensor info */
-  tensors_layout output_layout; /**< data layout info provided as a property to sscma_yolov5 for the output, defaults to _NNS_LAYOUT_ANY for all the tensors */
-  unsigned int output_ranks[NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT];  /**< the rank list of output tensors, it is calculated based on the dimension string. */
 } GstSscmaYolov5Properties;
 
 struct _GstSscmaYolov5
@@ -154,6 +261,112 @@ struct _GstSscmaYolov5
   int rate_n; /**< framerate is in fraction, which is numerator/denominator */
   int rate_d; /**< framerate is in fraction, which is numerator/denominator */
   GstTensorsInfo input_info; /**< input tensor info */
+  SscmaModelConfig *config; /**< bundle the first model was configured from, NULL if none */
+  const gchar *input_name; /**< input blob of the first model */
+  const gchar *output_name; /**< output blob of the first model */
+  gfloat mean_vals[3]; /**< per channel mean subtracted from the 0..255 pixel values */
+  gfloat norm_vals[3]; /**< per channel scale applied after the mean */
+  SscmaOutputLayout output_layout; /**< layout of the output of the first model */
+  SscmaDecodeFunc decode; /**< decoder of the first model, picked when its labels or output type are set */
+  gboolean output_raw; /**< TRUE if the output is decoded in its float16/int8/uint8 type, not converted to float32 */
+  gfloat output_scale; /**< real value of one step of an int8/uint8 output */
+  gint output_zero_point; /**< int8/uint8 value of a real zero */
+  SscmaYolov5Mode mode; /**< output of the element, fixed from the PAUSED state on */
+  GstVideoInfo vinfo; /**< negotiated input video info */
+  GstCaps *sink_caps; /**< last accepted sink caps, identical caps are not parsed again */
+
+  GstBufferPool *pool; /**< downstream pool used when the input cannot be drawn on in place */
+  gboolean downstream_video_meta; /**< TRUE if downstream understands GstVideoMeta (custom strides/offsets) */
+
+  gboolean is_dmabuf; /**< TRUE if the sink caps carry the memory:DMABuf feature */
+  gboolean is_tensor; /**< TRUE if the sink gets preprocessed other/tensors instead of frames */
+  gboolean tensor_planar; /**< TRUE if the input tensor is W:H:C (planar), FALSE for C:W:H */
+  SscmaDmabufCache *dmabuf_cache; /**< read-only mappings of imported dma-bufs */
+  ncnn::Mat input_mat; /**< input of the first model, reused while the input property is unchanged */
+
+  SscmaOverlay *overlay; /**< draws boxes and labels in the negotiated format */
+  guint font_scale; /**< label font scale, 0 to follow the frame height */
+
+  gfloat conf_threshold; /**< minimum class score * objectness, controllable */
+  gfloat iou_threshold; /**< NMS overlap threshold, controllable */
+  guint max_detections; /**< detections kept per frame, 0 for no limit */
+  gchar *classes; /**< "classes" allow-list as set, NULL or empty for all */
+  GArray *class_filter; /**< allowed label indices (guint) resolved from classes */
+  gboolean class_filter_active; /**< TRUE if only the classes in class_filter are decoded */
+  gboolean class_filter_dirty; /**< classes or labels changed since class_filter was resolved */
+
+  gchar *roi; /**< "roi" as set, NULL or empty for the whole frame */
+  GArray *regions; /**< SscmaRegion list parsed from roi, NULL for the whole frame */
+
+  guint tile_size; /**< tile side in frame pixels, 0 to disable tiling */
+  gfloat tile_overlap; /**< fraction of a tile shared with its neighbour */
+  gfloat tile_activity_threshold; /**< coarse score gating the tiles, 0 to run every tile */
+
+  gchar *secondary_model; /**< "secondary-model" as set */
+  gchar **secondary_model_files; /**< secondary model as model.bin, model.param */
+  gchar *secondary_input_name; /**< input blob of the secondary model */
+  gchar *secondary_output_name; /**< output blob of the secondary model */
+  gfloat secondary_mean[3]; /**< per channel mean of the secondary model input */
+  gfloat secondary_norm[3]; /**< per channel scale of the secondary model input */
+  gint secondary_width; /**< secondary model input width */
+  gint secondary_height; /**< secondary model input height */
+  GstSscmaYolov5Labels *secondary_labels; /**< labels of the secondary model, replaced under the object lock */
+  gchar *secondary_classes; /**< "secondary-classes" allow-list as set */
+  GArray *secondary_filter; /**< label indices (guint) resolved from secondary_classes */
+  gboolean secondary_filter_active; /**< TRUE if only the classes in secondary_filter are classified */
+  guint secondary_interval; /**< frames a tracked object keeps its secondary class */
+  SscmaClassifier *classifier; /**< secondary model, NULL if not configured */
+  gboolean secondary_loaded; /**< TRUE if classifier follows secondary-model and secondary-input */
+  GHashTable *secondary_cache; /**< tracking id -> GstSscmaYolov5SecondaryResult */
+  guint64 frame_count; /**< frames processed, to age the secondary cache */
+
+  gchar *models; /**< "model" as set */
+  GPtrArray *extra_models; /**< GstSscmaYolov5Model after the first model, NULL if none */
+  GThreadPool *model_pool; /**< runs the extra models next to the first one */
+  GMutex fanout_lock; /**< protects fanout_pending */
+  GCond fanout_cond; /**< signalled when the last extra model of a region is done */
+  guint fanout_pending; /**< extra models still running on the current region */
+
+  gboolean track; /**< TRUE if detections are tracked across frames */
+  gfloat track_low_ratio; /**< low score detections threshold, relative to conf_threshold */
+  guint track_max_age; /**< frames a track survives without a detection */
+  SscmaTracker *tracker; /**< assigns tracking_id after NMS */
+
+  gchar *lines; /**< "lines" as set, NULL or empty for none */
+  gchar *zones; /**< "zones" as set, NULL or empty for none */
+  SscmaAnalytics *analytics; /**< line crossing and zone counters, under the object lock */
+
+  GstSegment segment; /**< input segment, to get the running time of the frames */
+  gboolean qos; /**< TRUE if frames late for downstream skip the inference */
+  GstClockTime earliest_time; /**< running time before which frames are late, from the last QoS event */
+  gdouble proportion; /**< rate downstream asked for in the last QoS event, 1.0 is real time */
+  guint64 qos_processed; /**< frames that went through the inference */
+  guint64 qos_dropped; /**< frames that skipped the inference because they were late or over the latency budget */
+  GArray *last_results; /**< detectedObject of the last inferred frame, drawn again on late frames */
+  guint latency_budget; /**< processing time allowed per frame in ms, 0 for no limit */
+  guint budget_frames; /**< frames since the last one inferred while over the budget */
+  GstClockTime latency; /**< rolling average processing time of an inferred frame */
+  GstClockTime reported_latency; /**< latency last added to the latency query */
+
+  gdouble target_fps; /**< frame rate the input size follows, 0 to keep the input property */
+  gchar *input_sizes; /**< "input-sizes" as set */
+  GArray *sizes; /**< GstSscmaYolov5InputSize the model accepts, smallest first, NULL if not adapting */
+  guint size_index; /**< size of sizes in use */
+  gint input_width; /**< input width of the first model for the next frame */
+  gint input_height; /**< input height of the first model for the next frame */
+  gint64 model_us; /**< time spent in the first model on the current frame */
+  gdouble model_avg_us; /**< rolling average of model_us at the current size */
+  guint size_frames; /**< frames since the input size last changed */
+
+  gboolean model_loaded; /**< the first model is in net, cleared when model or config change */
+  guint warmup; /**< dummy inferences run when going to PAUSED */
+  guint64 load_us; /**< time the first model took to load */
+  guint64 startup_us; /**< load_us and the warm-up */
+  guint64 first_frame_us; /**< processing time of the first frame after the warm-up */
+  gboolean first_frame_pending; /**< the next inferred frame sets first_frame_us */
+
+  guint64 stage_us[SSCMA_YOLOV5_STAGE_N]; /**< processing time of the last frame per stage */
+  guint n_tracks; /**< live tracks after the last frame */
 
   GstSscmaYolov5Properties prop; /**< NNFW plugin's properties */
 };
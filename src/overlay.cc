@@ -0,0 +1,553 @@
+#include <string.h>
+#include "overlay.h"
+#include "tensor_info.h"
+
+/** number of per-class colors before the palette repeats */
+#define SSCMA_OVERLAY_N_CLASS_COLORS (20)
+/** palette index of the dark text color */
+#define SSCMA_OVERLAY_BLACK (SSCMA_OVERLAY_N_CLASS_COLORS)
+/** palette index of the light text color */
+#define SSCMA_OVERLAY_WHITE (SSCMA_OVERLAY_N_CLASS_COLORS + 1)
+#define SSCMA_OVERLAY_N_COLORS (SSCMA_OVERLAY_N_CLASS_COLORS + 2)
+
+/** the most horizontal runs a row of an 8px wide glyph can have */
+#define SSCMA_GLYPH_MAX_RUNS (SSCMA_GLYPH_WIDTH / 2)
+/** printable ASCII range covered by the rasters font */
+#define SSCMA_GLYPH_FIRST (32)
+#define SSCMA_GLYPH_COUNT (127 - SSCMA_GLYPH_FIRST)
+
+/** per-class box colors (RGB), chosen to stay distinct next to each other */
+static const guint32 sscma_overlay_palette[SSCMA_OVERLAY_N_COLORS] = {
+  0xFF3838, 0xFF9D97, 0xFF701F, 0xFFB21D, 0xCFD231,
+  0x48F90A, 0x92CC17, 0x3DDB86, 0x1A9334, 0x00D4BB,
+  0x2C99A8, 0x00C2FF, 0x344593, 0x6473FF, 0x0018EC,
+  0x8438FF, 0x520085, 0xCB38FF, 0xFF95C8, 0xFF37C7,
+  0x000000, 0xFFFFFF
+};
+
+/**
+ * @brief The set pixels of one glyph row as horizontal runs, so a glyph is
+ * drawn with a few span fills instead of testing every bit.
+ */
+typedef struct
+{
+  guint8 n_runs;
+  guint8 start[SSCMA_GLYPH_MAX_RUNS];
+  guint8 len[SSCMA_GLYPH_MAX_RUNS];
+} SscmaGlyphRow;
+
+static SscmaGlyphRow sscma_glyph_atlas[SSCMA_GLYPH_COUNT][SSCMA_GLYPH_HEIGHT];
+
+/** @brief A horizontal run of text pixels, relative to the strip origin. */
+typedef struct
+{
+  guint16 start;
+  guint16 len;
+} SscmaTextRun;
+
+/**
+ * @brief A whole string pre-rendered as runs per row at 1x, so drawing a
+ * label costs one fill per run at any font scale.
+ */
+struct _SscmaTextStrip
+{
+  guint n_chars; /**< characters in the string, for the background width */
+  guint row_start[SSCMA_GLYPH_HEIGHT + 1]; /**< first run of each row in runs */
+  SscmaTextRun *runs; /**< runs of all rows, top row first */
+};
+
+/**
+ * @brief How a plane is filled: the smallest repeating byte group (one pixel
+ * for packed RGB, a 2-pixel macropixel for YUY2, a U/V pair for NV12) and
+ * how many pixels it covers.
+ */
+typedef struct
+{
+  guint unit; /**< bytes per fill unit (1 to 4) */
+  guint w_sub; /**< log2 of the pixels a unit covers horizontally */
+  guint h_sub; /**< log2 of the rows a unit row covers */
+} SscmaOverlayPlane;
+
+struct _SscmaOverlay
+{
+  GstVideoFormat format; /**< format the patterns were built for */
+  guint n_planes;
+  SscmaOverlayPlane planes[GST_VIDEO_MAX_PLANES];
+  /** every palette color pre-expanded into one fill unit per plane */
+  guint8 pattern[SSCMA_OVERLAY_N_COLORS][GST_VIDEO_MAX_PLANES][4];
+
+  gboolean luma_text; /**< TRUE if text only touches the luma samples */
+  guint luma_offset; /**< byte offset of Y in plane 0 */
+  guint luma_pstride; /**< bytes between two Y samples in plane 0 */
+  guint luma_bytes; /**< bytes per Y sample */
+};
+
+/**
+ * @brief Split the rasters font into horizontal runs, once per process.
+ */
+static void
+sscma_overlay_init_glyphs (void)
+{
+  static gsize initialized = 0;
+  guint c, row, x;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+
+  for (c = 0; c < SSCMA_GLYPH_COUNT; c++) {
+    for (row = 0; row < SSCMA_GLYPH_HEIGHT; row++) {
+      SscmaGlyphRow *r = &sscma_glyph_atlas[c][row];
+      /* rasters are stored bottom row first, MSB is the leftmost pixel */
+      guint8 bits = rasters[c][SSCMA_GLYPH_HEIGHT - 1 - row];
+
+      r->n_runs = 0;
+      for (x = 0; x < SSCMA_GLYPH_WIDTH; x++) {
+        if (!(bits & (0x80 >> x)))
+          continue;
+        if (r->n_runs && r->start[r->n_runs - 1] + r->len[r->n_runs - 1] == x) {
+          r->len[r->n_runs - 1]++;
+        } else {
+          r->start[r->n_runs] = x;
+          r->len[r->n_runs] = 1;
+          r->n_runs++;
+        }
+      }
+    }
+  }
+
+  g_once_init_leave (&initialized, 1);
+}
+
+/**
+ * @brief Create an overlay renderer. Call sscma_overlay_set_format() before drawing.
+ */
+SscmaOverlay *
+sscma_overlay_new (void)
+{
+  sscma_overlay_init_glyphs ();
+  return g_new0 (SscmaOverlay, 1);
+}
+
+/**
+ * @brief Free the overlay renderer.
+ */
+void
+sscma_overlay_free (SscmaOverlay * overlay)
+{
+  g_free (overlay);
+}
+
+/**
+ * @brief Check if boxes and labels can be drawn on frames of the given format.
+ */
+gboolean
+sscma_overlay_is_supported (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_RGB:
+    case GST_VIDEO_FORMAT_BGR:
+    case GST_VIDEO_FORMAT_RGBx:
+    case GST_VIDEO_FORMAT_BGRx:
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_RGBA:
+    case GST_VIDEO_FORMAT_BGRA:
+    case GST_VIDEO_FORMAT_ARGB:
+    case GST_VIDEO_FORMAT_ABGR:
+    case GST_VIDEO_FORMAT_GRAY8:
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+    case GST_VIDEO_FORMAT_GRAY16_BE:
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/**
+ * @brief Get the value of every component of an RGB color in the given format.
+ * 8-bit values are used for 16-bit components too: writing the same byte twice
+ * gives v * 257, which is the exact 16-bit value regardless of endianness.
+ */
+static void
+sscma_overlay_color_components (const GstVideoFormatInfo * finfo, guint32 rgb,
+    guint8 comp[GST_VIDEO_MAX_COMPONENTS])
+{
+  gint r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+
+  if (GST_VIDEO_FORMAT_INFO_IS_YUV (finfo)) {
+    /* BT.601 limited range, matching the preprocessing */
+    comp[GST_VIDEO_COMP_Y] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    comp[GST_VIDEO_COMP_U] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    comp[GST_VIDEO_COMP_V] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  } else if (GST_VIDEO_FORMAT_INFO_IS_GRAY (finfo)) {
+    comp[GST_VIDEO_COMP_Y] = (77 * r + 150 * g + 29 * b + 128) >> 8;
+  } else {
+    comp[GST_VIDEO_COMP_R] = r;
+    comp[GST_VIDEO_COMP_G] = g;
+    comp[GST_VIDEO_COMP_B] = b;
+  }
+  comp[GST_VIDEO_COMP_A] = 0xff;
+}
+
+/**
+ * @brief Pre-expand the palette into fill units of the given format.
+ * @return FALSE if the format cannot be drawn on.
+ */
+gboolean
+sscma_overlay_set_format (SscmaOverlay * overlay, GstVideoFormat format)
+{
+  const GstVideoFormatInfo *finfo;
+  guint c, i, p;
+
+  g_return_val_if_fail (overlay != NULL, FALSE);
+
+  overlay->format = format;
+  overlay->n_planes = 0;
+  if (!sscma_overlay_is_supported (format))
+    return FALSE;
+
+  finfo = gst_video_format_get_info (format);
+  overlay->n_planes = GST_VIDEO_FORMAT_INFO_N_PLANES (finfo);
+
+  memset (overlay->planes, 0, sizeof (overlay->planes));
+  for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); c++) {
+    SscmaOverlayPlane *plane = &overlay->planes[finfo->plane[c]];
+
+    plane->unit = MAX (plane->unit, (guint) finfo->pixel_stride[c]);
+    plane->w_sub = MAX (plane->w_sub, (guint) finfo->w_sub[c]);
+    plane->h_sub = MAX (plane->h_sub, (guint) finfo->h_sub[c]);
+  }
+
+  /* padding bytes (the x of RGBx) are left opaque */
+  memset (overlay->pattern, 0xff, sizeof (overlay->pattern));
+  for (i = 0; i < SSCMA_OVERLAY_N_COLORS; i++) {
+    guint8 comp[GST_VIDEO_MAX_COMPONENTS];
+
+    sscma_overlay_color_components (finfo, sscma_overlay_palette[i], comp);
+    for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); c++) {
+      guint8 *unit = overlay->pattern[i][finfo->plane[c]];
+      guint bytes = (finfo->depth[c] + 7) / 8;
+      guint offset, k;
+
+      p = finfo->plane[c];
+      for (offset = finfo->poffset[c]; offset < overlay->planes[p].unit;
+          offset += finfo->pixel_stride[c]) {
+        for (k = 0; k < bytes; k++)
+          unit[offset + k] = comp[c];
+      }
+    }
+  }
+
+  /* chroma is shared by several pixels in YUV, so text would smear into the
+   * neighbouring pixels; draw it in luma only, on top of the label background */
+  overlay->luma_text = GST_VIDEO_FORMAT_INFO_IS_YUV (finfo);
+  overlay->luma_offset = finfo->poffset[GST_VIDEO_COMP_Y];
+  overlay->luma_pstride = finfo->pixel_stride[GST_VIDEO_COMP_Y];
+  overlay->luma_bytes = (finfo->depth[GST_VIDEO_COMP_Y] + 7) / 8;
+
+  return TRUE;
+}
+
+/**
+ * @brief Repeat a UNIT byte pattern n times, doubling the filled part with
+ * memcpy so long spans become a handful of vectorized copies.
+ */
+template <guint UNIT>
+static inline void
+sscma_overlay_fill_span (guint8 * dst, const guint8 * pattern, gint n)
+{
+  gsize done, total = (gsize) n * UNIT;
+
+  memcpy (dst, pattern, UNIT);
+  for (done = UNIT; done * 2 <= total; done *= 2)
+    memcpy (dst + done, dst, done);
+  memcpy (dst + done, dst, total - done);
+}
+
+template <>
+inline void
+sscma_overlay_fill_span<1> (guint8 * dst, const guint8 * pattern, gint n)
+{
+  memset (dst, pattern[0], n);
+}
+
+/**
+ * @brief Fill the units of one plane covering the already clipped pixel
+ * rectangle [x0, x1) x [y0, y1).
+ */
+template <guint UNIT>
+static void
+sscma_overlay_fill_plane (guint8 * data, gint stride,
+    const SscmaOverlayPlane * plane, const guint8 * pattern,
+    gint x0, gint y0, gint x1, gint y1)
+{
+  gint ux0 = x0 >> plane->w_sub;
+  gint ux1 = ((x1 - 1) >> plane->w_sub) + 1;
+  gint uy0 = y0 >> plane->h_sub;
+  gint uy1 = ((y1 - 1) >> plane->h_sub) + 1;
+  guint8 *row = data + (gsize) uy0 * stride + (gsize) ux0 * UNIT;
+  gint y;
+
+  for (y = uy0; y < uy1; y++, row += stride)
+    sscma_overlay_fill_span<UNIT> (row, pattern, ux1 - ux0);
+}
+
+/**
+ * @brief Fill a rectangle of the frame with a palette color, clipped to the frame.
+ */
+static void
+sscma_overlay_fill_rect (SscmaOverlay * overlay, GstVideoFrame * frame,
+    gint x, gint y, gint w, gint h, guint color)
+{
+  gint x0 = MAX (x, 0);
+  gint y0 = MAX (y, 0);
+  gint x1 = MIN (x + w, (gint) GST_VIDEO_FRAME_WIDTH (frame));
+  gint y1 = MIN (y + h, (gint) GST_VIDEO_FRAME_HEIGHT (frame));
+  guint p;
+
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  for (p = 0; p < overlay->n_planes; p++) {
+    guint8 *data = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (frame, p);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, p);
+    const SscmaOverlayPlane *plane = &overlay->planes[p];
+    const guint8 *pattern = overlay->pattern[color][p];
+
+    switch (plane->unit) {
+      case 1:
+        sscma_overlay_fill_plane<1> (data, stride, plane, pattern, x0, y0, x1, y1);
+        break;
+      case 2:
+        sscma_overlay_fill_plane<2> (data, stride, plane, pattern, x0, y0, x1, y1);
+        break;
+      case 3:
+        sscma_overlay_fill_plane<3> (data, stride, plane, pattern, x0, y0, x1, y1);
+        break;
+      case 4:
+        sscma_overlay_fill_plane<4> (data, stride, plane, pattern, x0, y0, x1, y1);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Draw a rectangle of text pixels, clipped to the frame.
+ */
+static void
+sscma_overlay_text_rect (SscmaOverlay * overlay, GstVideoFrame * frame,
+    gint x, gint y, gint w, gint h, guint color)
+{
+  guint8 *row;
+  gint x0, x1, y0, y1, stride;
+
+  if (!overlay->luma_text) {
+    sscma_overlay_fill_rect (overlay, frame, x, y, w, h, color);
+    return;
+  }
+
+  x0 = MAX (x, 0);
+  x1 = MIN (x + w, (gint) GST_VIDEO_FRAME_WIDTH (frame));
+  y0 = MAX (y, 0);
+  y1 = MIN (y + h, (gint) GST_VIDEO_FRAME_HEIGHT (frame));
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  row = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (frame, 0) +
+      (gsize) y0 * stride + overlay->luma_offset;
+  for (y = y0; y < y1; y++, row += stride) {
+    for (x = x0; x < x1; x++) {
+      guint8 *px = row + (gsize) x * overlay->luma_pstride;
+      guint k;
+
+      for (k = 0; k < overlay->luma_bytes; k++)
+        px[k] = overlay->pattern[color][0][overlay->luma_offset + k];
+    }
+  }
+}
+
+/**
+ * @brief Draw the runs of one glyph (from the atlas), scaled.
+ */
+static void
+sscma_overlay_draw_glyph (SscmaOverlay * overlay, GstVideoFrame * frame,
+    gint x, gint y, guint c, guint color, gint scale)
+{
+  gint row, r;
+
+  if (c < SSCMA_GLYPH_FIRST || c >= SSCMA_GLYPH_FIRST + SSCMA_GLYPH_COUNT)
+    c = '*';
+
+  for (row = 0; row < SSCMA_GLYPH_HEIGHT; row++) {
+    const SscmaGlyphRow *g = &sscma_glyph_atlas[c - SSCMA_GLYPH_FIRST][row];
+
+    for (r = 0; r < g->n_runs; r++)
+      sscma_overlay_text_rect (overlay, frame, x + g->start[r] * scale,
+          y + row * scale, g->len[r] * scale, scale, color);
+  }
+}
+
+/**
+ * @brief Pick black or white text, whichever reads better on the class color.
+ */
+static guint
+sscma_overlay_text_color (guint color)
+{
+  guint32 rgb = sscma_overlay_palette[color];
+  guint luma = (77 * ((rgb >> 16) & 0xff) + 150 * ((rgb >> 8) & 0xff) +
+      29 * (rgb & 0xff)) >> 8;
+
+  return luma > 140 ? SSCMA_OVERLAY_BLACK : SSCMA_OVERLAY_WHITE;
+}
+
+/**
+ * @brief Draw the outline of a box in the color of the given class.
+ * @param box The box in frame pixels; parts outside the frame are clipped.
+ * @param color Class index, the palette repeats every 20 classes.
+ * @param thickness Line width in pixels, drawn inside the box.
+ */
+void
+sscma_overlay_draw_box (SscmaOverlay * overlay, GstVideoFrame * frame,
+    const SscmaRect * box, guint color, gint thickness)
+{
+  gint t;
+
+  g_return_if_fail (overlay != NULL && frame != NULL && box != NULL);
+
+  if (overlay->n_planes == 0 || box->width <= 0 || box->height <= 0)
+    return;
+
+  color %= SSCMA_OVERLAY_N_CLASS_COLORS;
+  t = CLAMP (thickness, 1, MIN (box->width, box->height) / 2 + 1);
+
+  sscma_overlay_fill_rect (overlay, frame, box->x, box->y, box->width, t, color);
+  sscma_overlay_fill_rect (overlay, frame, box->x, box->y + box->height - t,
+      box->width, t, color);
+  sscma_overlay_fill_rect (overlay, frame, box->x, box->y + t, t,
+      box->height - 2 * t, color);
+  sscma_overlay_fill_rect (overlay, frame, box->x + box->width - t, box->y + t,
+      t, box->height - 2 * t, color);
+}
+
+/**
+ * @brief Get the height of a label drawn at the given font scale.
+ */
+gint
+sscma_overlay_label_height (gint scale)
+{
+  return (SSCMA_GLYPH_HEIGHT + 2) * MAX (scale, 1);
+}
+
+/**
+ * @brief Draw a pre-rendered label on a filled background in the color of
+ * the given class, optionally followed by a number (e.g., a tracking id).
+ * @param x Left edge of the label in frame pixels.
+ * @param y Top edge of the label in frame pixels.
+ * @param text Label rendered by sscma_text_strip_new().
+ * @param number Appended after a space if not negative.
+ * @param scale Integer font scale, each font pixel becomes scale x scale pixels.
+ */
+void
+sscma_overlay_draw_label (SscmaOverlay * overlay, GstVideoFrame * frame,
+    gint x, gint y, const SscmaTextStrip * text, gint number, guint color,
+    gint scale)
+{
+  gchar digits[16] = "";
+  guint text_color, row, r;
+  gint n_digits = 0, ox, oy, i;
+
+  g_return_if_fail (overlay != NULL && frame != NULL && text != NULL);
+
+  if (overlay->n_planes == 0)
+    return;
+
+  scale = MAX (scale, 1);
+  color %= SSCMA_OVERLAY_N_CLASS_COLORS;
+  text_color = sscma_overlay_text_color (color);
+  if (number >= 0)
+    n_digits = g_snprintf (digits, sizeof (digits), " %d", number);
+
+  sscma_overlay_fill_rect (overlay, frame, x, y,
+      ((text->n_chars + n_digits) * SSCMA_GLYPH_ADVANCE + 1) * scale,
+      sscma_overlay_label_height (scale), color);
+
+  ox = x + scale;
+  oy = y + scale;
+  for (row = 0; row < SSCMA_GLYPH_HEIGHT; row++) {
+    for (r = text->row_start[row]; r < text->row_start[row + 1]; r++)
+      sscma_overlay_text_rect (overlay, frame, ox + text->runs[r].start * scale,
+          oy + row * scale, text->runs[r].len * scale, scale, text_color);
+  }
+
+  /* numbers change every frame, so they are drawn from the glyph atlas */
+  ox += text->n_chars * SSCMA_GLYPH_ADVANCE * scale;
+  for (i = 0; i < n_digits; i++, ox += SSCMA_GLYPH_ADVANCE * scale)
+    sscma_overlay_draw_glyph (overlay, frame, ox, oy, (guint8) digits[i],
+        text_color, scale);
+}
+
+/**
+ * @brief Pre-render a label (e.g., a class name when the labels are loaded).
+ * @param text ASCII text; other characters are drawn as '*'.
+ */
+SscmaTextStrip *
+sscma_text_strip_new (const gchar * text)
+{
+  SscmaTextStrip *strip;
+  GArray *runs;
+  guint i, row, r;
+
+  g_return_val_if_fail (text != NULL, NULL);
+
+  sscma_overlay_init_glyphs ();
+
+  strip = g_new0 (SscmaTextStrip, 1);
+  strip->n_chars = strlen (text);
+  runs = g_array_new (FALSE, FALSE, sizeof (SscmaTextRun));
+
+  for (row = 0; row < SSCMA_GLYPH_HEIGHT; row++) {
+    strip->row_start[row] = runs->len;
+    for (i = 0; i < strip->n_chars; i++) {
+      guint c = (guint8) text[i];
+      const SscmaGlyphRow *g;
+
+      if (c < SSCMA_GLYPH_FIRST || c >= SSCMA_GLYPH_FIRST + SSCMA_GLYPH_COUNT)
+        c = '*';
+      g = &sscma_glyph_atlas[c - SSCMA_GLYPH_FIRST][row];
+
+      for (r = 0; r < g->n_runs; r++) {
+        SscmaTextRun run;
+
+        run.start = i * SSCMA_GLYPH_ADVANCE + g->start[r];
+        run.len = g->len[r];
+        g_array_append_val (runs, run);
+      }
+    }
+  }
+  strip->row_start[SSCMA_GLYPH_HEIGHT] = runs->len;
+  strip->runs = (SscmaTextRun *) g_array_free (runs, FALSE);
+
+  return strip;
+}
+
+/**
+ * @brief Free a pre-rendered label.
+ */
+void
+sscma_text_strip_free (SscmaTextStrip * strip)
+{
+  if (strip == NULL)
+    return;
+
+  g_free (strip->runs);
+  g_free (strip);
+}
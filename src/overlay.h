@@ -0,0 +1,33 @@
+#ifndef __GST_SSCMA_OVERLAY_H__
+#define __GST_SSCMA_OVERLAY_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "preprocess.h"
+
+/** width of one glyph of the built-in font */
+#define SSCMA_GLYPH_WIDTH (8)
+/** height of one glyph of the built-in font */
+#define SSCMA_GLYPH_HEIGHT (13)
+/** horizontal distance between two glyphs (glyph width + 1px) */
+#define SSCMA_GLYPH_ADVANCE (SSCMA_GLYPH_WIDTH + 1)
+
+typedef struct _SscmaOverlay SscmaOverlay;
+typedef struct _SscmaTextStrip SscmaTextStrip;
+
+SscmaOverlay *sscma_overlay_new (void);
+void sscma_overlay_free (SscmaOverlay * overlay);
+gboolean sscma_overlay_is_supported (GstVideoFormat format);
+gboolean sscma_overlay_set_format (SscmaOverlay * overlay,
+    GstVideoFormat format);
+void sscma_overlay_draw_box (SscmaOverlay * overlay, GstVideoFrame * frame,
+    const SscmaRect * box, guint color, gint thickness);
+void sscma_overlay_draw_label (SscmaOverlay * overlay, GstVideoFrame * frame,
+    gint x, gint y, const SscmaTextStrip * text, gint number, guint color,
+    gint scale);
+gint sscma_overlay_label_height (gint scale);
+
+SscmaTextStrip *sscma_text_strip_new (const gchar * text);
+void sscma_text_strip_free (SscmaTextStrip * strip);
+
+#endif /* __GST_SSCMA_OVERLAY_H__ */
@@ -0,0 +1,527 @@
+#include <math.h>
+#include <vector>
+#include "preprocess.h"
+
+/** fixed point precision of the bilinear weights */
+#define SSCMA_FRAC_BITS (11)
+#define SSCMA_FRAC_ONE (1 << SSCMA_FRAC_BITS)
+
+/**
+ * @brief Bilinear source taps for one output coordinate.
+ */
+typedef struct
+{
+  gint i0; /**< first source index */
+  gint i1; /**< second source index */
+  gint frac; /**< weight of i1 in SSCMA_FRAC_ONE units */
+  gint nearest; /**< nearest source index, used for subsampled chroma */
+} SscmaTap;
+
+/**
+ * @brief Fill the taps mapping dst_size outputs onto [offset, offset + size).
+ * Pixel centres are aligned the same way as ncnn's resize_bilinear.
+ */
+static void
+sscma_compute_taps (std::vector<SscmaTap> &taps, gint offset, gint size,
+    gint dst_size)
+{
+  float scale = (float) size / dst_size;
+  gint i;
+
+  taps.resize (dst_size);
+  for (i = 0; i < dst_size; i++) {
+    float fs = (i + 0.5f) * scale - 0.5f;
+    gint s = (gint) floorf (fs);
+    gint frac = (gint) ((fs - s) * SSCMA_FRAC_ONE + 0.5f);
+
+    if (s < 0) {
+      s = 0;
+      frac = 0;
+    }
+    if (s >= size - 1) {
+      s = size - 1;
+      frac = 0;
+    }
+
+    taps[i].i0 = offset + s;
+    taps[i].i1 = offset + MIN (s + 1, size - 1);
+    taps[i].frac = frac;
+    taps[i].nearest = frac >= SSCMA_FRAC_ONE / 2 ? taps[i].i1 : taps[i].i0;
+  }
+}
+
+/**
+ * @brief Where luma and chroma samples live for each supported YUV layout.
+ * luma() reads the Y sample of pixel x from a luma row, chroma() the U/V pair
+ * shared by pixel (x, y).
+ */
+template <GstVideoFormat F> struct SscmaYuvLayout;
+
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_NV12>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    const guint8 *c = img->data[1] + (y >> 1) * img->stride[1] + (x & ~1);
+    *u = c[0];
+    *v = c[1];
+  }
+};
+
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_NV21>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    const guint8 *c = img->data[1] + (y >> 1) * img->stride[1] + (x & ~1);
+    *v = c[0];
+    *u = c[1];
+  }
+};
+
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_I420>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    *u = img->data[1][(y >> 1) * img->stride[1] + (x >> 1)];
+    *v = img->data[2][(y >> 1) * img->stride[2] + (x >> 1)];
+  }
+};
+
+/* YV12 frames map the V plane as plane 1 and the U plane as plane 2 */
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_YV12>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    *v = img->data[1][(y >> 1) * img->stride[1] + (x >> 1)];
+    *u = img->data[2][(y >> 1) * img->stride[2] + (x >> 1)];
+  }
+};
+
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_YUY2>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x * 2]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    const guint8 *c = img->data[0] + y * img->stride[0] + (x & ~1) * 2;
+    *u = c[1];
+    *v = c[3];
+  }
+};
+
+template <> struct SscmaYuvLayout<GST_VIDEO_FORMAT_UYVY>
+{
+  static inline gint luma (const guint8 * row, gint x) { return row[x * 2 + 1]; }
+  static inline void chroma (const SscmaImage * img, gint x, gint y,
+      gint * u, gint * v)
+  {
+    const guint8 *c = img->data[0] + y * img->stride[0] + (x & ~1) * 2;
+    *u = c[0];
+    *v = c[2];
+  }
+};
+
+/**
+ * @brief Scale, convert (BT.601 limited range) and normalize in one pass.
+ * Only the dst_width x dst_height output pixels are ever converted; luma is
+ * sampled bilinearly, the subsampled chroma from the nearest site.
+ * Each value v becomes v * norm + bias, bias being -mean * norm.
+ */
+template <GstVideoFormat F>
+static void
+sscma_convert_yuv (const SscmaImage * img, const std::vector<SscmaTap> &xt,
+    const std::vector<SscmaTap> &yt, const float norm[3], const float bias[3],
+    ncnn::Mat & dst)
+{
+  typedef SscmaYuvLayout<F> L;
+  const gint w = dst.w;
+  const gint h = dst.h;
+  float *r_out = dst.channel (0);
+  float *g_out = dst.channel (1);
+  float *b_out = dst.channel (2);
+  gint x, y;
+
+  for (y = 0; y < h; y++) {
+    const guint8 *row0 = img->data[0] + yt[y].i0 * img->stride[0];
+    const guint8 *row1 = img->data[0] + yt[y].i1 * img->stride[0];
+    const gint fy = yt[y].frac;
+
+    for (x = 0; x < w; x++) {
+      const SscmaTap *t = &xt[x];
+      gint top, bottom, luma, u, v, c, r, g, b;
+
+      top = L::luma (row0, t->i0) * SSCMA_FRAC_ONE +
+          (L::luma (row0, t->i1) - L::luma (row0, t->i0)) * t->frac;
+      bottom = L::luma (row1, t->i0) * SSCMA_FRAC_ONE +
+          (L::luma (row1, t->i1) - L::luma (row1, t->i0)) * t->frac;
+      luma = (top * SSCMA_FRAC_ONE + (bottom - top) * fy +
+          (1 << (2 * SSCMA_FRAC_BITS - 1))) >> (2 * SSCMA_FRAC_BITS);
+
+      L::chroma (img, t->nearest, yt[y].nearest, &u, &v);
+      u -= 128;
+      v -= 128;
+
+      /* coefficients scaled by 1024 */
+      c = (luma - 16) * 1192;
+      r = (c + 1634 * v) >> 10;
+      g = (c - 401 * u - 833 * v) >> 10;
+      b = (c + 2066 * u) >> 10;
+
+      r_out[x] = CLAMP (r, 0, 255) * norm[0] + bias[0];
+      g_out[x] = CLAMP (g, 0, 255) * norm[1] + bias[1];
+      b_out[x] = CLAMP (b, 0, 255) * norm[2] + bias[2];
+    }
+
+    r_out += w;
+    g_out += w;
+    b_out += w;
+  }
+}
+
+/**
+ * @brief Bilinear sample of one byte channel at byte offset off of a pixel.
+ */
+template <gint BPP>
+static inline gint
+sscma_sample_packed (const guint8 * row0, const guint8 * row1,
+    const SscmaTap * t, gint fy, gint off)
+{
+  gint a = row0[t->i0 * BPP + off], b = row0[t->i1 * BPP + off];
+  gint c = row1[t->i0 * BPP + off], d = row1[t->i1 * BPP + off];
+  gint top = a * SSCMA_FRAC_ONE + (b - a) * t->frac;
+  gint bottom = c * SSCMA_FRAC_ONE + (d - c) * t->frac;
+
+  return (top * SSCMA_FRAC_ONE + (bottom - top) * fy +
+      (1 << (2 * SSCMA_FRAC_BITS - 1))) >> (2 * SSCMA_FRAC_BITS);
+}
+
+/**
+ * @brief Scale and normalize packed pixels ncnn has no converter for
+ * (alpha/padding first, 16-bit gray). R, G and B are byte offsets in a pixel
+ * of BPP bytes; gray formats use the same offset for all three.
+ */
+template <gint BPP, gint R, gint G, gint B>
+static void
+sscma_convert_packed (const SscmaImage * img,
+    const std::vector<SscmaTap> &xt, const std::vector<SscmaTap> &yt,
+    const float norm[3], const float bias[3], ncnn::Mat & dst)
+{
+  const gint w = dst.w;
+  const gint h = dst.h;
+  float *r_out = dst.channel (0);
+  float *g_out = dst.channel (1);
+  float *b_out = dst.channel (2);
+  gint x, y;
+
+  for (y = 0; y < h; y++) {
+    const guint8 *row0 = img->data[0] + yt[y].i0 * img->stride[0];
+    const guint8 *row1 = img->data[0] + yt[y].i1 * img->stride[0];
+    const gint fy = yt[y].frac;
+
+    for (x = 0; x < w; x++) {
+      const SscmaTap *t = &xt[x];
+      gint r = sscma_sample_packed<BPP> (row0, row1, t, fy, R);
+      gint g = (G == R) ? r : sscma_sample_packed<BPP> (row0, row1, t, fy, G);
+      gint b = (B == R) ? r : sscma_sample_packed<BPP> (row0, row1, t, fy, B);
+
+      r_out[x] = r * norm[0] + bias[0];
+      g_out[x] = g * norm[1] + bias[1];
+      b_out[x] = b * norm[2] + bias[2];
+    }
+
+    r_out += w;
+    g_out += w;
+    b_out += w;
+  }
+}
+
+/**
+ * @brief Describe a mapped video frame as an SscmaImage.
+ */
+void
+sscma_image_from_video_frame (SscmaImage * image, const GstVideoFrame * frame)
+{
+  guint i;
+
+  memset (image, 0, sizeof (SscmaImage));
+  image->format = GST_VIDEO_FRAME_FORMAT (frame);
+  image->width = GST_VIDEO_FRAME_WIDTH (frame);
+  image->height = GST_VIDEO_FRAME_HEIGHT (frame);
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    image->data[i] = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA (frame, i);
+    image->stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE (frame, i);
+  }
+}
+
+/**
+ * @brief Get the ncnn pixel conversion that turns the format into RGB.
+ * @return The ncnn::Mat::PixelType, or 0 if the format goes through the fused
+ * conversion in this file instead.
+ */
+gint
+sscma_preprocess_ncnn_pixel_type (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_RGB:
+      return ncnn::Mat::PIXEL_RGB;
+    case GST_VIDEO_FORMAT_BGR:
+      return ncnn::Mat::PIXEL_BGR2RGB;
+    case GST_VIDEO_FORMAT_RGBA:
+    case GST_VIDEO_FORMAT_RGBx:
+      return ncnn::Mat::PIXEL_RGBA2RGB;
+    case GST_VIDEO_FORMAT_BGRA:
+    case GST_VIDEO_FORMAT_BGRx:
+      return ncnn::Mat::PIXEL_BGRA2RGB;
+    case GST_VIDEO_FORMAT_GRAY8:
+      return ncnn::Mat::PIXEL_GRAY2RGB;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Check if the format goes through the fused conversion.
+ */
+gboolean
+sscma_preprocess_is_fused (GstVideoFormat format)
+{
+  switch (format) {
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_NV21:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YV12:
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+    case GST_VIDEO_FORMAT_GRAY16_BE:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/**
+ * @brief Check if the format can be turned into a model input at all.
+ */
+gboolean
+sscma_preprocess_is_supported (GstVideoFormat format)
+{
+  return sscma_preprocess_ncnn_pixel_type (format) != 0 ||
+      sscma_preprocess_is_fused (format);
+}
+
+/**
+ * @brief Convert an image (or a region of it) into a planar RGB float Mat.
+ * Scaling, color conversion and normalization happen in a single pass that
+ * only touches the dst_width x dst_height output pixels.
+ * @param image The source image.
+ * @param roi Region of the image to use, NULL for the whole image.
+ * @param dst_width Width of the model input.
+ * @param dst_height Height of the model input.
+ * @param mean_vals Per channel (R, G, B) mean subtracted first, NULL for none.
+ * @param norm_vals Per channel (R, G, B) scale applied to the 0..255 values.
+ * @param dst The output Mat, (re)created as dst_width x dst_height x 3.
+ * @return TRUE if the format is supported and dst was filled.
+ */
+static gboolean
+sscma_preprocess_fused (const SscmaImage * image, const SscmaRect * roi,
+    gint dst_width, gint dst_height, const float mean_vals[3],
+    const float norm_vals[3], ncnn::Mat & dst)
+{
+  /* kept per thread, the models run on worker threads too */
+  static thread_local std::vector<SscmaTap> xt, yt;
+  SscmaRect full = { 0, 0, image->width, image->height };
+  float bias[3] = { 0.f, 0.f, 0.f };
+  gint i;
+
+  g_return_val_if_fail (dst_width > 0 && dst_height > 0, FALSE);
+
+  if (roi == NULL)
+    roi = &full;
+  g_return_val_if_fail (roi->x >= 0 && roi->y >= 0 && roi->width > 0 &&
+      roi->height > 0, FALSE);
+  g_return_val_if_fail (roi->x + roi->width <= image->width &&
+      roi->y + roi->height <= image->height, FALSE);
+
+  sscma_compute_taps (xt, roi->x, roi->width, dst_width);
+  sscma_compute_taps (yt, roi->y, roi->height, dst_height);
+  dst.create (dst_width, dst_height, 3);
+  /* (v - mean) * norm, folded into one multiply-add per value */
+  for (i = 0; mean_vals && i < 3; i++)
+    bias[i] = -mean_vals[i] * norm_vals[i];
+
+  switch (image->format) {
+    case GST_VIDEO_FORMAT_NV12:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_NV12> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_NV21:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_NV21> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_I420> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_YV12:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_YV12> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_YUY2:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_YUY2> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_UYVY:
+      sscma_convert_yuv<GST_VIDEO_FORMAT_UYVY> (image, xt, yt, norm_vals, bias,
+          dst);
+      break;
+    case GST_VIDEO_FORMAT_xRGB:
+    case GST_VIDEO_FORMAT_ARGB:
+      sscma_convert_packed<4, 1, 2, 3> (image, xt, yt, norm_vals, bias, dst);
+      break;
+    case GST_VIDEO_FORMAT_xBGR:
+    case GST_VIDEO_FORMAT_ABGR:
+      sscma_convert_packed<4, 3, 2, 1> (image, xt, yt, norm_vals, bias, dst);
+      break;
+    case GST_VIDEO_FORMAT_GRAY16_LE:
+      /* the most significant byte is enough for an 8-bit model input */
+      sscma_convert_packed<2, 1, 1, 1> (image, xt, yt, norm_vals, bias, dst);
+      break;
+    case GST_VIDEO_FORMAT_GRAY16_BE:
+      sscma_convert_packed<2, 0, 0, 0> (image, xt, yt, norm_vals, bias, dst);
+      break;
+    default:
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * @brief Normalize dst.w x dst.h packed pixels of BPP bytes into the planar
+ * RGB float Mat. R, G and B are byte offsets in a pixel.
+ */
+template <gint BPP, gint R, gint G, gint B>
+static void
+sscma_normalize_packed (const guint8 * src, gint stride, const float norm[3],
+    const float bias[3], ncnn::Mat & dst)
+{
+  float *r_out = dst.channel (0);
+  float *g_out = dst.channel (1);
+  float *b_out = dst.channel (2);
+  gint x, y;
+
+  for (y = 0; y < dst.h; y++) {
+    const guint8 *p = src + y * stride;
+
+    for (x = 0; x < dst.w; x++, p += BPP) {
+      r_out[x] = p[R] * norm[0] + bias[0];
+      g_out[x] = p[G] * norm[1] + bias[1];
+      b_out[x] = p[B] * norm[2] + bias[2];
+    }
+    r_out += dst.w;
+    g_out += dst.w;
+    b_out += dst.w;
+  }
+}
+
+/**
+ * @brief Turn an image (or a region of it) into the normalized model input.
+ * Formats ncnn converts natively use its SIMD resize, every other format
+ * goes through the fused single-pass conversion. Both write into dst, which
+ * is only allocated again when the input size changes.
+ * @param image The source image.
+ * @param roi Region of the image to use, NULL for the whole image.
+ * @param dst_width Width of the model input.
+ * @param dst_height Height of the model input.
+ * @param mean_vals Per channel (R, G, B) mean subtracted first, NULL for none.
+ * @param norm_vals Per channel (R, G, B) scale applied to the 0..255 values.
+ * @param dst The output Mat, dst_width x dst_height x 3 floats.
+ * @return TRUE if dst was filled.
+ */
+gboolean
+sscma_preprocess (const SscmaImage * image, const SscmaRect * roi,
+    gint dst_width, gint dst_height, const float mean_vals[3],
+    const float norm_vals[3], ncnn::Mat & dst)
+{
+  /* the resized pixels, kept per thread like the taps */
+  static thread_local std::vector<guint8> pixels;
+  gint type = sscma_preprocess_ncnn_pixel_type (image->format);
+  SscmaRect full = { 0, 0, image->width, image->height };
+  float bias[3] = { 0.f, 0.f, 0.f };
+  const guint8 *src;
+  gint i, bpp, stride;
+
+  if (type == 0)
+    return sscma_preprocess_fused (image, roi, dst_width, dst_height,
+        mean_vals, norm_vals, dst);
+
+  g_return_val_if_fail (dst_width > 0 && dst_height > 0, FALSE);
+  if (roi == NULL)
+    roi = &full;
+  g_return_val_if_fail (roi->x >= 0 && roi->y >= 0 && roi->width > 0 &&
+      roi->height > 0, FALSE);
+  g_return_val_if_fail (roi->x + roi->width <= image->width &&
+      roi->y + roi->height <= image->height, FALSE);
+
+  bpp = type == ncnn::Mat::PIXEL_GRAY2RGB ? 1 :
+      (type == ncnn::Mat::PIXEL_RGB || type == ncnn::Mat::PIXEL_BGR2RGB) ?
+      3 : 4;
+  src = image->data[0] + roi->y * image->stride[0] + roi->x * bpp;
+  stride = dst_width * bpp;
+  pixels.resize ((gsize) stride * dst_height);
+  switch (bpp) {
+    case 1:
+      ncnn::resize_bilinear_c1 (src, roi->width, roi->height,
+          image->stride[0], pixels.data (), dst_width, dst_height, stride);
+      break;
+    case 3:
+      ncnn::resize_bilinear_c3 (src, roi->width, roi->height,
+          image->stride[0], pixels.data (), dst_width, dst_height, stride);
+      break;
+    default:
+      ncnn::resize_bilinear_c4 (src, roi->width, roi->height,
+          image->stride[0], pixels.data (), dst_width, dst_height, stride);
+      break;
+  }
+
+  dst.create (dst_width, dst_height, 3);
+  for (i = 0; mean_vals && i < 3; i++)
+    bias[i] = -mean_vals[i] * norm_vals[i];
+
+  switch (type) {
+    case ncnn::Mat::PIXEL_RGB:
+      sscma_normalize_packed<3, 0, 1, 2> (pixels.data (), stride, norm_vals,
+          bias, dst);
+      break;
+    case ncnn::Mat::PIXEL_BGR2RGB:
+      sscma_normalize_packed<3, 2, 1, 0> (pixels.data (), stride, norm_vals,
+          bias, dst);
+      break;
+    case ncnn::Mat::PIXEL_RGBA2RGB:
+      sscma_normalize_packed<4, 0, 1, 2> (pixels.data (), stride, norm_vals,
+          bias, dst);
+      break;
+    case ncnn::Mat::PIXEL_BGRA2RGB:
+      sscma_normalize_packed<4, 2, 1, 0> (pixels.data (), stride, norm_vals,
+          bias, dst);
+      break;
+    default:
+      sscma_normalize_packed<1, 0, 0, 0> (pixels.data (), stride, norm_vals,
+          bias, dst);
+      break;
+  }
+  return TRUE;
+}
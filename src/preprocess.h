@@ -0,0 +1,42 @@
+#ifndef __GST_SSCMA_PREPROCESS_H__
+#define __GST_SSCMA_PREPROCESS_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <net.h>
+
+/**
+ * @brief A video image to be turned into a model input tensor.
+ * One pointer and row stride per plane, so mapped frames, imported DMABuf
+ * planes and padded pool buffers are all described the same way.
+ */
+typedef struct
+{
+  GstVideoFormat format; /**< pixel format of the planes */
+  gint width; /**< image width in pixels */
+  gint height; /**< image height in pixels */
+  const guint8 *data[GST_VIDEO_MAX_PLANES]; /**< first pixel of each plane */
+  gint stride[GST_VIDEO_MAX_PLANES]; /**< row stride of each plane in bytes */
+} SscmaImage;
+
+/**
+ * @brief A rectangle in image pixels.
+ */
+typedef struct
+{
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+} SscmaRect;
+
+void sscma_image_from_video_frame (SscmaImage * image,
+    const GstVideoFrame * frame);
+gint sscma_preprocess_ncnn_pixel_type (GstVideoFormat format);
+gboolean sscma_preprocess_is_fused (GstVideoFormat format);
+gboolean sscma_preprocess_is_supported (GstVideoFormat format);
+gboolean sscma_preprocess (const SscmaImage * image, const SscmaRect * roi,
+    gint dst_width, gint dst_height, const float mean_vals[3],
+    const float norm_vals[3], ncnn::Mat & dst);
+
+#endif /* __GST_SSCMA_PREPROCESS_H__ */
@@ -0,0 +1,152 @@
+#include <math.h>
+#include "region.h"
+
+/**
+ * @brief Parse one region, "x,y,w,h" for a rectangle or "x1,y1,x2,y2,x3,y3[,...]"
+ * for a polygon.
+ */
+static gboolean
+sscma_region_parse (const gchar * str, SscmaRegion * region)
+{
+  gchar **values;
+  gdouble v[2 * SSCMA_REGION_MAX_POINTS];
+  guint n, i;
+  gboolean ok = TRUE;
+
+  values = g_strsplit (str, ",", -1);
+  n = g_strv_length (values);
+  if (n != 4 && (n < 6 || n % 2 || n > 2 * SSCMA_REGION_MAX_POINTS)) {
+    g_strfreev (values);
+    return FALSE;
+  }
+
+  for (i = 0; i < n && ok; i++) {
+    gchar *end = NULL;
+    const gchar *s = g_strstrip (values[i]);
+
+    v[i] = g_ascii_strtod (s, &end);
+    ok = (end != s && *end == '\0' && v[i] >= 0.0 && isfinite (v[i]));
+  }
+  g_strfreev (values);
+  if (!ok)
+    return FALSE;
+
+  region->normalized = TRUE;
+  for (i = 0; i < n; i++)
+    region->normalized &= (v[i] <= 1.0);
+
+  if (n == 4) {
+    if (v[2] <= 0.0 || v[3] <= 0.0)
+      return FALSE;
+    region->is_rect = TRUE;
+    region->n_points = 4;
+    region->x[0] = region->x[3] = v[0];
+    region->x[1] = region->x[2] = v[0] + v[2];
+    region->y[0] = region->y[1] = v[1];
+    region->y[2] = region->y[3] = v[1] + v[3];
+  } else {
+    region->is_rect = FALSE;
+    region->n_points = n / 2;
+    for (i = 0; i < region->n_points; i++) {
+      region->x[i] = v[2 * i];
+      region->y[i] = v[2 * i + 1];
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Parse a ';' separated list of regions.
+ * @return GArray of SscmaRegion, or NULL if any region is malformed.
+ */
+GArray *
+sscma_regions_parse (const gchar * str)
+{
+  GArray *regions;
+  gchar **items;
+  guint i;
+
+  g_return_val_if_fail (str != NULL, NULL);
+
+  regions = g_array_new (FALSE, TRUE, sizeof (SscmaRegion));
+  items = g_strsplit (str, ";", -1);
+  for (i = 0; items[i]; i++) {
+    SscmaRegion region;
+
+    if (g_strstrip (items[i])[0] == '\0')
+      continue;
+    if (!sscma_region_parse (items[i], &region)) {
+      GST_WARNING ("Invalid region \"%s\": expected x,y,w,h or a polygon of "
+          "at least 3 and at most %d x,y points.", items[i],
+          SSCMA_REGION_MAX_POINTS);
+      g_array_unref (regions);
+      regions = NULL;
+      break;
+    }
+    g_array_append_val (regions, region);
+  }
+  g_strfreev (items);
+
+  return regions;
+}
+
+/**
+ * @brief Get the bounding rectangle of a region in frame pixels, clipped to the frame.
+ * @return FALSE if the region does not overlap the frame.
+ */
+gboolean
+sscma_region_get_bounds (const SscmaRegion * region, gint width, gint height,
+    SscmaRect * bounds)
+{
+  gfloat sx = region->normalized ? width : 1.f;
+  gfloat sy = region->normalized ? height : 1.f;
+  gfloat x0 = G_MAXFLOAT, y0 = G_MAXFLOAT, x1 = 0.f, y1 = 0.f;
+  gint ix0, iy0, ix1, iy1;
+  guint i;
+
+  for (i = 0; i < region->n_points; i++) {
+    x0 = MIN (x0, region->x[i] * sx);
+    y0 = MIN (y0, region->y[i] * sy);
+    x1 = MAX (x1, region->x[i] * sx);
+    y1 = MAX (y1, region->y[i] * sy);
+  }
+
+  ix0 = CLAMP ((gint) floorf (x0), 0, width);
+  iy0 = CLAMP ((gint) floorf (y0), 0, height);
+  ix1 = CLAMP ((gint) ceilf (x1), 0, width);
+  iy1 = CLAMP ((gint) ceilf (y1), 0, height);
+  if (ix1 <= ix0 || iy1 <= iy0)
+    return FALSE;
+
+  bounds->x = ix0;
+  bounds->y = iy0;
+  bounds->width = ix1 - ix0;
+  bounds->height = iy1 - iy0;
+  return TRUE;
+}
+
+/**
+ * @brief Check if a point in frame pixels lies inside the region (even-odd rule).
+ */
+gboolean
+sscma_region_contains (const SscmaRegion * region, gint width, gint height,
+    gfloat x, gfloat y)
+{
+  gfloat sx = region->normalized ? width : 1.f;
+  gfloat sy = region->normalized ? height : 1.f;
+  gboolean inside = FALSE;
+  guint i, j;
+
+  if (region->is_rect)
+    return x >= region->x[0] * sx && x < region->x[2] * sx &&
+        y >= region->y[0] * sy && y < region->y[2] * sy;
+
+  for (i = 0, j = region->n_points - 1; i < region->n_points; j = i++) {
+    gfloat xi = region->x[i] * sx, yi = region->y[i] * sy;
+    gfloat xj = region->x[j] * sx, yj = region->y[j] * sy;
+
+    if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi)
+      inside = !inside;
+  }
+  return inside;
+}
@@ -0,0 +1,29 @@
+#ifndef __GST_SSCMA_REGION_H__
+#define __GST_SSCMA_REGION_H__
+
+#include <gst/gst.h>
+#include "preprocess.h"
+
+/** the most vertices a polygon region can have */
+#define SSCMA_REGION_MAX_POINTS (32)
+
+/**
+ * @brief A rectangle or polygon of the frame.
+ * Coordinates are in pixels, or fractions of the frame size if normalized.
+ */
+typedef struct
+{
+  gboolean is_rect; /**< TRUE for "x,y,w,h" regions, stored as their 4 corners */
+  gboolean normalized; /**< TRUE if all coordinates are within [0, 1] */
+  guint n_points; /**< number of vertices */
+  gfloat x[SSCMA_REGION_MAX_POINTS]; /**< vertex x coordinates */
+  gfloat y[SSCMA_REGION_MAX_POINTS]; /**< vertex y coordinates */
+} SscmaRegion;
+
+GArray *sscma_regions_parse (const gchar * str);
+gboolean sscma_region_get_bounds (const SscmaRegion * region, gint width,
+    gint height, SscmaRect * bounds);
+gboolean sscma_region_contains (const SscmaRegion * region, gint width,
+    gint height, gfloat x, gfloat y);
+
+#endif /* __GST_SSCMA_REGION_H__ */
@@ -1,31 +1,6 @@
 #include "tensor_info.h"
 
 
-/**
- * @brief Initialize the tensors layout.
- */
-void
-gst_tensors_layout_init (tensors_layout layout)
-{
-  int i;
-
-  for (i = 0; i < NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT; i++) {
-    layout[i] = _TENOR_LAYOUT_ANY;
-  }
-}
-
-/**
- * @brief Initialize the tensors ranks
- */
-void
-gst_tensors_rank_init (unsigned int ranks[])
-{
-  int i;
-  for (i = 0; i < NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT; ++i) {
-    ranks[i] = 0;
-  }
-}
-
 /**
  * @brief Initialize the tensor info structure
  * @param info tensor info structure to be initialized
@@ -95,8 +70,9 @@ gst_tensors_info_init (GstTensorsInfo * info)
 
   info->num_tensors = 0;
   info->extra = NULL;
+  info->num_extra = 0;
 
-  for (i = 0; i < NNS_TENSOR_SIZE_LIMIT; i++) {
+  for (i = 0; i < NNS_TENSOR_SIZE_INLINE; i++) {
     gst_tensor_info_init (&info->info[i]);
   }
 }
@@ -112,7 +88,7 @@ gst_tensors_info_free (GstTensorsInfo * info)
 
   g_return_if_fail (info != NULL);
 
-  for (i = 0; i < NNS_TENSOR_SIZE_LIMIT; i++) {
+  for (i = 0; i < NNS_TENSOR_SIZE_INLINE; i++) {
     gst_tensor_info_free (&info->info[i]);
   }
 
@@ -242,52 +218,50 @@ gst_tensors_info_is_equal (const GstTensorsInfo * i1, const GstTensorsInfo * i2)
 
 /**
  * @brief Get the pointer of nth tensor information.
+ * @return NULL if nth is not below NNS_TENSOR_SIZE_MAX
  */
 GstTensorInfo *
 gst_tensors_info_get_nth_info (GstTensorsInfo * info, guint nth)
 {
   g_return_val_if_fail (info != NULL, NULL);
 
-  if (nth < NNS_TENSOR_SIZE_LIMIT)
+  if (nth < NNS_TENSOR_SIZE_INLINE)
     return &info->info[nth];
 
-  if (!gst_tensors_info_extra_create (info))
+  if (!gst_tensors_info_extra_reserve (info, nth + 1))
     return NULL;
 
-  if (nth < NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT)
-    return &info->extra[nth - NNS_TENSOR_SIZE_LIMIT];
-
-  g_print ("Failed to get the information, invalid index %u.", nth);
-  return NULL;
+  return &info->extra[nth - NNS_TENSOR_SIZE_INLINE];
 }
 
 /**
- * @brief Allocate and initialize the extra info in given tensors info.
+ * @brief Make room for num_tensors tensors, growing the extra info as needed.
  * @param[in,out] info tensors info to be updated.
+ * @return FALSE if num_tensors is above NNS_TENSOR_SIZE_MAX
  */
 gboolean
-gst_tensors_info_extra_create (GstTensorsInfo * info)
+gst_tensors_info_extra_reserve (GstTensorsInfo * info, guint num_tensors)
 {
-  GstTensorInfo *temp;
-  guint i;
+  guint i, num_extra;
 
   g_return_val_if_fail (info != NULL, FALSE);
 
-  if (info->extra) {
-    return TRUE;
-  }
-
-  temp = g_try_new0 (GstTensorInfo, NNS_TENSOR_SIZE_EXTRA_LIMIT);
-  if (!temp) {
-    g_print ("Failed to allocate memory for extra tensors info");
+  if (num_tensors > NNS_TENSOR_SIZE_MAX) {
+    g_print ("Failed to get the information, invalid index %u.", num_tensors - 1);
     return FALSE;
   }
 
-  for (i = 0; i < NNS_TENSOR_SIZE_EXTRA_LIMIT; ++i) {
-    gst_tensor_info_init (&temp[i]);
-  }
+  if (num_tensors <= NNS_TENSOR_SIZE_INLINE + info->num_extra)
+    return TRUE;
 
-  info->extra = temp;
+  /* grow by doubling, the extra info is never shrunk */
+  num_extra = MAX (num_tensors - NNS_TENSOR_SIZE_INLINE,
+      MIN (info->num_extra * 2, (guint) NNS_TENSOR_SIZE_MAX - NNS_TENSOR_SIZE_INLINE));
+  info->extra = g_renew (GstTensorInfo, info->extra, num_extra);
+  for (i = info->num_extra; i < num_extra; ++i) {
+    gst_tensor_info_init (&info->extra[i]);
+  }
+  info->num_extra = num_extra;
 
   return TRUE;
 }
@@ -304,14 +278,33 @@ gst_tensors_info_extra_free (GstTensorsInfo * info)
   g_return_if_fail (info != NULL);
 
   if (info->extra) {
-    for (i = 0; i < NNS_TENSOR_SIZE_EXTRA_LIMIT; ++i)
+    for (i = 0; i < info->num_extra; ++i)
       gst_tensor_info_free (&info->extra[i]);
 
     g_free (info->extra);
     info->extra = NULL;
+    info->num_extra = 0;
   }
 }
 
+/**
+ * @brief String representations of each tensor element type.
+ */
+static const gchar *tensor_element_typename[] = {
+  [_TENOR_INT32] = "int32",
+  [_TENOR_UINT32] = "uint32",
+  [_TENOR_INT16] = "int16",
+  [_TENOR_UINT16] = "uint16",
+  [_TENOR_INT8] = "int8",
+  [_TENOR_UINT8] = "uint8",
+  [_TENOR_FLOAT64] = "float64",
+  [_TENOR_FLOAT32] = "float32",
+  [_TENOR_INT64] = "int64",
+  [_TENOR_UINT64] = "uint64",
+  [_TENOR_FLOAT16] = "float16",
+  [_TENOR_END] = NULL,
+};
+
 /**
  * @brief Get tensor type from string input.
  * @return Corresponding tensor_type. _TENOR_END if unrecognized value is there.
@@ -320,76 +313,28 @@ gst_tensors_info_extra_free (GstTensorsInfo * info)
 tensor_type
 gst_tensor_get_type (const gchar * typestr)
 {
-  gsize size, len;
-  gchar *type_string;
-  tensor_type type = _TENOR_END;
+  const gchar *end;
+  gsize len;
+  guint type;
 
   if (typestr == NULL)
     return _TENOR_END;
 
-  /* remove spaces */
-  type_string = g_strdup (typestr);
-  g_strstrip (type_string);
-
-  len = strlen (type_string);
-
-  if (len == 0) {
-    g_free (type_string);
-    return _TENOR_END;
+  /* ignore the surrounding spaces without copying the string */
+  while (g_ascii_isspace (*typestr))
+    typestr++;
+  end = typestr + strlen (typestr);
+  while (end > typestr && g_ascii_isspace (end[-1]))
+    end--;
+  len = end - typestr;
+
+  for (type = 0; type < _TENOR_END; type++) {
+    if (strlen (tensor_element_typename[type]) == len &&
+        g_ascii_strncasecmp (typestr, tensor_element_typename[type], len) == 0)
+      return (tensor_type) type;
   }
 
-  if (g_regex_match_simple ("^uint(8|16|32|64)$",
-          type_string, G_REGEX_CASELESS, 0)) {
-    size = (gsize) g_ascii_strtoull (&type_string[4], NULL, 10);
-
-    switch (size) {
-      case 8:
-        type = _TENOR_UINT8;
-        break;
-      case 16:
-        type = _TENOR_UINT16;
-        break;
-      case 32:
-        type = _TENOR_UINT32;
-        break;
-      case 64:
-        type = _TENOR_UINT64;
-    }
-  } else if (g_regex_match_simple ("^int(8|16|32|64)$",
-          type_string, G_REGEX_CASELESS, 0)) {
-    size = (gsize) g_ascii_strtoull (&type_string[3], NULL, 10);
-
-    switch (size) {
-      case 8:
-        type = _TENOR_INT8;
-        break;
-      case 16:
-        type = _TENOR_INT16;
-        break;
-      case 32:
-        type = _TENOR_INT32;
-        break;
-      case 64:
-        type = _TENOR_INT64;
-    }
-  } else if (g_regex_match_simple ("^float(16|32|64)$",
-          type_string, G_REGEX_CASELESS, 0)) {
-    size = (gsize) g_ascii_strtoull (&type_string[5], NULL, 10);
-
-    switch (size) {
-      case 16:
-        type = _TENOR_FLOAT16;
-        break;
-      case 32:
-        type = _TENOR_FLOAT32;
-        break;
-      case 64:
-        type = _TENOR_FLOAT64;
-    }
-  }
-
-  g_free (type_string);
-  return type;
+  return _TENOR_END;
 }
 
 /**
@@ -414,15 +359,14 @@ gst_tensors_info_parse_types_string (GstTensorsInfo * info,
     str_types = g_strsplit_set (type_string, ",.", -1);
     num_types = g_strv_length (str_types);
 
-    if (num_types > NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT) {
+    if (num_types > NNS_TENSOR_SIZE_MAX) {
       g_print ("Invalid param, types (%d) max (%d)\n",
-          num_types, NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT);
+          num_types, NNS_TENSOR_SIZE_MAX);
 
-      num_types = NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT;
+      num_types = NNS_TENSOR_SIZE_MAX;
     }
 
-    if (num_types >= NNS_TENSOR_SIZE_LIMIT)
-      gst_tensors_info_extra_create (info);
+    gst_tensors_info_extra_reserve (info, num_types);
 
     for (i = 0; i < num_types; i++) {
       _info = gst_tensors_info_get_nth_info (info, i);
@@ -499,6 +443,7 @@ gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim)
   guint64 val;
   gchar **strv;
   gchar *dim_string;
+  gchar *end;
   guint i, num_dims;
 
   /* 0-init */
@@ -512,15 +457,27 @@ gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim)
   dim_string = g_strdup (dimstr);
   g_strstrip (dim_string);
 
-  strv = g_strsplit (dim_string, ":", NNS_TENSOR_RANK_LIMIT);
+  strv = g_strsplit (dim_string, ":", -1);
   num_dims = g_strv_length (strv);
 
+  if (num_dims > NNS_TENSOR_RANK_LIMIT) {
+    g_print ("Invalid dimension string %s, max rank is %d.\n", dimstr,
+        NNS_TENSOR_RANK_LIMIT);
+    num_dims = NNS_TENSOR_RANK_LIMIT;
+  }
+
   for (i = 0; i < num_dims; i++) {
     g_strstrip (strv[i]);
-    if (strv[i] == NULL || strlen (strv[i]) == 0)
+    if (strlen (strv[i]) == 0)
       break;
 
-    val = g_ascii_strtoull (strv[i], NULL, 10);
+    /* reject negative, zero, non-numeric and out of range dimensions */
+    val = g_ascii_strtoull (strv[i], &end, 10);
+    if (strv[i][0] == '-' || *end != '\0' || val == 0 || val > G_MAXUINT32) {
+      g_print ("Invalid dimension %s in %s.\n", strv[i], dimstr);
+      break;
+    }
+
     dim[i] = (uint32_t) val;
     rank = i + 1;
   }
@@ -530,6 +487,220 @@ gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim)
   return rank;
 }
 
+/**
+ * @brief Get type string of tensor type.
+ * @return The string of tensor type, NULL if the type is invalid.
+ */
+const gchar *
+gst_tensor_get_type_string (tensor_type type)
+{
+  g_return_val_if_fail (type >= 0 && type <= _TENOR_END, NULL);
+
+  return tensor_element_typename[type];
+}
+
+/**
+ * @brief Get dimension string from given tensor dimension.
+ * @param dim tensor dimension
+ * @return Formatted string of given dimension (d1:d2:d3:...). The returned value should be freed with g_free()
+ */
+gchar *
+gst_tensor_get_dimension_string (const tensor_dim dim)
+{
+  guint i, rank;
+  GString *dim_str;
+
+  rank = gst_tensor_dimension_get_rank (dim);
+  dim_str = g_string_new (NULL);
+
+  for (i = 0; i < rank; i++) {
+    if (i > 0)
+      g_string_append (dim_str, ":");
+    g_string_append_printf (dim_str, "%u", dim[i]);
+  }
+
+  return g_string_free (dim_str, FALSE);
+}
+
+/**
+ * @brief Get the string of dimensions in tensors info
+ * @param info tensors info structure
+ * @return string of dimensions separated with ','. The returned value should be freed with g_free()
+ */
+gchar *
+gst_tensors_info_get_dimensions_string (const GstTensorsInfo * info)
+{
+  GString *dimensions;
+  guint i;
+
+  g_return_val_if_fail (info != NULL, NULL);
+
+  dimensions = g_string_new (NULL);
+  for (i = 0; i < info->num_tensors; i++) {
+    GstTensorInfo *_info =
+        gst_tensors_info_get_nth_info ((GstTensorsInfo *) info, i);
+    gchar *dim_str = gst_tensor_get_dimension_string (_info->dimension);
+
+    if (i > 0)
+      g_string_append (dimensions, ",");
+    g_string_append (dimensions, dim_str);
+    g_free (dim_str);
+  }
+
+  return g_string_free (dimensions, FALSE);
+}
+
+/**
+ * @brief Get the string of types in tensors info
+ * @param info tensors info structure
+ * @return string of types separated with ','. The returned value should be freed with g_free()
+ */
+gchar *
+gst_tensors_info_get_types_string (const GstTensorsInfo * info)
+{
+  GString *types;
+  guint i;
+
+  g_return_val_if_fail (info != NULL, NULL);
+
+  types = g_string_new (NULL);
+  for (i = 0; i < info->num_tensors; i++) {
+    GstTensorInfo *_info =
+        gst_tensors_info_get_nth_info ((GstTensorsInfo *) info, i);
+
+    if (i > 0)
+      g_string_append (types, ",");
+    g_string_append (types, GST_STR_NULL (gst_tensor_get_type_string (_info->type)));
+  }
+
+  return g_string_free (types, FALSE);
+}
+
+/**
+ * @brief Get static other/tensors caps from tensors info
+ * @param info tensors info structure
+ * @param rate_n framerate numerator
+ * @param rate_d framerate denominator, 0 or less to leave the framerate out
+ * @return caps of the tensors, NULL if the info is invalid
+ */
+GstCaps *
+gst_tensors_info_get_caps (const GstTensorsInfo * info, gint rate_n,
+    gint rate_d)
+{
+  GstCaps *caps;
+  gchar *dimensions, *types;
+
+  g_return_val_if_fail (info != NULL, NULL);
+
+  if (!gst_tensors_info_validate (info))
+    return NULL;
+
+  dimensions = gst_tensors_info_get_dimensions_string (info);
+  types = gst_tensors_info_get_types_string (info);
+  caps = gst_caps_new_simple (NNS_MIMETYPE_TENSORS,
+      "format", G_TYPE_STRING, "static",
+      "num_tensors", G_TYPE_INT, (gint) info->num_tensors,
+      "dimensions", G_TYPE_STRING, dimensions,
+      "types", G_TYPE_STRING, types, NULL);
+  if (rate_d > 0)
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION, rate_n, rate_d,
+        NULL);
+
+  g_free (dimensions);
+  g_free (types);
+  return caps;
+}
+
+/**
+ * @brief Parse the string of dimensions
+ * @param info tensors info structure
+ * @param dim_string string of dimensions
+ * @return number of parsed dimensions
+ */
+guint
+gst_tensors_info_parse_dimensions_string (GstTensorsInfo * info,
+    const gchar * dim_string)
+{
+  guint num_dims = 0;
+
+  g_return_val_if_fail (info != NULL, 0);
+
+  if (dim_string) {
+    guint i;
+    gchar **str_dims;
+
+    str_dims = g_strsplit_set (dim_string, ",.", -1);
+    num_dims = g_strv_length (str_dims);
+
+    if (num_dims > NNS_TENSOR_SIZE_MAX) {
+      g_print ("Invalid param, dimensions (%d) max (%d)\n",
+          num_dims, NNS_TENSOR_SIZE_MAX);
+      num_dims = NNS_TENSOR_SIZE_MAX;
+    }
+
+    gst_tensors_info_extra_reserve (info, num_dims);
+
+    for (i = 0; i < num_dims; i++) {
+      GstTensorInfo *_info = gst_tensors_info_get_nth_info (info, i);
+      gst_tensor_parse_dimension (str_dims[i], _info->dimension);
+    }
+
+    g_strfreev (str_dims);
+  }
+
+  return num_dims;
+}
+
+/**
+ * @brief Get tensors info from static other/tensors caps
+ * @param info tensors info structure to be filled
+ * @param caps fixed caps
+ * @return TRUE if the caps carry num_tensors, dimensions and types that agree
+ */
+gboolean
+gst_tensors_info_from_caps (GstTensorsInfo * info, const GstCaps * caps)
+{
+  GstStructure *structure;
+  const gchar *format;
+  gint num_tensors = 0;
+  guint num_dims, num_types;
+
+  g_return_val_if_fail (info != NULL, FALSE);
+  g_return_val_if_fail (caps != NULL, FALSE);
+
+  gst_tensors_info_init (info);
+
+  structure = gst_caps_get_structure (caps, 0);
+  if (!gst_structure_has_name (structure, NNS_MIMETYPE_TENSORS))
+    return FALSE;
+
+  format = gst_structure_get_string (structure, "format");
+  if (format && g_strcmp0 (format, "static") != 0) {
+    g_print ("Only static tensors are supported, the given format is %s.\n",
+        format);
+    return FALSE;
+  }
+
+  if (!gst_structure_get_int (structure, "num_tensors", &num_tensors) ||
+      num_tensors < 1 ||
+      num_tensors > NNS_TENSOR_SIZE_MAX)
+    return FALSE;
+  info->num_tensors = (guint) num_tensors;
+
+  num_dims = gst_tensors_info_parse_dimensions_string (info,
+      gst_structure_get_string (structure, "dimensions"));
+  num_types = gst_tensors_info_parse_types_string (info,
+      gst_structure_get_string (structure, "types"));
+
+  if (num_dims != info->num_tensors || num_types != info->num_tensors) {
+    g_print ("The number of tensors (%u) does not match dimensions (%u) and types (%u).\n",
+        info->num_tensors, num_dims, num_types);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 uint8_t rasters[][13] = {
 {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
 {0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
@@ -23,9 +23,16 @@
 #define NNS_TENSOR_SIZE_LIMIT	(16)
 #define NNS_TENSOR_SIZE_LIMIT_STR	"16"
 #define NNS_TENSOR_SIZE_EXTRA_LIMIT (240)
+/** tensors stored in GstTensorsInfo itself, the others are allocated on demand */
+#define NNS_TENSOR_SIZE_INLINE (4)
+/** the most tensors a GstTensorsInfo can describe */
+#define NNS_TENSOR_SIZE_MAX (NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT)
 
 typedef uint32_t tensor_dim[NNS_TENSOR_RANK_LIMIT];
 
+/** media type of a stream of tensors */
+#define NNS_MIMETYPE_TENSORS "other/tensors"
+
 /**
  * @brief If the given string is NULL, print "(NULL)". Copied from `GST_STR_NULL`
  */
@@ -83,8 +90,6 @@ typedef enum _tensor_layout
   _TENOR_LAYOUT_NONE,        /**< NONE: none of the above defined layouts */
 } tensor_layout;
 
-typedef tensor_layout tensors_layout[NNS_TENSOR_SIZE_LIMIT + NNS_TENSOR_SIZE_EXTRA_LIMIT];
-
 /**
  * @brief Internal data structure for tensor info.
  * @note This must be coherent with api/capi/include/nnstreamer-capi-private.h:ml_tensor_info_s
@@ -100,13 +105,15 @@ typedef struct
 
 /**
  * @brief Internal meta data exchange format for a other/tensors instance
- * @note This must be coherent with api/capi/include/nnstreamer-capi-private.h:ml_tensors_info_s
+ * @note Only the first NNS_TENSOR_SIZE_INLINE tensors are stored inline, get
+ * the others with gst_tensors_info_get_nth_info().
  */
 typedef struct
 {
   unsigned int num_tensors; /**< The number of tensors */
-  GstTensorInfo info[NNS_TENSOR_SIZE_LIMIT]; /**< The list of tensor info */
-  GstTensorInfo *extra; /**< The list of tensor info for tensors whose idx is larger than NNS_TENSOR_SIZE_LIMIT */
+  GstTensorInfo info[NNS_TENSOR_SIZE_INLINE]; /**< The first tensors */
+  GstTensorInfo *extra; /**< The tensors from NNS_TENSOR_SIZE_INLINE on, NULL until one is needed */
+  unsigned int num_extra; /**< The number of tensors allocated in extra */
 } GstTensorsInfo;
 
 /**
@@ -155,14 +162,23 @@ gboolean gst_tensors_info_validate (const GstTensorsInfo * info);
 gboolean gst_tensors_info_is_equal (const GstTensorsInfo * i1, const GstTensorsInfo * i2);
 
 GstTensorInfo * gst_tensors_info_get_nth_info (GstTensorsInfo * info, guint nth);
-gboolean gst_tensors_info_extra_create (GstTensorsInfo * info);
+gboolean gst_tensors_info_extra_reserve (GstTensorsInfo * info, guint num_tensors);
 void gst_tensors_info_extra_free (GstTensorsInfo * info);
 guint gst_tensors_info_parse_types_string (GstTensorsInfo * info, const gchar * type_string);
 guint gst_tensor_dimension_get_rank (const tensor_dim dim);
 gboolean gst_tensor_dimension_is_valid (const tensor_dim dim);
 guint gst_tensor_parse_dimension (const gchar * dimstr, tensor_dim dim);
-void gst_tensors_layout_init (tensors_layout layout);
-void gst_tensors_rank_init (unsigned int ranks[]);
+tensor_type gst_tensor_get_type (const gchar * typestr);
+const gchar *gst_tensor_get_type_string (tensor_type type);
+gchar *gst_tensor_get_dimension_string (const tensor_dim dim);
+gchar *gst_tensors_info_get_dimensions_string (const GstTensorsInfo * info);
+gchar *gst_tensors_info_get_types_string (const GstTensorsInfo * info);
+guint gst_tensors_info_parse_dimensions_string (GstTensorsInfo * info,
+    const gchar * dim_string);
+gboolean gst_tensors_info_from_caps (GstTensorsInfo * info,
+    const GstCaps * caps);
+GstCaps *gst_tensors_info_get_caps (const GstTensorsInfo * info, gint rate_n,
+    gint rate_d);
 
 /**
  * raster[ch][12] is the top pixels
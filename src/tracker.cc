@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include "gstsscmayolov5.h"
+#include "tracker.h"
+
+/** minimum IoU to match a confident detection to a track */
+#define SSCMA_TRACK_MATCH_IOU (0.2f)
+/** low score detections must overlap their track more to be trusted */
+#define SSCMA_TRACK_LOW_MATCH_IOU (0.4f)
+/** weight of the newest observation in the velocity estimate */
+#define SSCMA_TRACK_VELOCITY_GAIN (0.5f)
+
+/**
+ * @brief One tracked object, predicted with a constant velocity model.
+ */
+typedef struct
+{
+  gint id; /**< persistent id handed out to the detections */
+  gint class_id; /**< tracks only match detections of the same class */
+  gint model_id; /**< and of the same detector */
+  gfloat cx, cy, w, h; /**< predicted box, centre and size */
+  gfloat vx, vy; /**< centre velocity in pixels per frame */
+  guint missed; /**< frames since the last matching detection */
+} SscmaTrack;
+
+/**
+ * @brief A candidate track/detection pair of the cost matrix.
+ */
+typedef struct
+{
+  gfloat iou;
+  guint track;
+  guint det;
+} SscmaTrackPair;
+
+struct _SscmaTracker
+{
+  SscmaTrack *tracks;
+  guint n_tracks;
+  guint tracks_size; /**< allocated tracks */
+  gint next_id;
+
+  /* scratch space kept across frames so a frame allocates nothing */
+  SscmaTrackPair *pairs;
+  guint pairs_size;
+  gboolean *track_matched;
+  gboolean *det_matched;
+  guint det_size;
+};
+
+/**
+ * @brief Create an empty tracker.
+ */
+SscmaTracker *
+sscma_tracker_new (void)
+{
+  return g_new0 (SscmaTracker, 1);
+}
+
+/**
+ * @brief Free the tracker.
+ */
+void
+sscma_tracker_free (SscmaTracker * tracker)
+{
+  if (tracker == NULL)
+    return;
+
+  g_free (tracker->tracks);
+  g_free (tracker->pairs);
+  g_free (tracker->track_matched);
+  g_free (tracker->det_matched);
+  g_free (tracker);
+}
+
+/**
+ * @brief Drop all tracks (e.g., on a new stream), ids start again from 0.
+ */
+void
+sscma_tracker_reset (SscmaTracker * tracker)
+{
+  tracker->n_tracks = 0;
+  tracker->next_id = 0;
+}
+
+/**
+ * @brief Get the number of live (matched or recently lost) tracks.
+ */
+guint
+sscma_tracker_get_n_tracks (const SscmaTracker * tracker)
+{
+  return tracker->n_tracks;
+}
+
+static gfloat
+sscma_track_iou (const SscmaTrack * t, const detectedObject * d)
+{
+  gfloat x1 = MAX (t->cx - t->w / 2.f, (gfloat) d->x);
+  gfloat y1 = MAX (t->cy - t->h / 2.f, (gfloat) d->y);
+  gfloat x2 = MIN (t->cx + t->w / 2.f, (gfloat) (d->x + d->width));
+  gfloat y2 = MIN (t->cy + t->h / 2.f, (gfloat) (d->y + d->height));
+  gfloat inter, uni;
+
+  if (x2 <= x1 || y2 <= y1)
+    return 0.f;
+  inter = (x2 - x1) * (y2 - y1);
+  uni = t->w * t->h + (gfloat) d->width * d->height - inter;
+  return uni > 0.f ? inter / uni : 0.f;
+}
+
+static gint
+sscma_track_pair_compare (const void *_a, const void *_b)
+{
+  const SscmaTrackPair *a = (const SscmaTrackPair *) _a;
+  const SscmaTrackPair *b = (const SscmaTrackPair *) _b;
+
+  /* best overlap first */
+  return (a->iou > b->iou) ? -1 : ((a->iou < b->iou) ? 1 : 0);
+}
+
+/**
+ * @brief Make sure the scratch space fits n_dets detections and the tracks.
+ */
+static void
+sscma_tracker_reserve (SscmaTracker * tracker, guint n_dets)
+{
+  guint n_tracks = tracker->n_tracks + n_dets;
+
+  if (n_tracks > tracker->tracks_size) {
+    tracker->tracks_size = MAX (n_tracks, 2 * tracker->tracks_size);
+    tracker->tracks = g_renew (SscmaTrack, tracker->tracks,
+        tracker->tracks_size);
+    tracker->track_matched = g_renew (gboolean, tracker->track_matched,
+        tracker->tracks_size);
+  }
+  if (n_dets > tracker->det_size) {
+    tracker->det_size = MAX (n_dets, 2 * tracker->det_size);
+    tracker->det_matched = g_renew (gboolean, tracker->det_matched,
+        tracker->det_size);
+  }
+  if ((gsize) tracker->n_tracks * n_dets > tracker->pairs_size) {
+    tracker->pairs_size = MAX (tracker->n_tracks * n_dets,
+        2 * tracker->pairs_size);
+    tracker->pairs = g_renew (SscmaTrackPair, tracker->pairs,
+        tracker->pairs_size);
+  }
+}
+
+/**
+ * @brief Greedily match the unmatched tracks to the unmatched detections
+ * scoring in [min_prob, max_prob), best overlap first.
+ */
+static void
+sscma_tracker_match (SscmaTracker * tracker, GArray * results,
+    gfloat min_prob, gfloat max_prob, gfloat min_iou)
+{
+  guint n_pairs = 0, i, j;
+
+  for (i = 0; i < tracker->n_tracks; i++) {
+    const SscmaTrack *t = &tracker->tracks[i];
+
+    if (tracker->track_matched[i])
+      continue;
+    for (j = 0; j < results->len; j++) {
+      const detectedObject *d = &g_array_index (results, detectedObject, j);
+      gfloat iou;
+
+      if (tracker->det_matched[j] || d->class_id != t->class_id ||
+          d->model_id != t->model_id || d->prob < min_prob ||
+          d->prob >= max_prob)
+        continue;
+      iou = sscma_track_iou (t, d);
+      if (iou >= min_iou) {
+        tracker->pairs[n_pairs].iou = iou;
+        tracker->pairs[n_pairs].track = i;
+        tracker->pairs[n_pairs].det = j;
+        n_pairs++;
+      }
+    }
+  }
+
+  qsort (tracker->pairs, n_pairs, sizeof (SscmaTrackPair),
+      sscma_track_pair_compare);
+
+  for (i = 0; i < n_pairs; i++) {
+    const SscmaTrackPair *p = &tracker->pairs[i];
+    SscmaTrack *t = &tracker->tracks[p->track];
+    detectedObject *d = &g_array_index (results, detectedObject, p->det);
+    gfloat cx, cy;
+
+    if (tracker->track_matched[p->track] || tracker->det_matched[p->det])
+      continue;
+    tracker->track_matched[p->track] = TRUE;
+    tracker->det_matched[p->det] = TRUE;
+
+    /* t->cx/cy are predicted, so the error corrects the velocity */
+    cx = d->x + d->width / 2.f;
+    cy = d->y + d->height / 2.f;
+    t->vx += SSCMA_TRACK_VELOCITY_GAIN * (cx - t->cx) / (t->missed + 1);
+    t->vy += SSCMA_TRACK_VELOCITY_GAIN * (cy - t->cy) / (t->missed + 1);
+    t->cx = cx;
+    t->cy = cy;
+    t->w = d->width;
+    t->h = d->height;
+    t->missed = 0;
+    d->tracking_id = t->id;
+  }
+}
+
+/**
+ * @brief Associate the detections of a frame with the tracks (ByteTrack-style)
+ * and set their tracking_id.
+ * Confident detections (prob >= high_threshold) are matched first; the tracks
+ * left over then get a chance with the low score ones, which keeps occluded
+ * or blurred objects tracked. Low score detections matching no track are
+ * removed from results, unmatched confident ones start new tracks.
+ * @param results detectedObject array, sorted by score as nms() leaves it.
+ * @param max_age Frames a track survives without a matching detection.
+ * @return The number of detections left in results.
+ */
+guint
+sscma_tracker_update (SscmaTracker * tracker, GArray * results,
+    gfloat high_threshold, guint max_age)
+{
+  guint i, j;
+
+  g_return_val_if_fail (tracker != NULL && results != NULL, 0);
+
+  sscma_tracker_reserve (tracker, results->len);
+
+  /* predict where the tracks are now */
+  for (i = 0; i < tracker->n_tracks; i++) {
+    SscmaTrack *t = &tracker->tracks[i];
+
+    t->cx += t->vx;
+    t->cy += t->vy;
+    t->missed++;
+    tracker->track_matched[i] = FALSE;
+  }
+  for (j = 0; j < results->len; j++)
+    tracker->det_matched[j] = FALSE;
+
+  sscma_tracker_match (tracker, results, high_threshold, G_MAXFLOAT,
+      SSCMA_TRACK_MATCH_IOU);
+  sscma_tracker_match (tracker, results, -G_MAXFLOAT, high_threshold,
+      SSCMA_TRACK_LOW_MATCH_IOU);
+
+  /* drop the tracks lost for too long, keeping the order */
+  for (i = 0, j = 0; i < tracker->n_tracks; i++) {
+    if (tracker->tracks[i].missed > max_age)
+      continue;
+    if (i != j)
+      tracker->tracks[j] = tracker->tracks[i];
+    j++;
+  }
+  tracker->n_tracks = j;
+
+  /* new tracks for the confident leftovers, low score leftovers are noise */
+  for (i = 0, j = 0; i < results->len; i++) {
+    detectedObject *d = &g_array_index (results, detectedObject, i);
+
+    if (!tracker->det_matched[i]) {
+      SscmaTrack *t;
+
+      if (d->prob < high_threshold)
+        continue;
+      t = &tracker->tracks[tracker->n_tracks++];
+      t->id = tracker->next_id;
+      tracker->next_id = (tracker->next_id + 1) & G_MAXINT;
+      t->class_id = d->class_id;
+      t->model_id = d->model_id;
+      t->cx = d->x + d->width / 2.f;
+      t->cy = d->y + d->height / 2.f;
+      t->w = d->width;
+      t->h = d->height;
+      t->vx = t->vy = 0.f;
+      t->missed = 0;
+      d->tracking_id = t->id;
+    }
+    if (i != j)
+      g_array_index (results, detectedObject, j) = *d;
+    j++;
+  }
+  g_array_set_size (results, j);
+
+  return j;
+}
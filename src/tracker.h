@@ -0,0 +1,15 @@
+#ifndef __GST_SSCMA_TRACKER_H__
+#define __GST_SSCMA_TRACKER_H__
+
+#include <gst/gst.h>
+
+typedef struct _SscmaTracker SscmaTracker;
+
+SscmaTracker *sscma_tracker_new (void);
+void sscma_tracker_free (SscmaTracker * tracker);
+void sscma_tracker_reset (SscmaTracker * tracker);
+guint sscma_tracker_update (SscmaTracker * tracker, GArray * results,
+    gfloat high_threshold, guint max_age);
+guint sscma_tracker_get_n_tracks (const SscmaTracker * tracker);
+
+#endif /* __GST_SSCMA_TRACKER_H__ */
@@ -0,0 +1,156 @@
+/**
+ * Benchmark of the decoders of src/decoder.cc against the runtime loop they
+ * replaced, on a synthetic 6300-anchor output with about 1% of the anchors
+ * above the threshold. The detections must be identical, the run fails
+ * otherwise.
+ *
+ * meson test -C build --benchmark [--verbose]
+ * decoder_benchmark [iterations]
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "decoder.h"
+
+#define BENCH_ANCHORS (6300)
+#define BENCH_THRESHOLD (2500.f)
+#define BENCH_ITERATIONS (200)
+
+/**
+ * @brief The decode loop of the element before the decoders were
+ * specialized: class count, layout and stride known at runtime only.
+ */
+static void
+reference_decode (const gfloat * data, SscmaOutputLayout layout,
+    const SscmaDecodeParams * p, GArray * candidates)
+{
+  const guint n = p->n_anchors;
+  const guint stride = p->n_classes + SSCMA_DECODER_BOX_INFO;
+  /* distance between the values of an anchor, and between anchors */
+  const gsize step = layout == SSCMA_OUTPUT_LAYOUT_NC ? 1 : n;
+  const gsize anchor_step = layout == SSCMA_OUTPUT_LAYOUT_NC ? stride : 1;
+  guint a, i;
+
+  for (a = 0; a < n; a++) {
+    const gfloat *v = data + a * anchor_step;
+    gfloat max_val = 0.f;
+    guint max_index = 0;
+
+    for (i = SSCMA_DECODER_BOX_INFO; i < stride; i++) {
+      if (v[i * step] > max_val) {
+        max_val = v[i * step];
+        max_index = i;
+      }
+    }
+    if (max_index && max_val * v[4 * step] > p->conf_threshold) {
+      SscmaCandidate c = { v[0], v[step], v[2 * step], v[3 * step],
+        max_val * v[4 * step], max_index - SSCMA_DECODER_BOX_INFO
+      };
+      g_array_append_val (candidates, c);
+    }
+  }
+}
+
+/**
+ * @brief A 0..50 output with every 97th anchor a confident detection, in
+ * both layouts.
+ */
+static void
+make_output (guint n_classes, std::vector < gfloat > &nc,
+    std::vector < gfloat > &cn)
+{
+  const guint stride = n_classes + SSCMA_DECODER_BOX_INFO;
+  guint a, i;
+
+  nc.resize ((gsize) BENCH_ANCHORS * stride);
+  cn.resize (nc.size ());
+  srand (1);
+  for (i = 0; i < nc.size (); i++)
+    nc[i] = (gfloat) (rand () % 50);
+  for (a = 0; a < BENCH_ANCHORS; a += 97) {
+    nc[(gsize) a * stride + 4] = 200.f;
+    nc[(gsize) a * stride + SSCMA_DECODER_BOX_INFO + a % n_classes] = 100.f;
+  }
+  for (a = 0; a < BENCH_ANCHORS; a++)
+    for (i = 0; i < stride; i++)
+      cn[(gsize) i * BENCH_ANCHORS + a] = nc[(gsize) a * stride + i];
+}
+
+/**
+ * @brief Time one decoder, in microseconds per output.
+ */
+static gdouble
+time_decoder (SscmaDecodeFunc decode, const gfloat * data,
+    SscmaOutputLayout layout, const SscmaDecodeParams * p, guint iterations,
+    GArray * candidates)
+{
+  gint64 t0 = g_get_monotonic_time ();
+  guint k;
+
+  for (k = 0; k < iterations; k++) {
+    g_array_set_size (candidates, 0);
+    if (decode)
+      decode (data, p, candidates);
+    else
+      reference_decode (data, layout, p, candidates);
+  }
+  return (gdouble) (g_get_monotonic_time () - t0) / iterations;
+}
+
+int
+main (int argc, char **argv)
+{
+  /* the specialized counts, and 7 for the generic fallback */
+  static const guint class_counts[] = { 1, 2, 3, 7, 10, 20, 80 };
+  static const SscmaOutputLayout layouts[] =
+      { SSCMA_OUTPUT_LAYOUT_NC, SSCMA_OUTPUT_LAYOUT_CN };
+  guint iterations = argc > 1 ? (guint) atoi (argv[1]) : BENCH_ITERATIONS;
+  GArray *expected = g_array_new (FALSE, FALSE, sizeof (SscmaCandidate));
+  GArray *candidates = g_array_new (FALSE, FALSE, sizeof (SscmaCandidate));
+  gboolean ok = TRUE;
+  guint c, l;
+
+  if (iterations == 0)
+    iterations = BENCH_ITERATIONS;
+  g_print ("%-8s %-6s %12s %12s %8s\n", "classes", "layout", "loop (us)",
+      "decoder (us)", "speedup");
+
+  for (c = 0; c < G_N_ELEMENTS (class_counts); c++) {
+    std::vector < gfloat > nc, cn;
+    SscmaDecodeParams p;
+
+    memset (&p, 0, sizeof (p));
+    p.n_anchors = BENCH_ANCHORS;
+    p.n_classes = class_counts[c];
+    p.conf_threshold = BENCH_THRESHOLD;
+    p.scale = 1.f;
+    make_output (p.n_classes, nc, cn);
+
+    for (l = 0; l < G_N_ELEMENTS (layouts); l++) {
+      const gfloat *data = layouts[l] == SSCMA_OUTPUT_LAYOUT_NC ?
+          nc.data () : cn.data ();
+      SscmaDecodeFunc decode = sscma_decoder_select (layouts[l],
+          _TENOR_FLOAT32, p.n_classes);
+      gdouble loop_us, decoder_us;
+
+      loop_us = time_decoder (NULL, data, layouts[l], &p, iterations,
+          expected);
+      decoder_us = time_decoder (decode, data, layouts[l], &p, iterations,
+          candidates);
+      if (candidates->len != expected->len ||
+          memcmp (candidates->data, expected->data,
+              candidates->len * sizeof (SscmaCandidate)) != 0) {
+        g_print ("%u classes, %s: the decoder found other detections\n",
+            p.n_classes, layouts[l] == SSCMA_OUTPUT_LAYOUT_NC ? "nc" : "cn");
+        ok = FALSE;
+      }
+      g_print ("%-8u %-6s %12.1f %12.1f %7.2fx\n", p.n_classes,
+          layouts[l] == SSCMA_OUTPUT_LAYOUT_NC ? "nc" : "cn", loop_us,
+          decoder_us, loop_us / MAX (decoder_us, 0.1));
+    }
+  }
+
+  g_array_free (expected, TRUE);
+  g_array_free (candidates, TRUE);
+  return ok ? 0 : 1;
+}
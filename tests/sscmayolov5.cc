@@ -0,0 +1,808 @@
+/**
+ * Regression tests of the sscma_yolov5 element.
+ *
+ * The model is generated by each test: a MemoryData layer holding the raw
+ * output, so the detections of a frame are known whatever the pixels are.
+ * The frames are 4 times the model input, so every box is scaled by 4.
+ * The preprocessing kernels are checked on their own, against the pixels.
+ */
+#include <math.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include "tensor_info.h"
+#include "preprocess.h"
+
+#define MODEL_SIZE 32
+#define FRAME_SIZE 128
+#define N_CLASSES 2
+#define N_VALUES (N_CLASSES + 5)
+
+/** a row of the model output: cx, cy, w, h, objectness, class scores */
+typedef gfloat TestAnchor[N_VALUES];
+
+/** class 0 and class 1 box colors of the overlay palette (RGB) */
+static const guint8 class_colors[N_CLASSES][3] = {
+  {0xFF, 0x38, 0x38},
+  {0xFF, 0x9D, 0x97},
+};
+
+static const TestAnchor golden_anchors[] = {
+  /* class 0, drawn at 16..48 */
+  {8, 8, 8, 8, 0.9f, 0.9f, 0.1f},
+  /* overlaps the first one with a lower score, suppressed by NMS */
+  {9, 9, 8, 8, 0.9f, 0.8f, 0.1f},
+  /* class 1, the last score column, drawn at 80..112 */
+  {24, 24, 8, 8, 0.9f, 0.1f, 0.9f},
+  /* below the confidence threshold */
+  {24, 8, 8, 8, 0.1f, 0.9f, 0.1f},
+  /* only touches the first box, which is no overlap */
+  {16, 8, 8, 8, 0.9f, 0.7f, 0.1f},
+};
+
+static gchar *test_dir;
+
+/**
+ * @brief Write name.param and name.bin, a net whose output blob holds the
+ * given anchors.
+ */
+static void
+write_net (const gchar * name, const gchar * input, const gchar * output,
+    const TestAnchor * anchors, guint n_anchors, gchar ** bin, gchar ** param)
+{
+  gchar *file, *contents;
+
+  file = g_strdup_printf ("%s.param", name);
+  *param = g_build_filename (test_dir, file, NULL);
+  g_free (file);
+  file = g_strdup_printf ("%s.bin", name);
+  *bin = g_build_filename (test_dir, file, NULL);
+  g_free (file);
+
+  contents = g_strdup_printf ("7767517\n2 2\n"
+      "Input %s 0 1 %s 0=%d 1=%d 2=3\n"
+      "MemoryData %s 0 1 %s 0=%d 1=%u\n", input, input, MODEL_SIZE,
+      MODEL_SIZE, output, output, N_VALUES, n_anchors);
+  fail_unless (g_file_set_contents (*param, contents, -1, NULL));
+  g_free (contents);
+  fail_unless (g_file_set_contents (*bin, (const gchar *) anchors,
+          sizeof (TestAnchor) * n_anchors, NULL));
+}
+
+/**
+ * @brief Write a model whose output is the given anchors, and its labels.
+ * @return The model property of the element.
+ */
+static gchar *
+write_model (const TestAnchor * anchors, guint n_anchors)
+{
+  gchar *param, *bin, *labels, *model;
+
+  write_net ("model", "in0", "out0", anchors, n_anchors, &bin, &param);
+  labels = g_build_filename (test_dir, "labels.txt", NULL);
+  fail_unless (g_file_set_contents (labels, "a\nb\n", -1, NULL));
+
+  model = g_strdup_printf ("model=%s,%s labels=%s input=3:%d:%d "
+      "output=%d:%u:1:1", bin, param, labels, MODEL_SIZE, MODEL_SIZE,
+      N_VALUES, n_anchors);
+  g_free (param);
+  g_free (bin);
+  g_free (labels);
+  return model;
+}
+
+/**
+ * @brief A harness around the element running the given model on frames of
+ * the given format.
+ */
+static GstHarness *
+new_harness_format (const TestAnchor * anchors, guint n_anchors,
+    const gchar * extra, const gchar * format)
+{
+  gchar *model = write_model (anchors, n_anchors);
+  gchar *desc = g_strdup_printf ("sscma_yolov5 %s conf-threshold=0.25 "
+      "iou-threshold=0.01 %s", model, extra ? extra : "");
+  GstHarness *h = gst_harness_new_parse (desc);
+  gchar *caps;
+
+  g_free (desc);
+  g_free (model);
+  caps = g_strdup_printf ("video/x-raw,format=%s,width=%d,height=%d,"
+      "framerate=30/1", format, FRAME_SIZE, FRAME_SIZE);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+  return h;
+}
+
+/**
+ * @brief A harness around the element running the given model on RGB frames.
+ */
+static GstHarness *
+new_harness (const TestAnchor * anchors, guint n_anchors, const gchar * extra)
+{
+  return new_harness_format (anchors, n_anchors, extra, "RGB");
+}
+
+/**
+ * @brief A black frame.
+ */
+static GstBuffer *
+new_frame (guint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL,
+      FRAME_SIZE * FRAME_SIZE * 3, NULL);
+
+  gst_buffer_memset (buf, 0, 0, FRAME_SIZE * FRAME_SIZE * 3);
+  GST_BUFFER_PTS (buf) = n * GST_SECOND / 30;
+  GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+  return buf;
+}
+
+/**
+ * @brief A black NV12 frame, limited range.
+ */
+static GstBuffer *
+new_nv12_frame (guint n)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL,
+      FRAME_SIZE * FRAME_SIZE * 3 / 2, NULL);
+
+  gst_buffer_memset (buf, 0, 16, FRAME_SIZE * FRAME_SIZE);
+  gst_buffer_memset (buf, FRAME_SIZE * FRAME_SIZE, 128,
+      FRAME_SIZE * FRAME_SIZE / 2);
+  GST_BUFFER_PTS (buf) = n * GST_SECOND / 30;
+  GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+  return buf;
+}
+
+/**
+ * @brief Check the Y, U and V samples of a pixel of an NV12 frame, a
+ * negative u or v is not checked.
+ */
+static void
+assert_nv12_pixel (GstBuffer * buf, guint x, guint y, gint luma, gint u, gint v)
+{
+  GstMapInfo map;
+  const guint8 *uv;
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  uv = map.data + FRAME_SIZE * FRAME_SIZE + (y / 2) * FRAME_SIZE + (x & ~1u);
+  fail_unless_equals_int (map.data[y * FRAME_SIZE + x], luma);
+  if (u >= 0)
+    fail_unless_equals_int (uv[0], u);
+  if (v >= 0)
+    fail_unless_equals_int (uv[1], v);
+  gst_buffer_unmap (buf, &map);
+}
+
+/**
+ * @brief Check the color of a pixel, NULL for black.
+ */
+static void
+assert_pixel (GstBuffer * buf, guint x, guint y, const guint8 * rgb)
+{
+  static const guint8 black[3] = { 0, 0, 0 };
+  GstMapInfo map;
+  const guint8 *p;
+
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  p = map.data + (y * FRAME_SIZE + x) * 3;
+  if (rgb == NULL)
+    rgb = black;
+  fail_unless (memcmp (p, rgb, 3) == 0,
+      "pixel %u,%u is %02x%02x%02x, expected %02x%02x%02x", x, y, p[0], p[1],
+      p[2], rgb[0], rgb[1], rgb[2]);
+  gst_buffer_unmap (buf, &map);
+}
+
+GST_START_TEST (test_parse_dimension)
+{
+  static const gchar *ranks[] = { "1", "2", "3", "4", "5", "6", "7", "8",
+    "9", "10", "11", "12", "13", "14", "15", "16", "17", NULL
+  };
+  tensor_dim dim;
+  gchar *str;
+
+  fail_unless_equals_int (gst_tensor_parse_dimension ("3:320:320", dim), 3);
+  fail_unless (dim[0] == 3 && dim[1] == 320 && dim[2] == 320 && dim[3] == 0);
+  fail_unless_equals_int (gst_tensor_parse_dimension (" 85 : 6300:1:1 ", dim),
+      4);
+  fail_unless (dim[0] == 85 && dim[1] == 6300 && dim[2] == 1 && dim[3] == 1);
+
+  /* parsing stops at the first invalid entry */
+  fail_unless_equals_int (gst_tensor_parse_dimension ("3:0:320", dim), 1);
+  fail_unless (dim[0] == 3 && dim[1] == 0 && dim[2] == 0);
+  fail_unless_equals_int (gst_tensor_parse_dimension ("-3:320", dim), 0);
+  fail_unless_equals_int (gst_tensor_parse_dimension ("3:32x:320", dim), 1);
+  fail_unless_equals_int (gst_tensor_parse_dimension ("3:4294967296", dim), 1);
+  fail_unless_equals_int (gst_tensor_parse_dimension ("", dim), 0);
+  fail_unless_equals_int (gst_tensor_parse_dimension (NULL, dim), 0);
+
+  /* more ranks than the limit are not folded into the last one */
+  str = g_strjoinv (":", (gchar **) ranks);
+  fail_unless_equals_int (gst_tensor_parse_dimension (str, dim),
+      NNS_TENSOR_RANK_LIMIT);
+  fail_unless_equals_int (dim[NNS_TENSOR_RANK_LIMIT - 1], 16);
+  g_free (str);
+}
+
+GST_END_TEST;
+
+/**
+ * @brief Write the RGB pixels in the layout of a packed format: bpp bytes per
+ * pixel with R, G and B at the given offsets, the other bytes 0xff.
+ */
+static void
+pack_pixels (const guint8 (*rgb)[3], guint n, guint bpp, guint r, guint g,
+    guint b, guint8 * dst)
+{
+  guint i;
+
+  memset (dst, 0xff, n * bpp);
+  for (i = 0; i < n; i++) {
+    dst[i * bpp + r] = rgb[i][0];
+    dst[i * bpp + g] = rgb[i][1];
+    dst[i * bpp + b] = rgb[i][2];
+  }
+}
+
+/**
+ * @brief Preprocess a packed image of width x height pixels.
+ */
+static void
+preprocess_packed (GstVideoFormat format, const guint8 * data, gint bpp,
+    gint width, gint height, gint dst_width, gint dst_height,
+    const float mean[3], const float norm[3], ncnn::Mat & mat)
+{
+  SscmaImage image;
+
+  memset (&image, 0, sizeof (image));
+  image.format = format;
+  image.width = width;
+  image.height = height;
+  image.data[0] = data;
+  image.stride[0] = width * bpp;
+  fail_unless (sscma_preprocess (&image, NULL, dst_width, dst_height, mean,
+          norm, mat));
+  fail_unless (mat.w == dst_width && mat.h == dst_height && mat.c == 3);
+}
+
+GST_START_TEST (test_preprocess_formats)
+{
+  /* the ncnn converted formats and the fused ones, in the same order */
+  static const struct
+  {
+    GstVideoFormat format;
+    guint bpp, r, g, b;
+  } formats[] = {
+    {GST_VIDEO_FORMAT_RGB, 3, 0, 1, 2},
+    {GST_VIDEO_FORMAT_BGR, 3, 2, 1, 0},
+    {GST_VIDEO_FORMAT_RGBA, 4, 0, 1, 2},
+    {GST_VIDEO_FORMAT_BGRA, 4, 2, 1, 0},
+    {GST_VIDEO_FORMAT_xRGB, 4, 1, 2, 3},
+    {GST_VIDEO_FORMAT_ABGR, 4, 3, 2, 1},
+  };
+  static const float mean[3] = { 1.f, 2.f, 3.f };
+  static const float norm[3] = { 0.5f, 0.25f, 2.f };
+  guint8 rgb[8][3], packed[8 * 4];
+  ncnn::Mat mat;
+  guint f, i, c;
+
+  for (i = 0; i < 8; i++) {
+    rgb[i][0] = 10 * i;
+    rgb[i][1] = 100 + i;
+    rgb[i][2] = 250 - 5 * i;
+  }
+
+  /* 4x2 to 4x2 samples every pixel once, then (v - mean) * norm */
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    pack_pixels (rgb, 8, formats[f].bpp, formats[f].r, formats[f].g,
+        formats[f].b, packed);
+    preprocess_packed (formats[f].format, packed, formats[f].bpp, 4, 2, 4, 2,
+        mean, norm, mat);
+    for (c = 0; c < 3; c++) {
+      const float *v = mat.channel (c);
+
+      for (i = 0; i < 8; i++)
+        fail_unless (fabsf (v[i] - (rgb[i][c] - mean[c]) * norm[c]) < 1e-4f,
+            "format %s channel %u pixel %u is %f",
+            gst_video_format_to_string (formats[f].format), c, i, v[i]);
+    }
+  }
+
+  /* gray is replicated into the three channels */
+  preprocess_packed (GST_VIDEO_FORMAT_GRAY8, (const guint8 *) rgb, 1, 4, 2,
+      4, 2, NULL, norm, mat);
+  for (c = 0; c < 3; c++) {
+    const float *v = mat.channel (c);
+
+    for (i = 0; i < 8; i++)
+      fail_unless (fabsf (v[i] - ((const guint8 *) rgb)[i] * norm[c]) < 1e-4f);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_preprocess_resize)
+{
+  static const float norm[3] = { 1.f, 1.f, 1.f };
+  guint8 rgb[64][3], packed[64 * 4];
+  ncnn::Mat ncnn_mat, fused_mat;
+  guint c, i;
+
+  for (i = 0; i < 64; i++) {
+    rgb[i][0] = (i % 8) * 30;
+    rgb[i][1] = (i / 8) * 30;
+    rgb[i][2] = i * 3;
+  }
+
+  /* ncnn's resize and the fused one sample the same source pixels, a
+   * misplaced tap would be off by far more on these gradients */
+  pack_pixels (rgb, 64, 3, 0, 1, 2, packed);
+  preprocess_packed (GST_VIDEO_FORMAT_RGB, packed, 3, 8, 8, 3, 3, NULL, norm,
+      ncnn_mat);
+  pack_pixels (rgb, 64, 4, 1, 2, 3, packed);
+  preprocess_packed (GST_VIDEO_FORMAT_xRGB, packed, 4, 8, 8, 3, 3, NULL,
+      norm, fused_mat);
+  for (c = 0; c < 3; c++) {
+    const float *a = ncnn_mat.channel (c);
+    const float *b = fused_mat.channel (c);
+
+    for (i = 0; i < 3 * 3; i++)
+      fail_unless (fabsf (a[i] - b[i]) <= 2.f,
+          "channel %u value %u is %f and %f", c, i, a[i], b[i]);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_preprocess_nv12)
+{
+  /* the class 0 box color, Y 115 U 98 V 215 in BT.601 limited range */
+  static const float norm[3] = { 1.f, 1.f, 1.f };
+  static const guint8 color[3] = { 0xFF, 0x38, 0x38 };
+  guint8 planes[4 * 4 + 4 * 2];
+  SscmaImage image;
+  ncnn::Mat mat;
+  guint c, i;
+
+  memset (planes, 115, 4 * 4);
+  for (i = 0; i < 4; i++) {
+    planes[16 + i * 2] = 98;
+    planes[16 + i * 2 + 1] = 215;
+  }
+  memset (&image, 0, sizeof (image));
+  image.format = GST_VIDEO_FORMAT_NV12;
+  image.width = image.height = 4;
+  image.data[0] = planes;
+  image.data[1] = planes + 16;
+  image.stride[0] = image.stride[1] = 4;
+  fail_unless (sscma_preprocess (&image, NULL, 2, 2, NULL, norm, mat));
+
+  /* the inverse conversion, within its rounding */
+  for (c = 0; c < 3; c++) {
+    const float *v = mat.channel (c);
+
+    for (i = 0; i < 4; i++)
+      fail_unless (fabsf (v[i] - color[c]) <= 3.f,
+          "channel %u is %f, expected %u", c, v[i], color[c]);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_golden_detections)
+{
+  GstHarness *h = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL);
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  fail_unless (out != NULL);
+
+  /* corners of the kept boxes, in the color of their class */
+  assert_pixel (out, 16, 47, class_colors[0]);
+  assert_pixel (out, 47, 47, class_colors[0]);
+  assert_pixel (out, 79, 47, class_colors[0]);
+  assert_pixel (out, 80, 111, class_colors[1]);
+  assert_pixel (out, 111, 111, class_colors[1]);
+  /* boxes are outlines */
+  assert_pixel (out, 32, 40, NULL);
+  assert_pixel (out, 96, 100, NULL);
+  /* the suppressed and the unconfident anchors are not drawn */
+  assert_pixel (out, 51, 51, NULL);
+  assert_pixel (out, 111, 47, NULL);
+
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_golden_nv12)
+{
+  GstHarness *h = new_harness_format (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL, "NV12");
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h, new_nv12_frame (0));
+  fail_unless (out != NULL);
+
+  /* the boxes of the RGB golden frame, in BT.601 limited range: class 0 is
+   * Y 115 U 98 V 215, class 1 is Y 176 U 111 V 171 */
+  assert_nv12_pixel (out, 16, 47, 115, 98, 215);
+  assert_nv12_pixel (out, 47, 47, 115, -1, -1);
+  assert_nv12_pixel (out, 79, 47, 115, -1, -1);
+  assert_nv12_pixel (out, 80, 111, 176, 111, 171);
+  assert_nv12_pixel (out, 111, 111, 176, -1, -1);
+  /* black inside the outlines and where nothing was kept */
+  assert_nv12_pixel (out, 32, 40, 16, 128, 128);
+  assert_nv12_pixel (out, 96, 100, 16, 128, 128);
+  assert_nv12_pixel (out, 51, 51, 16, 128, 128);
+  assert_nv12_pixel (out, 111, 47, 16, -1, -1);
+
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_boxes_clipped)
+{
+  /* a box bigger than the frame, drawn along its edges */
+  static const TestAnchor anchors[] = {
+    {16, 16, 64, 64, 0.9f, 0.9f, 0.1f},
+  };
+  GstHarness *h = new_harness (anchors, G_N_ELEMENTS (anchors), NULL);
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  assert_pixel (out, FRAME_SIZE - 1, FRAME_SIZE - 1, class_colors[0]);
+  assert_pixel (out, FRAME_SIZE / 2, FRAME_SIZE / 2, NULL);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_tile_activity)
+{
+  /* 0.81, found by the coarse pass, and by a tile at 8..24 if it runs */
+  static const TestAnchor anchors[] = {
+    {8, 8, 8, 8, 0.9f, 0.9f, 0.1f},
+  };
+  GstHarness *h;
+  GstBuffer *out;
+
+  h = new_harness (anchors, G_N_ELEMENTS (anchors),
+      "iou-threshold=0.5 tile-size=64 tile-activity-threshold=0.9");
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  assert_pixel (out, 47, 47, class_colors[0]);
+  /* not active enough, no tile ran */
+  assert_pixel (out, 23, 23, NULL);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+
+  h = new_harness (anchors, G_N_ELEMENTS (anchors),
+      "iou-threshold=0.5 tile-size=64 tile-activity-threshold=0.5");
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  assert_pixel (out, 47, 47, class_colors[0]);
+  assert_pixel (out, 23, 23, class_colors[0]);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/**
+ * @brief Replace the labels of a running element.
+ */
+static void
+set_labels (GstHarness * h, const gchar * contents)
+{
+  gchar *labels = g_build_filename (test_dir, "labels-new.txt", NULL);
+
+  fail_unless (g_file_set_contents (labels, contents, -1, NULL));
+  g_object_set (h->element, "labels", labels, NULL);
+  g_free (labels);
+}
+
+GST_START_TEST (test_label_mismatch)
+{
+  GstHarness *h = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL);
+  GstBuffer *out;
+
+  /* CRLF endings and blank lines at the end are not labels */
+  set_labels (h, "a\r\nb\r\n\r\n");
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  assert_pixel (out, 16, 47, class_colors[0]);
+  gst_buffer_unref (out);
+
+  /* one label too many for the 7 values per anchor, nothing is decoded */
+  set_labels (h, "a\nb\nc\n");
+  out = gst_harness_push_and_pull (h, new_frame (1));
+  assert_pixel (out, 16, 47, NULL);
+  assert_pixel (out, 111, 111, NULL);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_no_detections)
+{
+  static const TestAnchor anchors[4] = { {0} };
+  GstHarness *h = new_harness (anchors, G_N_ELEMENTS (anchors), NULL);
+  GstBuffer *out;
+  GstMapInfo map;
+  gsize i;
+
+  /* NMS gets no boxes at all */
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  fail_unless (gst_buffer_map (out, &map, GST_MAP_READ));
+  for (i = 0; i < map.size; i++)
+    fail_unless (map.data[i] == 0, "byte %" G_GSIZE_FORMAT " was drawn", i);
+  gst_buffer_unmap (out, &map);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_instances_independent)
+{
+  GstHarness *h1 = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL);
+  GstHarness *h2 = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL);
+  GstBuffer *out;
+
+  out = gst_harness_push_and_pull (h1, new_frame (0));
+  fail_unless (out != NULL);
+  gst_buffer_unref (out);
+
+  /* shutting one instance down leaves the model of the other loaded */
+  gst_harness_teardown (h1);
+  out = gst_harness_push_and_pull (h2, new_frame (0));
+  fail_unless (out != NULL);
+  assert_pixel (out, 16, 47, class_colors[0]);
+  assert_pixel (out, 111, 111, class_colors[1]);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h2);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_extra_model_blobs)
+{
+  /* class 0 of the second model, drawn at 80..112 */
+  static const TestAnchor anchors[] = {
+    {24, 24, 8, 8, 0.9f, 0.9f, 0.1f},
+  };
+  static const guint8 extra_color[3] = { 0x3D, 0xDB, 0x86 };
+  GstHarness *h = new_harness (golden_anchors, 1, NULL);
+  gchar *bin, *param, *extra_bin, *extra_param, *labels, *model;
+  GstBuffer *out;
+
+  /* exported with other blob names than in0 and out0 */
+  write_net ("model", "in0", "out0", golden_anchors, 1, &bin, &param);
+  write_net ("extra", "images", "output0", anchors, G_N_ELEMENTS (anchors),
+      &extra_bin, &extra_param);
+  labels = g_build_filename (test_dir, "labels.txt", NULL);
+  model = g_strdup_printf ("%s,%s;%s,%s,output=%d:%u,labels=%s,"
+      "input-name=images,output-name=output0,mean=0:0:0,norm=1:1:1", bin,
+      param, extra_bin, extra_param, N_VALUES,
+      (guint) G_N_ELEMENTS (anchors), labels);
+  /* loaded by the setter, not by the streaming thread */
+  g_object_set (h->element, "model", model, NULL);
+
+  out = gst_harness_push_and_pull (h, new_frame (0));
+  assert_pixel (out, 16, 47, class_colors[0]);
+  assert_pixel (out, 80, 111, extra_color);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+  g_free (bin);
+  g_free (param);
+  g_free (extra_bin);
+  g_free (extra_param);
+  g_free (labels);
+  g_free (model);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_tensor_output)
+{
+  GstHarness *h = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), "mode=tensor");
+  GstBuffer *out;
+  GstCaps *caps;
+  GstMapInfo map;
+
+  out = gst_harness_push_and_pull (h, new_frame (3));
+  fail_unless (out != NULL);
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  fail_unless (gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          NNS_MIMETYPE_TENSORS));
+  gst_caps_unref (caps);
+
+  /* the raw output, nothing decoded or dropped */
+  fail_unless (gst_buffer_map (out, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, sizeof (golden_anchors));
+  fail_unless (memcmp (map.data, golden_anchors, sizeof (golden_anchors)) == 0);
+  gst_buffer_unmap (out, &map);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (out), 3 * GST_SECOND / 30);
+  gst_buffer_unref (out);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/** memories handed out by the counting allocator */
+static gint test_allocations;
+
+typedef struct
+{
+  GstAllocator parent;
+} TestCountingAllocator;
+
+typedef struct
+{
+  GstAllocatorClass parent_class;
+} TestCountingAllocatorClass;
+
+GType test_counting_allocator_get_type (void);
+G_DEFINE_TYPE (TestCountingAllocator, test_counting_allocator,
+    GST_TYPE_ALLOCATOR);
+
+/**
+ * @brief Count the allocation and leave it to the system memory allocator,
+ * which also frees it.
+ */
+static GstMemory *
+test_counting_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  GstAllocator *sysmem = gst_allocator_find (GST_ALLOCATOR_SYSMEM);
+  GstMemory *mem;
+
+  g_atomic_int_inc (&test_allocations);
+  mem = gst_allocator_alloc (sysmem, size, params);
+  gst_object_unref (sysmem);
+  return mem;
+}
+
+static void
+test_counting_allocator_class_init (TestCountingAllocatorClass * klass)
+{
+  GST_ALLOCATOR_CLASS (klass)->alloc = test_counting_allocator_alloc;
+}
+
+static void
+test_counting_allocator_init (TestCountingAllocator * self)
+{
+}
+
+GST_START_TEST (test_allocations_per_frame)
+{
+  GstHarness *h;
+  GstBuffer *frames[5];
+  guint i;
+
+  /* the element, its pool and the harness allocate through the default */
+  gst_allocator_set_default ((GstAllocator *)
+      gst_object_ref_sink (g_object_new (test_counting_allocator_get_type (),
+              NULL)));
+  h = new_harness (golden_anchors, G_N_ELEMENTS (golden_anchors), NULL);
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    frames[i] = new_frame (i);
+
+  for (i = 0; i < G_N_ELEMENTS (frames); i++) {
+    GstBuffer *out;
+
+    /* the first frame fills the pool */
+    if (i == 1)
+      g_atomic_int_set (&test_allocations, 0);
+    /* still referenced here, so it is copied into a pool buffer to draw on */
+    out = gst_harness_push_and_pull (h, gst_buffer_ref (frames[i]));
+    fail_unless (out != frames[i]);
+    assert_pixel (out, 16, 47, class_colors[0]);
+    assert_pixel (frames[i], 16, 47, NULL);
+    gst_buffer_unref (out);
+  }
+  /* the pool buffer comes back for every frame after the first */
+  fail_unless_equals_int (g_atomic_int_get (&test_allocations), 0);
+
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    gst_buffer_unref (frames[i]);
+  gst_harness_teardown (h);
+  gst_allocator_set_default (gst_allocator_find (GST_ALLOCATOR_SYSMEM));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_frames_in_place)
+{
+  GstHarness *h = new_harness (golden_anchors,
+      G_N_ELEMENTS (golden_anchors), NULL);
+  GstStructure *stats;
+  guint64 frames;
+  guint i;
+
+  for (i = 0; i < 5; i++) {
+    GstBuffer *in = new_frame (i);
+    GstBuffer *out;
+
+    /* drawn on the frame itself, nothing is allocated per frame */
+    out = gst_harness_push_and_pull (h, in);
+    fail_unless (out == in);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (out), i * GST_SECOND / 30);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (out), GST_SECOND / 30);
+    gst_buffer_unref (out);
+  }
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless_equals_uint64 (frames, 5);
+  gst_structure_free (stats);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+setup (void)
+{
+  test_dir = g_dir_make_tmp ("sscmayolov5-XXXXXX", NULL);
+  fail_unless (test_dir != NULL);
+}
+
+static void
+teardown (void)
+{
+  GDir *dir = g_dir_open (test_dir, 0, NULL);
+  const gchar *name;
+
+  /* the models and labels the test wrote */
+  while (dir && (name = g_dir_read_name (dir))) {
+    gchar *path = g_build_filename (test_dir, name, NULL);
+
+    g_unlink (path);
+    g_free (path);
+  }
+  if (dir)
+    g_dir_close (dir);
+  g_rmdir (test_dir);
+  g_free (test_dir);
+}
+
+static Suite *
+sscmayolov5_suite (void)
+{
+  Suite *s = suite_create ("sscmayolov5");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_parse_dimension);
+  tcase_add_test (tc_chain, test_preprocess_formats);
+  tcase_add_test (tc_chain, test_preprocess_resize);
+  tcase_add_test (tc_chain, test_preprocess_nv12);
+  tcase_add_test (tc_chain, test_golden_detections);
+  tcase_add_test (tc_chain, test_golden_nv12);
+  tcase_add_test (tc_chain, test_boxes_clipped);
+  tcase_add_test (tc_chain, test_tile_activity);
+  tcase_add_test (tc_chain, test_label_mismatch);
+  tcase_add_test (tc_chain, test_no_detections);
+  tcase_add_test (tc_chain, test_extra_model_blobs);
+  tcase_add_test (tc_chain, test_tensor_output);
+  tcase_add_test (tc_chain, test_allocations_per_frame);
+  tcase_add_test (tc_chain, test_frames_in_place);
+  tcase_add_test (tc_chain, test_instances_independent);
+  return s;
+}
+
+GST_CHECK_MAIN (sscmayolov5);